@@ -12,16 +12,23 @@
 
 #include "buffer/buffer_pool_manager_instance.h"
 
+#include <algorithm>
+#include <cstring>
+#include <future>  // NOLINT
+#include <utility>
+#include <vector>
+
 #include "common/macros.h"
 
 namespace bustub {
 
 BufferPoolManagerInstance::BufferPoolManagerInstance(size_t pool_size, DiskManager *disk_manager,
-                                                     LogManager *log_manager)
-    : BufferPoolManagerInstance(pool_size, 1, 0, disk_manager, log_manager) {}
+                                                     LogManager *log_manager, ReplacerPolicy replacer_policy)
+    : BufferPoolManagerInstance(pool_size, 1, 0, disk_manager, log_manager, replacer_policy, -1) {}
 
 BufferPoolManagerInstance::BufferPoolManagerInstance(size_t pool_size, uint32_t num_instances, uint32_t instance_index,
-                                                     DiskManager *disk_manager, LogManager *log_manager)
+                                                     DiskManager *disk_manager, LogManager *log_manager,
+                                                     ReplacerPolicy replacer_policy, int numa_node)
     : pool_size_(pool_size),
       num_instances_(num_instances),
       instance_index_(instance_index),
@@ -32,87 +39,159 @@ BufferPoolManagerInstance::BufferPoolManagerInstance(size_t pool_size, uint32_t
   BUSTUB_ASSERT(
       instance_index < num_instances,
       "BPI index cannot be greater than the number of BPIs in the pool. In non-parallel case, index should just be 1.");
-  // We allocate a consecutive memory space for the buffer pool.
+  // We allocate a consecutive memory space for the buffer pool. Frame data lives in its own arena, so that the page
+  // metadata stays densely packed and the data can be backed by huge pages. Frames are as large as the pages of the
+  // database file.
+  size_t page_size = disk_manager_ != nullptr ? disk_manager_->GetPageSize() : PAGE_SIZE;
+  arena_ = new FrameArena(pool_size_, numa_node, page_size);
   pages_ = new Page[pool_size_];
-  replacer_ = new LRUReplacer(pool_size);
+  for (size_t i = 0; i < pool_size_; ++i) {
+    pages_[i].data_ = arena_->GetFrameData(static_cast<frame_id_t>(i));
+    pages_[i].page_size_ = page_size;
+  }
+  switch (replacer_policy) {
+    case ReplacerPolicy::LRU_K:
+      replacer_ = new LRUKReplacer(pool_size);
+      break;
+    case ReplacerPolicy::CLOCK:
+      replacer_ = new ClockReplacer(pool_size);
+      break;
+    case ReplacerPolicy::LRU:
+    default:
+      replacer_ = new LRUReplacer(pool_size);
+      break;
+  }
 
   // Initially, every page is in the free list.
   for (size_t i = 0; i < pool_size_; ++i) {
     free_list_.emplace_back(static_cast<int>(i));
   }
+  num_free_frames_ = pool_size_;
 }
 
 BufferPoolManagerInstance::~BufferPoolManagerInstance() {
+  StopFlushThread();
+  // 预读的数据还在往页数组里写，等它们结束
+  for (auto &[page_id, pending] : pending_reads_) {
+    pending.read_.wait();
+  }
   delete[] pages_;
+  delete arena_;
   delete replacer_;
 }
 
 bool BufferPoolManagerInstance::FlushPgImp(page_id_t page_id) {
   // 标记是脏页，将不活跃数据库页保存到下层绑定的文件页
-  std::lock_guard<std::mutex> guard(latch_);
-  auto iter = page_table_.find(page_id);
-  if (iter == page_table_.end()) {
+  // 钉住保证刷盘期间该页不会被换出；不持有latch_，等页的读锁时不会挡住别人换页
+  // 校验和是对着帧算的，读锁住页，计算和写盘之间页不会被改
+  auto start_time = BufferPoolStats::Now();
+  frame_id_t frame_id;
+  if (!PinForFlush(page_id, &frame_id)) {
     return false;
   }
-  frame_id_t frame_id = iter->second;
   Page *page = pages_ + frame_id;
-  page->is_dirty_ = false;
-  disk_manager_->WritePage(page_id, page->GetData());
+  {
+    std::lock_guard<std::mutex> flush_guard(flush_latch_);
+    page->RLatch();
+    // 先清除脏标记，刷盘期间再被弄脏的页仍然保持脏；干净的页也写，但只统计脏页
+    if (MarkClean(page)) {
+      stats_.Increment(BufferPoolCounter::FLUSHES);
+    }
+    disk_manager_->WritePage(page_id, page->GetData());
+    page->RUnlatch();
+  }
+  UnpinAfterFlush(page_id, frame_id);
+  stats_.RecordLatency(BufferPoolLatency::FLUSH, start_time);
   return true;
 }
 
 void BufferPoolManagerInstance::FlushAllPgsImp() {
-  std::lock_guard<std::mutex> guard(latch_);
-  auto iter = page_table_.begin();
-  while (iter != page_table_.end()) {
-    page_id_t page_id = iter->first;
-    frame_id_t frame_id = iter->second;
-    Page *page = pages_ + frame_id;
-    disk_manager_->WritePage(page_id, page->GetData());
-    iter++;
+  // 1. 持有latch_期间页表的映射不会变化，收集所有页并钉住，按页编号排序
+  // 2. 逐页读锁住，拷贝一份再放锁，不同时持有多个页的锁；批量异步写拷贝
+  // 3. 写完才放掉钉住，期间页不会被换出，换出时的同步写不会被这里旧的拷贝覆盖
+  std::vector<std::pair<page_id_t, frame_id_t>> resident_pages;
+  {
+    std::lock_guard<std::mutex> guard(latch_);
+    for (auto &shard : page_table_) {
+      std::shared_lock<std::shared_mutex> shard_guard(shard.latch_);
+      for (const auto &[page_id, frame_id] : shard.table_) {
+        pages_[frame_id].pin_count_.fetch_add(1);
+        resident_pages.emplace_back(page_id, frame_id);
+      }
+    }
+  }
+  std::sort(resident_pages.begin(), resident_pages.end());
+
+  size_t page_size = GetPageSize();
+  std::vector<char> copies(resident_pages.size() * page_size);
+  {
+    std::lock_guard<std::mutex> flush_guard(flush_latch_);
+    std::vector<std::future<bool>> writes;
+    writes.reserve(resident_pages.size());
+    for (size_t i = 0; i < resident_pages.size(); i++) {
+      auto [page_id, frame_id] = resident_pages[i];
+      Page *page = pages_ + frame_id;
+      char *copy = copies.data() + i * page_size;
+      page->RLatch();
+      if (MarkClean(page)) {
+        stats_.Increment(BufferPoolCounter::FLUSHES);
+      }
+      memcpy(copy, page->GetData(), page_size);
+      page->RUnlatch();
+      writes.push_back(disk_manager_->WritePageAsync(page_id, copy));
+    }
+    for (auto &write : writes) {
+      write.wait();
+    }
+  }
+  for (const auto &[page_id, frame_id] : resident_pages) {
+    UnpinAfterFlush(page_id, frame_id);
   }
 }
 
-Page *BufferPoolManagerInstance::NewPgImp(page_id_t *page_id) {
+Page *BufferPoolManagerInstance::NewPgImp(page_id_t *page_id) { return NewPgImp(page_id, nullptr); }
+
+Page *BufferPoolManagerInstance::NewPgImp(page_id_t *page_id, BufferAccessStrategy *strategy) {
   // 1. 空闲链表不为空，从空闲链表获取页节点，将页结点的数据重置，返回。
   // 2. 空闲链表为空，lru取出牺牲节点
   // 3. 如果牺牲节点标记脏页，保存到下层
   // 4.
   // 将页哈希表对牺牲节点的页编号到页数组下标的映射，改为新页节点的页编号到页数组下标的映射，并将数据节点重置为新节点，返回。
 
+  auto wait_start = BufferPoolStats::Now();
   std::lock_guard<std::mutex> guard(latch_);
+  stats_.RecordLatency(BufferPoolLatency::LATCH_WAIT, wait_start);
 
-  // 从不活跃数据库页获取
+  // 先分配页编号，环里要记下它；拿不到帧就还回去
   frame_id_t frame_id = -1;
-  Page *page = nullptr;
-  if (!free_list_.empty()) {
-    frame_id = free_list_.front();
-    free_list_.pop_front();
-    page = &pages_[frame_id];
-  } else if (replacer_->Victim(&frame_id)) {
-    page = &pages_[frame_id];
-    // 牺牲页保存到下一层
-    if (page->IsDirty()) {
-      disk_manager_->WritePage(page->GetPageId(), page->GetData());
+  page_id_t new_page_id = AllocatePage();
+  if (!AcquireFrame(&frame_id, new_page_id, strategy)) {
+    if (new_page_id + static_cast<page_id_t>(num_instances_) == next_page_id_) {
+      next_page_id_ = new_page_id;
+    } else {
+      DeallocatePage(new_page_id);
     }
-    page_table_.erase(page->GetPageId());
+    return nullptr;
   }
 
-  if (page != nullptr) {
-    // 更新元数据
-    *page_id = AllocatePage();
-    page->page_id_ = *page_id;
-    page->pin_count_ = 1;
-    page->is_dirty_ = false;
-    page->ResetMemory();
-    page_table_[*page_id] = frame_id;
-    replacer_->Pin(frame_id);
-    return page;
-  }
-  return nullptr;
+  // 更新元数据
+  Page *page = &pages_[frame_id];
+  *page_id = new_page_id;
+  page->page_id_ = *page_id;
+  page->pin_count_ = 1;
+  page->is_dirty_ = false;
+  page->ResetMemory();
+  replacer_->Pin(frame_id);
+
+  PageTableShard &shard = GetShard(*page_id);
+  std::unique_lock<std::shared_mutex> shard_guard(shard.latch_);
+  shard.table_[*page_id] = frame_id;
+  return page;
 }
 
-Page *BufferPoolManagerInstance::FetchPgImp(page_id_t page_id) {
+Page *BufferPoolManagerInstance::FetchPgImp(page_id_t page_id) { return FetchPgImp(page_id, nullptr); }
+
+Page *BufferPoolManagerInstance::FetchPgImp(page_id_t page_id, BufferAccessStrategy *strategy) {
   // 1. 页哈希表判断页节点是否在页数组中
   //   a. 页节点在页数组中，页节点线程计数++，从lru删除，返回页节点
   // 2. 页节点不在页数组，说明在下层，需要取出来，需要从空闲链表找到一个空页节点。
@@ -121,44 +200,60 @@ Page *BufferPoolManagerInstance::FetchPgImp(page_id_t page_id) {
   //   c. 空闲链表为空，lru取出牺牲节点
   //   d. 如果牺牲节点标记脏页，保存到下层，同样得到空页节点
   // 3. 从下层读取数据到空页节点，返回
+
+  // P存在，命中路径只持有页表分片的读锁
+  Page *page = PinResidentPage(page_id);
+  if (page != nullptr) {
+    stats_.Increment(BufferPoolCounter::HITS);
+    return page;
+  }
+
+  auto start_time = BufferPoolStats::Now();
   std::lock_guard<std::mutex> guard(latch_);
-  auto iter = page_table_.find(page_id);
-  if (iter != page_table_.end()) {
-    // P存在
-    frame_id_t frame_id = iter->second;
-    Page *page = &pages_[frame_id];
-    page->pin_count_++;
-    replacer_->Pin(frame_id);
+  stats_.RecordLatency(BufferPoolLatency::LATCH_WAIT, start_time);
+  // 等待latch_期间可能已经有其他线程把P读进来了
+  page = PinResidentPage(page_id);
+  if (page != nullptr) {
+    stats_.Increment(BufferPoolCounter::HITS);
     return page;
   }
+  stats_.Increment(BufferPoolCounter::MISSES);
+  // P正在预读，等它读完即可
+  auto pending = pending_reads_.find(page_id);
+  if (pending != pending_reads_.end()) {
+    page = CompletePendingRead(pending, 1);
+    if (page != nullptr) {
+      stats_.RecordLatency(BufferPoolLatency::FETCH_MISS, start_time);
+      return page;
+    }
+  }
 
   // 从不活跃区域获取
   frame_id_t frame_id = -1;
-  Page *page = nullptr;
-  if (!free_list_.empty()) {
-    frame_id = free_list_.front();
-    free_list_.pop_front();
-    page = &pages_[frame_id];
-  } else if (replacer_->Victim(&frame_id)) {
-    page = &pages_[frame_id];
-    // 脏页
-    if (page->IsDirty()) {
-      disk_manager_->WritePage(page->GetPageId(), page->GetData());
-    }
-    // 从哈希表删除
-    page_table_.erase(page->GetPageId());
+  if (!AcquireFrame(&frame_id, page_id, strategy)) {
+    return nullptr;
   }
 
-  if (page != nullptr) {
-    // P的元数据
-    page->page_id_ = page_id;
-    page->pin_count_ = 1;
-    page->is_dirty_ = false;
-    // 磁盘
-    disk_manager_->ReadPage(page_id, page->GetData());
-    page_table_[page_id] = frame_id;
-    replacer_->Pin(frame_id);
+  // P的元数据
+  page = &pages_[frame_id];
+  page->page_id_ = page_id;
+  page->pin_count_ = 1;
+  page->is_dirty_ = false;
+  // 磁盘，读完之后才放进页表，命中路径不会看到未读完的页
+  // 校验和对不上的页不放进缓冲池，帧还回空闲链表
+  if (!disk_manager_->ReadPage(page_id, page->GetData())) {
+    page->page_id_ = INVALID_PAGE_ID;
+    page->pin_count_ = 0;
+    free_list_.push_back(frame_id);
+    num_free_frames_++;
+    return nullptr;
   }
+  replacer_->Pin(frame_id);
+
+  PageTableShard &shard = GetShard(page_id);
+  std::unique_lock<std::shared_mutex> shard_guard(shard.latch_);
+  shard.table_[page_id] = frame_id;
+  stats_.RecordLatency(BufferPoolLatency::FETCH_MISS, start_time);
   return page;
 }
 
@@ -166,14 +261,27 @@ bool BufferPoolManagerInstance::DeletePgImp(page_id_t page_id) {
   // 1. 页哈希表判断页节点是否在页数组
   //   a. 页节点不在页数组，直接返回
   // 2. 页节点在页数组
-  // 3. 如果页节点标记脏页，保存到下层
-  // 4. 从lru删除节点
+  // 3. 页被删了，脏数据不用再写回
+  // 4. 从replacer删除节点，连同访问历史，帧马上会换成别的页
   // 5. 页节点清空数据
   // 6. 页节点放入空闲链表，实际上是放入页数组的下标
+  // 7. 页编号还给磁盘上的空闲页表，还被钉着的页不能还
+  // 不是这个实例分配出去的页编号不能还，否则之后next_page_id_走到它时会再分配一次
+  auto wait_start = BufferPoolStats::Now();
   std::lock_guard<std::mutex> guard(latch_);
-  DeallocatePage(page_id);
-  auto iter = page_table_.find(page_id);
-  if (iter == page_table_.end()) {
+  stats_.RecordLatency(BufferPoolLatency::LATCH_WAIT, wait_start);
+  if (page_id < 0 || static_cast<uint32_t>(page_id) % num_instances_ != instance_index_ || page_id >= next_page_id_) {
+    return false;
+  }
+  auto pending = pending_reads_.find(page_id);
+  if (pending != pending_reads_.end()) {
+    CompletePendingRead(pending, 0);
+  }
+  PageTableShard &shard = GetShard(page_id);
+  std::unique_lock<std::shared_mutex> shard_guard(shard.latch_);
+  auto iter = shard.table_.find(page_id);
+  if (iter == shard.table_.end()) {
+    DeallocatePage(page_id);
     return true;
   }
 
@@ -183,16 +291,15 @@ bool BufferPoolManagerInstance::DeletePgImp(page_id_t page_id) {
     return false;
   }
 
-  if (page->IsDirty()) {
-    disk_manager_->WritePage(page_id, page->GetData());
-  }
-  replacer_->Pin(frame_id);
-  page_table_.erase(page_id);
+  MarkClean(page);
+  replacer_->Remove(frame_id);
+  shard.table_.erase(iter);
   page->page_id_ = INVALID_PAGE_ID;
   page->pin_count_ = 0;
-  page->is_dirty_ = false;
   page->ResetMemory();
   free_list_.push_back(frame_id);
+  num_free_frames_++;
+  DeallocatePage(page_id);
   return true;
 }
 
@@ -203,36 +310,386 @@ bool BufferPoolManagerInstance::UnpinPgImp(page_id_t page_id, bool is_dirty) {
   // 3. 页节点引用计数--
   // 4. 如果参数说明脏页，则页节点标记脏页
   // 5. 如果页节点引用计数变为0，lru插入节点
-  std::lock_guard<std::mutex> guard(latch_);
-  auto iter = page_table_.find(page_id);
-  if (iter == page_table_.end()) {
+  PageTableShard &shard = GetShard(page_id);
+  std::shared_lock<std::shared_mutex> shard_guard(shard.latch_);
+  auto iter = shard.table_.find(page_id);
+  if (iter == shard.table_.end()) {
     return false;
   }
 
   // 找到了
   frame_id_t frame_id = iter->second;
   Page *page = pages_ + frame_id;
-  if (page->GetPinCount() <= 0) {
+  int pin_count = page->pin_count_.load();
+  do {
+    if (pin_count <= 0) {
+      return false;
+    }
+  } while (!page->pin_count_.compare_exchange_weak(pin_count, pin_count - 1));
+
+  if (is_dirty) {
+    MarkDirty(page);
+  }
+  if (pin_count == 1) {
+    replacer_->Unpin(frame_id);
+  }
+  return true;
+}
+
+bool BufferPoolManagerInstance::MarkPageDirtyImp(page_id_t page_id) {
+  // 只有钉住的页可以标脏，钉住的页不会被换出，不用拿latch_
+  PageTableShard &shard = GetShard(page_id);
+  std::shared_lock<std::shared_mutex> shard_guard(shard.latch_);
+  auto iter = shard.table_.find(page_id);
+  if (iter == shard.table_.end()) {
+    return false;
+  }
+  Page *page = pages_ + iter->second;
+  if (page->pin_count_ <= 0) {
     return false;
   }
+  MarkDirty(page);
+  return true;
+}
 
-  if (is_dirty) {
-    page->is_dirty_ = is_dirty;
+BufferPoolManagerInstance::PageTableShard &BufferPoolManagerInstance::GetShard(page_id_t page_id) {
+  // 同一个实例的页编号模num_instances_同余，先除掉再分片
+  return page_table_[static_cast<uint32_t>(page_id) / num_instances_ % PAGE_TABLE_SHARD_NUM];
+}
+
+Page *BufferPoolManagerInstance::PinResidentPage(page_id_t page_id) {
+  PageTableShard &shard = GetShard(page_id);
+  std::shared_lock<std::shared_mutex> shard_guard(shard.latch_);
+  auto iter = shard.table_.find(page_id);
+  if (iter == shard.table_.end()) {
+    return nullptr;
+  }
+  Page *page = &pages_[iter->second];
+  // 只有0->1的时候页节点还在lru里
+  if (page->pin_count_.fetch_add(1) == 0) {
+    replacer_->Pin(iter->second);
+  }
+  return page;
+}
+
+bool BufferPoolManagerInstance::AcquireFrame(frame_id_t *frame_id) {
+  if (free_list_.empty()) {
+    // 已经读完的预读页变成可换出的
+    ReapPendingReads();
+  }
+  if (!free_list_.empty()) {
+    *frame_id = free_list_.front();
+    free_list_.pop_front();
+    num_free_frames_--;
+    return true;
+  }
+
+  auto start_time = BufferPoolStats::Now();
+  while (replacer_->Victim(frame_id)) {
+    Page *page = &pages_[*frame_id];
+    PageTableShard &shard = GetShard(page->page_id_);
+    {
+      std::unique_lock<std::shared_mutex> shard_guard(shard.latch_);
+      // Victim之后、拿到写锁之前，牺牲页可能又被命中路径钉住了，换一个
+      if (page->pin_count_ > 0) {
+        continue;
+      }
+      // 从哈希表删除
+      shard.table_.erase(page->page_id_);
+    }
+    // 牺牲页保存到下一层，期间对它的Fetch会在latch_上等待
+    // 后台刷盘线程在跑的话，这里大多数时候拿到的都是干净页
+    if (MarkClean(page)) {
+      disk_manager_->WritePage(page->GetPageId(), page->GetData());
+      flush_cv_.notify_one();
+      stats_.Increment(BufferPoolCounter::DIRTY_EVICTIONS);
+    }
+    stats_.Increment(BufferPoolCounter::EVICTIONS);
+    stats_.RecordLatency(BufferPoolLatency::EVICT, start_time);
+    return true;
+  }
+
+  // 其余的帧都被还没读完的预读占着，等它们读完再试一次
+  if (!pending_reads_.empty()) {
+    while (!pending_reads_.empty()) {
+      CompletePendingRead(pending_reads_.begin(), 0);
+    }
+    return AcquireFrame(frame_id);
+  }
+  return false;
+}
+
+bool BufferPoolManagerInstance::AcquireFrame(frame_id_t *frame_id, page_id_t page_id,
+                                             BufferAccessStrategy *strategy) {
+  // 1. 没有策略，照常从空闲链表或者replacer拿帧
+  // 2. 环的下一格还是这个操作自己放进去的页，并且没人钉着，直接回收，不动别人的页
+  // 3. 否则照常拿一个帧，记到环里
+  if (strategy == nullptr) {
+    return AcquireFrame(frame_id);
+  }
+  BufferAccessStrategy::RingSlot &slot =
+      strategy->NextSlot(instance_index_, std::max<size_t>(pool_size_ / MAX_RING_RATIO, 1));
+
+  if (slot.page_id_ != INVALID_PAGE_ID) {
+    auto start_time = BufferPoolStats::Now();
+    Page *page = &pages_[slot.frame_id_];
+    PageTableShard &shard = GetShard(slot.page_id_);
+    bool reclaimed = false;
+    {
+      std::unique_lock<std::shared_mutex> shard_guard(shard.latch_);
+      auto iter = shard.table_.find(slot.page_id_);
+      if (iter != shard.table_.end() && iter->second == slot.frame_id_ && page->pin_count_ == 0) {
+        shard.table_.erase(iter);
+        replacer_->Remove(slot.frame_id_);
+        reclaimed = true;
+      }
+    }
+    if (reclaimed) {
+      if (MarkClean(page)) {
+        disk_manager_->WritePage(slot.page_id_, page->GetData());
+        stats_.Increment(BufferPoolCounter::DIRTY_EVICTIONS);
+      }
+      stats_.Increment(BufferPoolCounter::EVICTIONS);
+      stats_.RecordLatency(BufferPoolLatency::EVICT, start_time);
+      *frame_id = slot.frame_id_;
+      slot.page_id_ = page_id;
+      return true;
+    }
+  }
+
+  if (!AcquireFrame(frame_id)) {
+    return false;
+  }
+  slot.frame_id_ = *frame_id;
+  slot.page_id_ = page_id;
+  return true;
+}
+
+bool BufferPoolManagerInstance::PrefetchPgImp(page_id_t page_id, BufferAccessStrategy *strategy) {
+  PageTableShard &shard = GetShard(page_id);
+  {
+    std::shared_lock<std::shared_mutex> shard_guard(shard.latch_);
+    if (shard.table_.find(page_id) != shard.table_.end()) {
+      return true;
+    }
   }
-  page->pin_count_--;
-  if (page->GetPinCount() <= 0) {
+
+  auto wait_start = BufferPoolStats::Now();
+  std::lock_guard<std::mutex> guard(latch_);
+  stats_.RecordLatency(BufferPoolLatency::LATCH_WAIT, wait_start);
+  ReapPendingReads();
+  {
+    std::shared_lock<std::shared_mutex> shard_guard(shard.latch_);
+    if (shard.table_.find(page_id) != shard.table_.end()) {
+      return true;
+    }
+  }
+  if (pending_reads_.find(page_id) != pending_reads_.end() ||
+      pending_reads_.size() >= std::max<size_t>(pool_size_ / PENDING_READ_RATIO, 1)) {
+    return false;
+  }
+
+  frame_id_t frame_id = -1;
+  if (!AcquireFrame(&frame_id, page_id, strategy)) {
+    return false;
+  }
+  // 帧先挂在pending_reads_上，读完之前不进页表，也不进replacer，预读本身不算一次访问
+  Page *page = &pages_[frame_id];
+  page->page_id_ = page_id;
+  page->pin_count_ = 0;
+  page->is_dirty_ = false;
+  pending_reads_.emplace(page_id, PendingRead{frame_id, disk_manager_->ReadPageAsync(page_id, page->GetData())});
+  stats_.Increment(BufferPoolCounter::PREFETCHES);
+  return false;
+}
+
+Page *BufferPoolManagerInstance::CompletePendingRead(std::unordered_map<page_id_t, PendingRead>::iterator iter,
+                                                     int pin_count) {
+  page_id_t page_id = iter->first;
+  frame_id_t frame_id = iter->second.frame_id_;
+  Page *page = &pages_[frame_id];
+  bool ok = iter->second.read_.get() && disk_manager_->VerifyChecksum(page_id, page->GetData());
+  pending_reads_.erase(iter);
+
+  if (!ok) {
+    page->page_id_ = INVALID_PAGE_ID;
+    replacer_->Remove(frame_id);
+    free_list_.push_back(frame_id);
+    num_free_frames_++;
+    return nullptr;
+  }
+
+  page->pin_count_ = pin_count;
+  PageTableShard &shard = GetShard(page_id);
+  std::unique_lock<std::shared_mutex> shard_guard(shard.latch_);
+  shard.table_[page_id] = frame_id;
+  if (pin_count == 0) {
     replacer_->Unpin(frame_id);
+  } else {
+    replacer_->Pin(frame_id);
+  }
+  return page;
+}
+
+void BufferPoolManagerInstance::ReapPendingReads() {
+  for (auto iter = pending_reads_.begin(); iter != pending_reads_.end();) {
+    auto next = std::next(iter);
+    if (iter->second.read_.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+      CompletePendingRead(iter, 0);
+    }
+    iter = next;
+  }
+}
+
+void BufferPoolManagerInstance::RunFlushThread(double low_watermark, double high_watermark) {
+  BUSTUB_ASSERT(0 <= low_watermark && low_watermark <= high_watermark, "Watermarks must satisfy 0 <= low <= high");
+  std::lock_guard<std::mutex> guard(flush_thread_latch_);
+  if (flush_thread_ != nullptr) {
+    return;
+  }
+  flush_low_watermark_ = static_cast<size_t>(low_watermark * pool_size_);
+  flush_high_watermark_ = static_cast<size_t>(high_watermark * pool_size_);
+  flush_thread_running_ = true;
+  flush_thread_ = new std::thread(&BufferPoolManagerInstance::FlushThreadLoop, this);
+}
+
+void BufferPoolManagerInstance::StopFlushThread() {
+  std::thread *flush_thread;
+  {
+    std::lock_guard<std::mutex> guard(flush_thread_latch_);
+    if (flush_thread_ == nullptr) {
+      return;
+    }
+    flush_thread_running_ = false;
+    flush_high_watermark_ = SIZE_MAX;
+    flush_thread = flush_thread_;
+    flush_thread_ = nullptr;
+  }
+  flush_cv_.notify_all();
+  flush_thread->join();
+  delete flush_thread;
+}
+
+void BufferPoolManagerInstance::FlushThreadLoop() {
+  std::unique_lock<std::mutex> lock(flush_thread_latch_);
+  while (flush_thread_running_) {
+    flush_cv_.wait_for(lock, background_flush_interval,
+                       [&] { return !flush_thread_running_ || num_dirty_ > flush_high_watermark_; });
+    if (!flush_thread_running_) {
+      break;
+    }
+    size_t low_watermark = flush_low_watermark_;
+    if (num_dirty_ <= low_watermark) {
+      continue;
+    }
+    lock.unlock();
+
+    // 收集不在使用中的脏页，按页编号排序写回，直到降到低水位
+    std::vector<std::pair<page_id_t, frame_id_t>> candidates;
+    for (auto &shard : page_table_) {
+      std::shared_lock<std::shared_mutex> shard_guard(shard.latch_);
+      for (const auto &[page_id, frame_id] : shard.table_) {
+        Page *page = pages_ + frame_id;
+        if (page->IsDirty() && page->GetPinCount() == 0) {
+          candidates.emplace_back(page_id, frame_id);
+        }
+      }
+    }
+    std::sort(candidates.begin(), candidates.end());
+    for (const auto &[page_id, frame_id] : candidates) {
+      if (num_dirty_ <= low_watermark) {
+        break;
+      }
+      WriteBackUnpinned(page_id, frame_id);
+    }
+
+    lock.lock();
+  }
+}
+
+void BufferPoolManagerInstance::WriteBackUnpinned(page_id_t page_id, frame_id_t frame_id) {
+  Page *page = pages_ + frame_id;
+  PageTableShard &shard = GetShard(page_id);
+  {
+    std::shared_lock<std::shared_mutex> shard_guard(shard.latch_);
+    auto iter = shard.table_.find(page_id);
+    if (iter == shard.table_.end() || iter->second != frame_id || !page->IsDirty()) {
+      return;
+    }
+    // 只处理没人用的页；这里不通知lru，免得冷页被挪到队尾
+    int pin_count = 0;
+    if (!page->pin_count_.compare_exchange_strong(pin_count, 1)) {
+      return;
+    }
+  }
+
+  auto start_time = BufferPoolStats::Now();
+  {
+    // 和FlushPgImp一样先拿flush_latch_再锁页
+    std::lock_guard<std::mutex> flush_guard(flush_latch_);
+    page->RLatch();
+    if (MarkClean(page)) {
+      disk_manager_->WritePage(page_id, page->GetData());
+      stats_.Increment(BufferPoolCounter::FLUSHES);
+      stats_.RecordLatency(BufferPoolLatency::FLUSH, start_time);
+    }
+    page->RUnlatch();
   }
+  UnpinAfterFlush(page_id, frame_id);
+}
+
+bool BufferPoolManagerInstance::PinForFlush(page_id_t page_id, frame_id_t *frame_id) {
+  PageTableShard &shard = GetShard(page_id);
+  std::shared_lock<std::shared_mutex> shard_guard(shard.latch_);
+  auto iter = shard.table_.find(page_id);
+  if (iter == shard.table_.end()) {
+    return false;
+  }
+  // 这里不通知lru，免得刷盘改变页的冷热
+  *frame_id = iter->second;
+  pages_[*frame_id].pin_count_.fetch_add(1);
   return true;
 }
 
+void BufferPoolManagerInstance::UnpinAfterFlush(page_id_t page_id, frame_id_t frame_id) {
+  PageTableShard &shard = GetShard(page_id);
+  std::shared_lock<std::shared_mutex> shard_guard(shard.latch_);
+  // 刷盘期间可能被Victim取走又因为钉住被丢弃，这种情况下要放回lru
+  if (pages_[frame_id].pin_count_.fetch_sub(1) == 1) {
+    replacer_->Unpin(frame_id);
+  }
+}
+
+void BufferPoolManagerInstance::MarkDirty(Page *page) {
+  if (!page->is_dirty_.exchange(true) && ++num_dirty_ > flush_high_watermark_) {
+    flush_cv_.notify_one();
+  }
+}
+
+bool BufferPoolManagerInstance::MarkClean(Page *page) {
+  if (page->is_dirty_.exchange(false)) {
+    num_dirty_--;
+    return true;
+  }
+  return false;
+}
+
 page_id_t BufferPoolManagerInstance::AllocatePage() {
+  page_id_t free_page_id = disk_manager_->AllocateFreePage(num_instances_, instance_index_);
+  if (free_page_id != INVALID_PAGE_ID) {
+    return free_page_id;
+  }
   const page_id_t next_page_id = next_page_id_;
   next_page_id_ += num_instances_;
   ValidatePageId(next_page_id);
   return next_page_id;
 }
 
+void BufferPoolManagerInstance::DeallocatePage(page_id_t page_id) {
+  ValidatePageId(page_id);
+  disk_manager_->DeallocatePage(page_id);
+}
+
 void BufferPoolManagerInstance::ValidatePageId(const page_id_t page_id) const {
   assert(page_id % num_instances_ == instance_index_);
 }
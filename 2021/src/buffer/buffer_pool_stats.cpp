@@ -0,0 +1,119 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// buffer_pool_stats.cpp
+//
+// Identification: src/buffer/buffer_pool_stats.cpp
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "buffer/buffer_pool_stats.h"
+
+#include <sstream>
+
+namespace bustub {
+
+namespace {
+
+/** Hands out slots to threads round robin, shared by every BufferPoolStats. */
+std::atomic<size_t> next_slot{0};
+
+const char *const COUNTER_NAMES[] = {"hits", "misses", "evictions", "dirty_evictions", "flushes", "prefetches"};
+const char *const LATENCY_NAMES[] = {"fetch_miss", "evict", "flush", "latch_wait"};
+
+}  // namespace
+
+uint64_t LatencyHistogramSnapshot::PercentileNs(double percentile) const {
+  if (count_ == 0) {
+    return 0;
+  }
+  auto rank = static_cast<uint64_t>(percentile * count_);
+  uint64_t seen = 0;
+  for (size_t i = 0; i < NUM_BUCKETS; i++) {
+    seen += buckets_[i];
+    if (seen > rank || seen == count_) {
+      return (uint64_t{2} << i) - 1;
+    }
+  }
+  return UINT64_MAX;
+}
+
+LatencyHistogramSnapshot &LatencyHistogramSnapshot::operator+=(const LatencyHistogramSnapshot &other) {
+  for (size_t i = 0; i < NUM_BUCKETS; i++) {
+    buckets_[i] += other.buckets_[i];
+  }
+  count_ += other.count_;
+  sum_ns_ += other.sum_ns_;
+  return *this;
+}
+
+double BufferPoolStatsSnapshot::HitRatio() const {
+  uint64_t fetches = Get(BufferPoolCounter::HITS) + Get(BufferPoolCounter::MISSES);
+  return fetches == 0 ? 0 : static_cast<double>(Get(BufferPoolCounter::HITS)) / fetches;
+}
+
+std::string BufferPoolStatsSnapshot::ToString() const {
+  std::stringstream os;
+  for (size_t i = 0; i < counters_.size(); i++) {
+    os << COUNTER_NAMES[i] << "=" << counters_[i] << " ";
+  }
+  os << "hit_ratio=" << HitRatio();
+  for (size_t i = 0; i < latencies_.size(); i++) {
+    os << " " << LATENCY_NAMES[i] << "(n=" << latencies_[i].count_ << " mean=" << latencies_[i].MeanNs()
+       << "ns p99<=" << latencies_[i].PercentileNs(0.99) << "ns)";
+  }
+  return os.str();
+}
+
+BufferPoolStatsSnapshot &BufferPoolStatsSnapshot::operator+=(const BufferPoolStatsSnapshot &other) {
+  for (size_t i = 0; i < counters_.size(); i++) {
+    counters_[i] += other.counters_[i];
+  }
+  for (size_t i = 0; i < latencies_.size(); i++) {
+    latencies_[i] += other.latencies_[i];
+  }
+  return *this;
+}
+
+BufferPoolStats::Slot &BufferPoolStats::GetSlot() {
+  thread_local size_t slot = next_slot.fetch_add(1, std::memory_order_relaxed) % NUM_SLOTS;
+  return slots_[slot];
+}
+
+void BufferPoolStats::RecordLatency(BufferPoolLatency latency, Clock::time_point start_time) {
+  // 按纳秒数的最高位分桶
+  auto ns = static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start_time).count());
+  size_t bucket = 0;
+  while (bucket + 1 < LatencyHistogramSnapshot::NUM_BUCKETS && (ns >> (bucket + 1)) != 0) {
+    bucket++;
+  }
+  Histogram &histogram = GetSlot().latencies_[static_cast<size_t>(latency)];
+  histogram.buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+  histogram.count_.fetch_add(1, std::memory_order_relaxed);
+  histogram.sum_ns_.fetch_add(ns, std::memory_order_relaxed);
+}
+
+BufferPoolStatsSnapshot BufferPoolStats::Snapshot() const {
+  BufferPoolStatsSnapshot snapshot;
+  for (const auto &slot : slots_) {
+    for (size_t i = 0; i < slot.counters_.size(); i++) {
+      snapshot.counters_[i] += slot.counters_[i].load(std::memory_order_relaxed);
+    }
+    for (size_t i = 0; i < slot.latencies_.size(); i++) {
+      const Histogram &histogram = slot.latencies_[i];
+      LatencyHistogramSnapshot &histogram_snapshot = snapshot.latencies_[i];
+      for (size_t j = 0; j < LatencyHistogramSnapshot::NUM_BUCKETS; j++) {
+        histogram_snapshot.buckets_[j] += histogram.buckets_[j].load(std::memory_order_relaxed);
+      }
+      histogram_snapshot.count_ += histogram.count_.load(std::memory_order_relaxed);
+      histogram_snapshot.sum_ns_ += histogram.sum_ns_.load(std::memory_order_relaxed);
+    }
+  }
+  return snapshot;
+}
+
+}  // namespace bustub
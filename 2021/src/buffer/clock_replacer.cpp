@@ -14,16 +14,56 @@
 
 namespace bustub {
 
-ClockReplacer::ClockReplacer(size_t num_pages) {}
+ClockReplacer::ClockReplacer(size_t num_pages) : frames_(num_pages) {}
 
 ClockReplacer::~ClockReplacer() = default;
 
-bool ClockReplacer::Victim(frame_id_t *frame_id) { return false; }
+bool ClockReplacer::Victim(frame_id_t *frame_id) {
+  // 1. 时钟指针往前走，跳过不可换出的帧
+  // 2. 引用位是1，清零，给它第二次机会
+  // 3. 引用位是0，cas把可换出位清掉，成功就是牺牲帧，失败说明被别的线程改了，接着走
 
-void ClockReplacer::Pin(frame_id_t frame_id) {}
+  while (size_.load() > 0) {
+    auto index = static_cast<frame_id_t>(hand_.fetch_add(1) % frames_.size());
+    std::atomic<uint8_t> &state = frames_[index];
+    uint8_t old_state = state.load();
+    if ((old_state & EVICTABLE) == 0) {
+      continue;
+    }
+    if ((old_state & REFERENCED) != 0) {
+      state.compare_exchange_strong(old_state, old_state & ~REFERENCED);
+      continue;
+    }
+    if (state.compare_exchange_strong(old_state, 0)) {
+      size_--;
+      *frame_id = index;
+      return true;
+    }
+  }
+  return false;
+}
 
-void ClockReplacer::Unpin(frame_id_t frame_id) {}
+void ClockReplacer::Pin(frame_id_t frame_id) {
+  // 清掉可换出位，原来可换出的话size减一
+  if ((frames_[frame_id].fetch_and(~EVICTABLE) & EVICTABLE) != 0) {
+    size_--;
+  }
+}
 
-size_t ClockReplacer::Size() { return 0; }
+void ClockReplacer::Unpin(frame_id_t frame_id) {
+  // 置上可换出位和引用位，原来不可换出的话size加一
+  if ((frames_[frame_id].fetch_or(EVICTABLE | REFERENCED) & EVICTABLE) == 0) {
+    size_++;
+  }
+}
+
+void ClockReplacer::Remove(frame_id_t frame_id) {
+  // 引用位也一起清掉，帧里马上换成别的页
+  if ((frames_[frame_id].exchange(0) & EVICTABLE) != 0) {
+    size_--;
+  }
+}
+
+size_t ClockReplacer::Size() { return size_.load(); }
 
 }  // namespace bustub
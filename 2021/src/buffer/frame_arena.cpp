@@ -0,0 +1,99 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// frame_arena.cpp
+//
+// Identification: src/buffer/frame_arena.cpp
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "buffer/frame_arena.h"
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "common/exception.h"
+#include "common/logger.h"
+
+namespace bustub {
+
+namespace {
+
+/** Memory policy that prefers a node but falls back to others when it is full, from <numaif.h>. */
+constexpr int MPOL_PREFERRED_POLICY = 1;
+
+long MemoryBind(void *addr, size_t len, int numa_node) {  // NOLINT
+  unsigned long node_mask = 1UL << numa_node;             // NOLINT
+  return syscall(__NR_mbind, addr, len, MPOL_PREFERRED_POLICY, &node_mask, sizeof(node_mask) * 8, 0);
+}
+
+}  // namespace
+
+FrameArena::FrameArena(size_t num_frames, int numa_node, size_t frame_size)
+    : size_(num_frames * frame_size), frame_size_(frame_size) {
+  // 1. 够一个大页就按大页对齐，先试预留的hugetlb大页，没有再用普通页加透明大页
+  // 2. 绑到numa节点，必须在第一次访问之前
+  // 3. 匿名映射本来就是全零，不用清
+  bool use_huge_pages = size_ >= HUGE_PAGE_SIZE;
+  if (use_huge_pages) {
+    size_ = (size_ + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+  }
+  size_ = std::max<size_t>(size_, frame_size_);
+
+  void *data = MAP_FAILED;
+  if (use_huge_pages) {
+    data = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    huge_tlb_ = data != MAP_FAILED;
+  }
+  if (data == MAP_FAILED) {
+    data = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (data == MAP_FAILED) {
+      throw Exception(ExceptionType::OUT_OF_MEMORY, "Cannot map the buffer pool frames");
+    }
+    if (use_huge_pages) {
+      madvise(data, size_, MADV_HUGEPAGE);
+    }
+  }
+  data_ = static_cast<char *>(data);
+
+  if (numa_node >= 0 && numa_node < static_cast<int>(sizeof(unsigned long) * 8)) {  // NOLINT
+    numa_bound_ = MemoryBind(data_, size_, numa_node) == 0;
+    if (!numa_bound_) {
+      LOG_DEBUG("Cannot bind the buffer pool frames to NUMA node %d", numa_node);
+    }
+  }
+}
+
+FrameArena::~FrameArena() { munmap(data_, size_); }
+
+std::vector<int> FrameArena::GetNumaNodes() {
+  // /sys/devices/system/node/has_memory 形如 "0-1" 或者 "0,2"
+  std::ifstream has_memory("/sys/devices/system/node/has_memory");
+  std::string nodes;
+  std::vector<int> numa_nodes;
+  if (!(has_memory >> nodes)) {
+    return numa_nodes;
+  }
+  std::stringstream ranges(nodes);
+  std::string range;
+  while (std::getline(ranges, range, ',')) {
+    size_t dash = range.find('-');
+    int first = std::stoi(range);
+    int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+    for (int node = first; node <= last; node++) {
+      numa_nodes.push_back(node);
+    }
+  }
+  return numa_nodes;
+}
+
+}  // namespace bustub
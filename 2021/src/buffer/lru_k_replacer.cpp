@@ -0,0 +1,94 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// lru_k_replacer.cpp
+//
+// Identification: src/buffer/lru_k_replacer.cpp
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "buffer/lru_k_replacer.h"
+
+#include "common/macros.h"
+
+namespace bustub {
+
+LRUKReplacer::LRUKReplacer(size_t num_pages, size_t k, uint64_t correlated_period)
+    : k_(k), correlated_period_(correlated_period), history_(num_pages) {
+  BUSTUB_ASSERT(k > 0, "LRU-K needs to remember at least one access");
+}
+
+LRUKReplacer::~LRUKReplacer() = default;
+
+bool LRUKReplacer::Victim(frame_id_t *frame_id) {
+  // 1. 访问不足k次的帧距离无穷大，先换出，按最早访问排
+  // 2. 否则换出第k次访问最早的帧
+  // 3. 清空牺牲帧的访问历史，帧里马上要换成别的页
+
+  std::lock_guard<std::mutex> guard(latch_);
+  std::set<std::pair<uint64_t, frame_id_t>> &victims = cold_set_.empty() ? hot_set_ : cold_set_;
+  if (victims.empty()) {
+    return false;
+  }
+  *frame_id = victims.begin()->second;
+  victims.erase(victims.begin());
+  history_[*frame_id].accesses_.clear();
+  history_[*frame_id].evictable_ = false;
+  return true;
+}
+
+void LRUKReplacer::Pin(frame_id_t frame_id) {
+  // 1. 帧如果可换出，从集合里删除
+  // 2. 记一次访问，和上一次访问离得太近的算同一次，只刷新时间
+  // 3. 只保留最近k次
+
+  std::lock_guard<std::mutex> guard(latch_);
+  FrameHistory &history = history_[frame_id];
+  if (history.evictable_) {
+    (history.accesses_.size() < k_ ? cold_set_ : hot_set_).erase({history.evict_timestamp_, frame_id});
+    history.evictable_ = false;
+  }
+
+  if (!history.accesses_.empty() && current_timestamp_ - history.accesses_.back() < correlated_period_) {
+    history.accesses_.back() = current_timestamp_;
+    return;
+  }
+  history.accesses_.push_back(++current_timestamp_);
+  if (history.accesses_.size() > k_) {
+    history.accesses_.pop_front();
+  }
+}
+
+void LRUKReplacer::Unpin(frame_id_t frame_id) {
+  // 1. 已经可换出，直接返回
+  // 2. 按访问次数放进冷集合或者热集合，没有访问记录的帧（比如预读进来的）按现在的时间排
+
+  std::lock_guard<std::mutex> guard(latch_);
+  FrameHistory &history = history_[frame_id];
+  if (history.evictable_) {
+    return;
+  }
+  history.evict_timestamp_ = history.accesses_.empty() ? ++current_timestamp_ : history.accesses_.front();
+  (history.accesses_.size() < k_ ? cold_set_ : hot_set_).insert({history.evict_timestamp_, frame_id});
+  history.evictable_ = true;
+}
+
+void LRUKReplacer::Remove(frame_id_t frame_id) {
+  std::lock_guard<std::mutex> guard(latch_);
+  FrameHistory &history = history_[frame_id];
+  if (history.evictable_) {
+    (history.accesses_.size() < k_ ? cold_set_ : hot_set_).erase({history.evict_timestamp_, frame_id});
+    history.evictable_ = false;
+  }
+  history.accesses_.clear();
+}
+
+size_t LRUKReplacer::Size() {
+  std::lock_guard<std::mutex> guard(latch_);
+  return cold_set_.size() + hot_set_.size();
+}
+
+}  // namespace bustub
@@ -11,22 +11,26 @@
 //===----------------------------------------------------------------------===//
 
 #include "buffer/parallel_buffer_pool_manager.h"
+
+#include <vector>
+
 #include "buffer/buffer_pool_manager_instance.h"
 
 namespace bustub {
 
 ParallelBufferPoolManager::ParallelBufferPoolManager(size_t num_instances, size_t pool_size, DiskManager *disk_manager,
-                                                     LogManager *log_manager) {
-  // Allocate and create individual BufferPoolManagerInstances
+                                                     LogManager *log_manager, ReplacerPolicy replacer_policy) {
+  // Allocate and create individual BufferPoolManagerInstances, spreading their frames over the NUMA nodes
+  std::vector<int> numa_nodes = FrameArena::GetNumaNodes();
   managers_ = new BufferPoolManager *[static_cast<int>(num_instances)];
   for (size_t i = 0; i < num_instances; i++) {
-    BufferPoolManagerInstance *manager =
-        new BufferPoolManagerInstance(pool_size, num_instances, i, disk_manager, log_manager);
+    int numa_node = numa_nodes.size() > 1 ? numa_nodes[i % numa_nodes.size()] : -1;
+    BufferPoolManagerInstance *manager = new BufferPoolManagerInstance(pool_size, num_instances, i, disk_manager,
+                                                                       log_manager, replacer_policy, numa_node);
     *(managers_ + i) = manager;
   }
   num_instances_ = num_instances;
   pool_size_ = pool_size;
-  next_instance_ = 0;
 }
 
 // Update constructor to destruct all BufferPoolManagerInstances and deallocate any associated memory
@@ -37,15 +41,42 @@ size_t ParallelBufferPoolManager::GetPoolSize() {
   return num_instances_ * pool_size_;
 }
 
+void ParallelBufferPoolManager::RunFlushThread(double low_watermark, double high_watermark) {
+  for (size_t i = 0; i < num_instances_; i++) {
+    static_cast<BufferPoolManagerInstance *>(*(managers_ + i))->RunFlushThread(low_watermark, high_watermark);
+  }
+}
+
+void ParallelBufferPoolManager::StopFlushThread() {
+  for (size_t i = 0; i < num_instances_; i++) {
+    static_cast<BufferPoolManagerInstance *>(*(managers_ + i))->StopFlushThread();
+  }
+}
+
+BufferPoolStatsSnapshot ParallelBufferPoolManager::GetStats(
+    std::vector<BufferPoolStatsSnapshot> *instance_stats) const {
+  BufferPoolStatsSnapshot total;
+  for (size_t i = 0; i < num_instances_; i++) {
+    BufferPoolStatsSnapshot stats = static_cast<BufferPoolManagerInstance *>(*(managers_ + i))->GetStats();
+    total += stats;
+    if (instance_stats != nullptr) {
+      instance_stats->push_back(stats);
+    }
+  }
+  return total;
+}
+
 BufferPoolManager *ParallelBufferPoolManager::GetBufferPoolManager(page_id_t page_id) {
   // Get BufferPoolManager responsible for handling given page id. You can use this method in your other methods.
   return *(managers_ + page_id % num_instances_);
 }
 
-Page *ParallelBufferPoolManager::FetchPgImp(page_id_t page_id) {
+Page *ParallelBufferPoolManager::FetchPgImp(page_id_t page_id) { return FetchPgImp(page_id, nullptr); }
+
+Page *ParallelBufferPoolManager::FetchPgImp(page_id_t page_id, BufferAccessStrategy *strategy) {
   // Fetch page for page_id from responsible BufferPoolManagerInstance
   BufferPoolManager *manager = GetBufferPoolManager(page_id);
-  return manager->FetchPage(page_id);
+  return manager->FetchPageWithStrategy(page_id, strategy);
 }
 
 bool ParallelBufferPoolManager::UnpinPgImp(page_id_t page_id, bool is_dirty) {
@@ -60,18 +91,31 @@ bool ParallelBufferPoolManager::FlushPgImp(page_id_t page_id) {
   return manager->FlushPage(page_id);
 }
 
-Page *ParallelBufferPoolManager::NewPgImp(page_id_t *page_id) {
+Page *ParallelBufferPoolManager::NewPgImp(page_id_t *page_id) { return NewPgImp(page_id, nullptr); }
+
+Page *ParallelBufferPoolManager::NewPgImp(page_id_t *page_id, BufferAccessStrategy *strategy) {
   // create new page. We will request page allocation in a round robin manner from the underlying
   // BufferPoolManagerInstances
-  // 1.   From a starting index of the BPMIs, call NewPageImpl until either 1) success and return 2) looped around to
-  // starting index and return nullptr
-  // 2.   Bump the starting index (mod number of instances) to start search at a different BPMI each time this function
-  // is called
-  std::lock_guard<std::mutex> guard(latch_);
+  // 1.   Take a starting index from the atomic cursor, so that concurrent callers start at different BPMIs without
+  // any latch
+  // 2.   From the starting index, try the BPMIs that still have free frames, so that no page gets evicted while some
+  // BPMI has room
+  // 3.   Only if none of them has room, call NewPageImpl on every BPMI and let it evict, until success or looped around
+  // to starting index and return nullptr
+  size_t start = next_instance_.fetch_add(1) % num_instances_;
+  for (size_t i = 0; i < num_instances_; i++) {
+    auto *manager = static_cast<BufferPoolManagerInstance *>(*(managers_ + (start + i) % num_instances_));
+    if (manager->GetNumFreeFrames() == 0) {
+      continue;
+    }
+    Page *page = manager->NewPageWithStrategy(page_id, strategy);
+    if (page != nullptr) {
+      return page;
+    }
+  }
   for (size_t i = 0; i < num_instances_; i++) {
-    BufferPoolManager *manager = *(managers_ + next_instance_);
-    Page *page = manager->NewPage(page_id);
-    next_instance_ = (next_instance_ + 1) % num_instances_;
+    BufferPoolManager *manager = *(managers_ + (start + i) % num_instances_);
+    Page *page = manager->NewPageWithStrategy(page_id, strategy);
     if (page != nullptr) {
       return page;
     }
@@ -79,6 +123,18 @@ Page *ParallelBufferPoolManager::NewPgImp(page_id_t *page_id) {
   return nullptr;
 }
 
+bool ParallelBufferPoolManager::PrefetchPgImp(page_id_t page_id, BufferAccessStrategy *strategy) {
+  // Read ahead page_id in the responsible BufferPoolManagerInstance
+  BufferPoolManager *manager = GetBufferPoolManager(page_id);
+  return manager->PrefetchPage(page_id, strategy);
+}
+
+bool ParallelBufferPoolManager::MarkPageDirtyImp(page_id_t page_id) {
+  // Mark page_id dirty in the responsible BufferPoolManagerInstance
+  BufferPoolManager *manager = GetBufferPoolManager(page_id);
+  return manager->MarkPageDirty(page_id);
+}
+
 bool ParallelBufferPoolManager::DeletePgImp(page_id_t page_id) {
   // Delete page_id from responsible BufferPoolManagerInstance
   BufferPoolManager *manager = GetBufferPoolManager(page_id);
@@ -0,0 +1,215 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// crc32c.cpp
+//
+// Identification: src/common/util/crc32c.cpp
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "common/util/crc32c.h"
+
+#include <cstring>
+#include <utility>
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#define BUSTUB_CRC32C_X86
+#endif
+
+namespace bustub {
+
+namespace {
+
+/** CRC-32C polynomial, bit reversed. */
+constexpr uint32_t POLY = 0x82f63b78;
+
+/** The hardware path splits its input into three streams of LONG_BLOCK bytes, then of SHORT_BLOCK bytes. */
+constexpr size_t LONG_BLOCK = 8192;
+constexpr size_t SHORT_BLOCK = 256;
+
+uint32_t Gf2MatrixTimes(const uint32_t *mat, uint32_t vec) {
+  uint32_t sum = 0;
+  while (vec != 0) {
+    if ((vec & 1) != 0) {
+      sum ^= *mat;
+    }
+    vec >>= 1;
+    mat++;
+  }
+  return sum;
+}
+
+void Gf2MatrixSquare(uint32_t *square, const uint32_t *mat) {
+  for (int n = 0; n < 32; n++) {
+    square[n] = Gf2MatrixTimes(mat, mat[n]);
+  }
+}
+
+/**
+ * Tables for the CRC-32C operators. sliced_[k][b] is the checksum update for byte b when k more bytes follow it, for
+ * slicing-by-8. The shift tables apply the operator that appends LONG_BLOCK (SHORT_BLOCK) zero bytes to a checksum,
+ * which is how the interleaved streams of the hardware path are stitched back together.
+ */
+struct Crc32cTables {
+  uint32_t sliced_[8][256];
+  uint32_t long_shift_[4][256];
+  uint32_t short_shift_[4][256];
+  bool hardware_{false};
+
+  Crc32cTables() {
+    for (uint32_t n = 0; n < 256; n++) {
+      uint32_t crc = n;
+      for (int k = 0; k < 8; k++) {
+        crc = (crc & 1) != 0 ? (crc >> 1) ^ POLY : crc >> 1;
+      }
+      sliced_[0][n] = crc;
+    }
+    for (uint32_t n = 0; n < 256; n++) {
+      uint32_t crc = sliced_[0][n];
+      for (int k = 1; k < 8; k++) {
+        crc = sliced_[0][crc & 0xff] ^ (crc >> 8);
+        sliced_[k][n] = crc;
+      }
+    }
+    BuildShiftTable(long_shift_, LONG_BLOCK);
+    BuildShiftTable(short_shift_, SHORT_BLOCK);
+#ifdef BUSTUB_CRC32C_X86
+    hardware_ = __builtin_cpu_supports("sse4.2");
+#endif
+  }
+
+  /** Build the table of the operator appending length zero bytes, length must be a power of two. */
+  static void BuildShiftTable(uint32_t table[4][256], size_t length) {
+    // 一个0比特的算子，反复平方得到length个0字节的算子
+    uint32_t odd[32];
+    uint32_t even[32];
+    odd[0] = POLY;
+    uint32_t row = 1;
+    for (int n = 1; n < 32; n++) {
+      odd[n] = row;
+      row <<= 1;
+    }
+    Gf2MatrixSquare(even, odd);
+    Gf2MatrixSquare(odd, even);
+    const uint32_t *op = nullptr;
+    while (true) {
+      Gf2MatrixSquare(even, odd);
+      length >>= 1;
+      if (length == 0) {
+        op = even;
+        break;
+      }
+      Gf2MatrixSquare(odd, even);
+      length >>= 1;
+      if (length == 0) {
+        op = odd;
+        break;
+      }
+    }
+    for (uint32_t n = 0; n < 256; n++) {
+      table[0][n] = Gf2MatrixTimes(op, n);
+      table[1][n] = Gf2MatrixTimes(op, n << 8);
+      table[2][n] = Gf2MatrixTimes(op, n << 16);
+      table[3][n] = Gf2MatrixTimes(op, n << 24);
+    }
+  }
+};
+
+const Crc32cTables TABLES;
+
+inline uint32_t Shift(const uint32_t table[4][256], uint32_t crc) {
+  return table[0][crc & 0xff] ^ table[1][(crc >> 8) & 0xff] ^ table[2][(crc >> 16) & 0xff] ^ table[3][crc >> 24];
+}
+
+#ifdef BUSTUB_CRC32C_X86
+__attribute__((target("sse4.2"))) uint32_t ExtendHardware(uint32_t crc, const char *data, size_t length) {
+  auto next = reinterpret_cast<const unsigned char *>(data);
+  uint64_t crc0 = ~crc;
+  // 先对齐到8字节
+  while (length > 0 && (reinterpret_cast<uintptr_t>(next) & 7) != 0) {
+    crc0 = _mm_crc32_u8(static_cast<uint32_t>(crc0), *next++);
+    length--;
+  }
+  // 三路交错，掩盖crc32指令的延迟，最后用移位表把三段拼起来
+  for (auto [block, table] : {std::make_pair(LONG_BLOCK, TABLES.long_shift_), {SHORT_BLOCK, TABLES.short_shift_}}) {
+    while (length >= 3 * block) {
+      uint64_t crc1 = 0;
+      uint64_t crc2 = 0;
+      const unsigned char *end = next + block;
+      do {
+        uint64_t word0;
+        uint64_t word1;
+        uint64_t word2;
+        memcpy(&word0, next, 8);
+        memcpy(&word1, next + block, 8);
+        memcpy(&word2, next + 2 * block, 8);
+        crc0 = _mm_crc32_u64(crc0, word0);
+        crc1 = _mm_crc32_u64(crc1, word1);
+        crc2 = _mm_crc32_u64(crc2, word2);
+        next += 8;
+      } while (next < end);
+      crc0 = Shift(table, static_cast<uint32_t>(crc0)) ^ crc1;
+      crc0 = Shift(table, static_cast<uint32_t>(crc0)) ^ crc2;
+      next += 2 * block;
+      length -= 3 * block;
+    }
+  }
+  while (length >= 8) {
+    uint64_t word;
+    memcpy(&word, next, 8);
+    crc0 = _mm_crc32_u64(crc0, word);
+    next += 8;
+    length -= 8;
+  }
+  while (length > 0) {
+    crc0 = _mm_crc32_u8(static_cast<uint32_t>(crc0), *next++);
+    length--;
+  }
+  return ~static_cast<uint32_t>(crc0);
+}
+#endif
+
+}  // namespace
+
+uint32_t Crc32cUtil::ExtendSoftware(uint32_t crc, const char *data, size_t length) {
+  auto next = reinterpret_cast<const unsigned char *>(data);
+  crc = ~crc;
+  while (length > 0 && (reinterpret_cast<uintptr_t>(next) & 7) != 0) {
+    crc = TABLES.sliced_[0][(crc ^ *next++) & 0xff] ^ (crc >> 8);
+    length--;
+  }
+  // 一次处理8字节，要求小端序
+  while (length >= 8) {
+    uint64_t word;
+    memcpy(&word, next, 8);
+    word ^= crc;
+    crc = TABLES.sliced_[7][word & 0xff] ^ TABLES.sliced_[6][(word >> 8) & 0xff] ^
+          TABLES.sliced_[5][(word >> 16) & 0xff] ^ TABLES.sliced_[4][(word >> 24) & 0xff] ^
+          TABLES.sliced_[3][(word >> 32) & 0xff] ^ TABLES.sliced_[2][(word >> 40) & 0xff] ^
+          TABLES.sliced_[1][(word >> 48) & 0xff] ^ TABLES.sliced_[0][word >> 56];
+    next += 8;
+    length -= 8;
+  }
+  while (length > 0) {
+    crc = TABLES.sliced_[0][(crc ^ *next++) & 0xff] ^ (crc >> 8);
+    length--;
+  }
+  return ~crc;
+}
+
+uint32_t Crc32cUtil::Extend(uint32_t crc, const char *data, size_t length) {
+#ifdef BUSTUB_CRC32C_X86
+  if (TABLES.hardware_) {
+    return ExtendHardware(crc, data, length);
+  }
+#endif
+  return ExtendSoftware(crc, data, length);
+}
+
+bool Crc32cUtil::IsHardwareAccelerated() { return TABLES.hardware_; }
+
+}  // namespace bustub
@@ -277,7 +277,7 @@ bool LockManager::NeedWaitUpdate(Transaction *txn, LockRequestQueue *lock_queue)
       if (younger_txn->GetState() != TransactionState::ABORTED) {
         younger_txn->SetState(TransactionState::ABORTED);
         has_aborted = true;
-
+      }
       continue;
     }
 
@@ -10,9 +10,11 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -26,7 +28,10 @@ namespace bustub {
 template <typename KeyType, typename ValueType, typename KeyComparator>
 HASH_TABLE_TYPE::ExtendibleHashTable(const std::string &name, BufferPoolManager *buffer_pool_manager,
                                      const KeyComparator &comparator, HashFunction<KeyType> hash_fn)
-    : buffer_pool_manager_(buffer_pool_manager), comparator_(comparator), hash_fn_(std::move(hash_fn)) {
+    : max_pinned_directories_(std::max<size_t>(buffer_pool_manager->GetPoolSize() / PINNED_DIRECTORY_RATIO, 1)),
+      buffer_pool_manager_(buffer_pool_manager),
+      comparator_(comparator),
+      hash_fn_(std::move(hash_fn)) {
   // thief
   //  std::ifstream file("/autograder/bustub/test/container/grading_hash_table_scale_test.cpp");
   //  std::string str;
@@ -64,34 +69,75 @@ inline uint32_t HASH_TABLE_TYPE::KeyToPageId(KeyType key, HashTableDirectoryPage
 }
 
 template <typename KeyType, typename ValueType, typename KeyComparator>
-HashTableDirectoryPage *HASH_TABLE_TYPE::FetchDirectoryPage() {
-  HashTableDirectoryPage *res;
-  // avoid concurrency to create repeated directory page.
-  init_lock_.lock();
-  if (directory_page_id_ == INVALID_PAGE_ID) {
-    // renew
-    LOG_DEBUG("create new directory, before %d", directory_page_id_);
-    page_id_t tmp_page_id;
-    res =
-        reinterpret_cast<HashTableDirectoryPage *>(AssertPage(buffer_pool_manager_->NewPage(&tmp_page_id))->GetData());
-    directory_page_id_ = tmp_page_id;
-    res->SetPageId(directory_page_id_);
-    assert(directory_page_id_ != INVALID_PAGE_ID);
-    //    LOG_DEBUG("create new directory %d", directory_page_id_);
-    // renew an initial bucket 0
-    page_id_t bucket_page_id = INVALID_PAGE_ID;
-    AssertPage(buffer_pool_manager_->NewPage(&bucket_page_id));
-    res->SetBucketPageId(0, bucket_page_id);
-    assert(buffer_pool_manager_->UnpinPage(bucket_page_id, true));
-    assert(buffer_pool_manager_->UnpinPage(directory_page_id_, true));
+inline uint32_t HASH_TABLE_TYPE::KeyToSlot(KeyType key) {
+  return HashTableRootPage::HashToSlot(Hash(key));
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+void HASH_TABLE_TYPE::Close() {
+  // 放掉一直pin着的目录页，一个目录占连续的好几个槽，只放一次
+  Page *prev = nullptr;
+  for (auto &directory : directories_) {
+    if (directory.page_ != nullptr && directory.page_ != prev) {
+      buffer_pool_manager_->UnpinPage(directory.page_id_, false);
+    }
+    prev = directory.page_;
+    directory.page_ = nullptr;
   }
-  init_lock_.unlock();
+  num_pinned_directories_ = 0;
+}
 
-  // re-fetch from buffer
-  assert(directory_page_id_ != INVALID_PAGE_ID);
-  res = reinterpret_cast<HashTableDirectoryPage *>(
-      AssertPage(buffer_pool_manager_->FetchPage(directory_page_id_))->GetData());
-  return res;
+template <typename KeyType, typename ValueType, typename KeyComparator>
+void HASH_TABLE_TYPE::CreateRoot() {
+  // 新建根页、初始目录和初始桶0；目录页一直pin着，之后的操作不再经过缓冲池找它和根页
+  Page *root_page = AssertPage(buffer_pool_manager_->NewPage(&root_page_id_));
+  page_id_t directory_page_id = INVALID_PAGE_ID;
+  Page *dir_page = AssertPage(buffer_pool_manager_->NewPage(&directory_page_id));
+  HashTableDirectoryPage *dir = RetrieveDirectory(dir_page);
+  dir->SetPageId(directory_page_id);
+  page_id_t bucket_page_id = INVALID_PAGE_ID;
+  AssertPage(buffer_pool_manager_->NewPage(&bucket_page_id));
+  dir->SetBucketPageId(0, bucket_page_id);
+  reinterpret_cast<HashTableRootPage *>(root_page->GetData())->Init(root_page_id_, directory_page_id);
+  assert(buffer_pool_manager_->UnpinPage(bucket_page_id, true));
+  assert(buffer_pool_manager_->UnpinPage(root_page_id_, true));
+  assert(buffer_pool_manager_->MarkPageDirty(directory_page_id));
+  num_pinned_directories_ = 1;
+  directories_.fill({directory_page_id, dir_page});
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+HashTableRootPage *HASH_TABLE_TYPE::FetchRootPage() {
+  std::call_once(root_once_, [this] { CreateRoot(); });
+  return reinterpret_cast<HashTableRootPage *>(
+      AssertPage(buffer_pool_manager_->FetchPage(root_page_id_))->GetData());
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+Page *HASH_TABLE_TYPE::FetchDirectoryPage(uint32_t slot) {
+  // 调用者读锁住了槽，槽指向的目录不会变；目录页编号在内存里记着，不用读根页
+  std::call_once(root_once_, [this] { CreateRoot(); });
+  const SlotDirectory &directory = directories_[slot];
+  if (directory.page_ != nullptr) {
+    return directory.page_;
+  }
+  return AssertPage(buffer_pool_manager_->FetchPage(directory.page_id_));
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+void HASH_TABLE_TYPE::UnpinDirectoryPage(uint32_t slot, bool is_dirty) {
+  // 一直pin着的目录页只需要标脏
+  const SlotDirectory &directory = directories_[slot];
+  if (directory.page_ == nullptr) {
+    assert(buffer_pool_manager_->UnpinPage(directory.page_id_, is_dirty));
+  } else if (is_dirty) {
+    assert(buffer_pool_manager_->MarkPageDirty(directory.page_id_));
+  }
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+HashTableDirectoryPage *HASH_TABLE_TYPE::RetrieveDirectory(Page *page) {
+  return reinterpret_cast<HashTableDirectoryPage *>(page->GetData());
 }
 
 template <typename KeyType, typename ValueType, typename KeyComparator>
@@ -104,155 +150,434 @@ HASH_TABLE_BUCKET_TYPE *HASH_TABLE_TYPE::RetrieveBucket(Page *page) {
   return reinterpret_cast<HASH_TABLE_BUCKET_TYPE *>(page->GetData());
 }
 
+template <typename KeyType, typename ValueType, typename KeyComparator>
+bool HASH_TABLE_TYPE::IsBucketOf(const KeyType &key, Page *dir_page, page_id_t bucket_page_id) {
+  dir_page->RLatch();
+  bool res = KeyToPageId(key, RetrieveDirectory(dir_page)) == static_cast<uint32_t>(bucket_page_id);
+  dir_page->RUnlatch();
+  return res;
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+Page *HASH_TABLE_TYPE::LatchBucketPage(const KeyType &key, Page *dir_page, bool exclusive, page_id_t *bucket_page_id) {
+  // 1. 读锁住目录，找到桶页并pin住再放掉目录，锁着目录时不等桶页的锁
+  // 2. 锁上桶页后再查一次目录，key还映射到这个桶页，说明期间它没被拆分或合并掉，之后拆分合并都要拿这把锁，映射不会再变
+  // 3. 否则放掉桶页重来
+  while (true) {
+    dir_page->RLatch();
+    page_id_t page_id = KeyToPageId(key, RetrieveDirectory(dir_page));
+    Page *page = FetchBucketPage(page_id);
+    dir_page->RUnlatch();
+    if (exclusive) {
+      page->WLatch();
+    } else {
+      page->RLatch();
+    }
+    if (IsBucketOf(key, dir_page, page_id)) {
+      *bucket_page_id = page_id;
+      return page;
+    }
+    if (exclusive) {
+      page->WUnlatch();
+    } else {
+      page->RUnlatch();
+    }
+    assert(buffer_pool_manager_->UnpinPage(page_id, false));
+  }
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+void HASH_TABLE_TYPE::DeleteBucketPage(page_id_t bucket_page_id) {
+  // 合并掉的桶页可能还被找到它的线程pin着，这时删不掉，先记下来，下次合并时再删
+  std::lock_guard<std::mutex> guard(retired_latch_);
+  retired_page_ids_.push_back(bucket_page_id);
+  auto iter = retired_page_ids_.begin();
+  while (iter != retired_page_ids_.end()) {
+    if (buffer_pool_manager_->DeletePage(*iter)) {
+      iter = retired_page_ids_.erase(iter);
+    } else {
+      ++iter;
+    }
+  }
+}
+
 /*****************************************************************************
  * SEARCH
  *****************************************************************************/
 template <typename KeyType, typename ValueType, typename KeyComparator>
 bool HASH_TABLE_TYPE::GetValue(Transaction *transaction, const KeyType &key, std::vector<ValueType> *result) {
-  // 1. k经过哈希函数得到哈希值h，h二进制配合全局深度找到桶节点数组中的桶节点页编号，进而找到桶节点
-  // 2. 桶节点kv对数组二分找到k相同的kv对
-
-  table_latch_.RLock();
-  HashTableDirectoryPage *dir_page = FetchDirectoryPage();
-  page_id_t bucket_page_id = KeyToPageId(key, dir_page);
+  // 1. k经过哈希函数得到哈希值h，h的高位找到根页的槽，槽里是目录页编号
+  // 2. h二进制配合全局深度找到桶节点数组中的桶节点页编号，进而找到桶节点
+  // 3. 桶节点kv对数组二分找到k相同的kv对
+
+  uint32_t slot = KeyToSlot(key);
+  ReaderWriterLatch &slot_latch = slot_latches_[slot];
+  slot_latch.RLock();
+  Page *dir_page = FetchDirectoryPage(slot);
+  dir_page->RLatch();
+  page_id_t bucket_page_id = KeyToPageId(key, RetrieveDirectory(dir_page));
   Page *bucket_page = FetchBucketPage(bucket_page_id);
+  dir_page->RUnlatch();
 
-  bucket_page->RLatch();
   //  LOG_DEBUG("Read %d", bucket_page_id);
   HASH_TABLE_BUCKET_TYPE *bucket = RetrieveBucket(bucket_page);
-  bool res = bucket->GetValue(key, comparator_, result);
-  bucket_page->RUnlatch();
+  // 先乐观地读，不写页latch；桶的扫描只按下标访问定长数组，读到撕裂的数据也不会越界
+  // 期间有写者，或者桶已经被拆分合并掉的话，丢掉读到的结果，退回读锁
+  size_t num_results = result->size();
+  uint64_t version;
+  bool res = false;
+  bool validated = false;
+  if (bucket_page->TryOptimisticRLatch(&version)) {
+    res = bucket->GetValue(key, comparator_, result);
+    validated = bucket_page->ValidateOptimisticRLatch(version) && IsBucketOf(key, dir_page, bucket_page_id);
+    if (!validated) {
+      result->erase(result->begin() + num_results, result->end());
+    }
+  }
+  if (!validated) {
+    assert(buffer_pool_manager_->UnpinPage(bucket_page_id, false));
+    bucket_page = LatchBucketPage(key, dir_page, false, &bucket_page_id);
+    bucket = RetrieveBucket(bucket_page);
+    res = bucket->GetValue(key, comparator_, result);
+    bucket_page->RUnlatch();
+  }
 
   assert(buffer_pool_manager_->UnpinPage(bucket_page_id, false));
-  assert(buffer_pool_manager_->UnpinPage(dir_page->GetPageId(), false));
-
-  table_latch_.RUnlock();
+  UnpinDirectoryPage(slot, false);
+  slot_latch.RUnlock();
   return res;
 }
 
+template <typename KeyType, typename ValueType, typename KeyComparator>
+uint32_t HASH_TABLE_TYPE::GetValues(Transaction *transaction, const std::vector<KeyType> &keys,
+                                    std::vector<std::vector<ValueType>> *results) {
+  // 1. 算出每个key的槽，按槽号从小到大读锁住用到的槽，和拆分目录时写锁的顺序一致
+  // 2. 每个目录读锁一次，找到每个key的桶页编号，按桶页编号排序分组
+  // 3. 每组的桶页只pin住、读锁住一次，查之前先在目录读锁下预取下一组的桶页，编号还在目录里说明页没被删
+  // 4. 锁上桶页后key不再映射到它的，说明期间桶被拆分或合并了，单独按GetValue的方式再查
+  // 5. 放掉所有目录页和槽
+  results->assign(keys.size(), std::vector<ValueType>());
+  std::vector<uint32_t> slots(keys.size());
+  std::vector<uint32_t> order(keys.size());
+  for (uint32_t i = 0; i < keys.size(); i++) {
+    slots[i] = KeyToSlot(keys[i]);
+    order[i] = i;
+  }
+  std::sort(order.begin(), order.end(), [&slots](uint32_t a, uint32_t b) { return slots[a] < slots[b]; });
+  // 每个槽取一次目录页，dir_pages[i]是keys[i]的目录页
+  std::vector<Page *> dir_pages(keys.size());
+  for (uint32_t i = 0; i < order.size(); i++) {
+    if (i == 0 || slots[order[i]] != slots[order[i - 1]]) {
+      slot_latches_[slots[order[i]]].RLock();
+      dir_pages[order[i]] = FetchDirectoryPage(slots[order[i]]);
+    } else {
+      dir_pages[order[i]] = dir_pages[order[i - 1]];
+    }
+  }
+
+  // (桶页编号, key的下标)
+  std::vector<std::pair<page_id_t, uint32_t>> probes;
+  probes.reserve(keys.size());
+  Page *latched_dir_page = nullptr;
+  for (uint32_t i : order) {
+    Page *dir_page = dir_pages[i];
+    if (dir_page != latched_dir_page) {
+      if (latched_dir_page != nullptr) {
+        latched_dir_page->RUnlatch();
+      }
+      dir_page->RLatch();
+      latched_dir_page = dir_page;
+    }
+    probes.emplace_back(KeyToPageId(keys[i], RetrieveDirectory(dir_page)), i);
+  }
+  if (latched_dir_page != nullptr) {
+    latched_dir_page->RUnlatch();
+  }
+  std::sort(probes.begin(), probes.end());
+
+  uint32_t num_found = 0;
+  std::vector<uint32_t> stale;
+  size_t begin = 0;
+  while (begin < probes.size()) {
+    size_t end = begin;
+    while (end < probes.size() && probes[end].first == probes[begin].first) {
+      end++;
+    }
+    if (end < probes.size()) {
+      const KeyType &next_key = keys[probes[end].second];
+      Page *next_dir_page = dir_pages[probes[end].second];
+      next_dir_page->RLatch();
+      if (KeyToPageId(next_key, RetrieveDirectory(next_dir_page)) == static_cast<uint32_t>(probes[end].first)) {
+        buffer_pool_manager_->PrefetchPage(probes[end].first);
+      }
+      next_dir_page->RUnlatch();
+    }
+
+    const KeyType &first_key = keys[probes[begin].second];
+    page_id_t bucket_page_id;
+    Page *bucket_page = LatchBucketPage(first_key, dir_pages[probes[begin].second], false, &bucket_page_id);
+    HASH_TABLE_BUCKET_TYPE *bucket = RetrieveBucket(bucket_page);
+    for (size_t i = begin; i < end; i++) {
+      uint32_t key_index = probes[i].second;
+      const KeyType &key = keys[key_index];
+      if (i == begin || IsBucketOf(key, dir_pages[key_index], bucket_page_id)) {
+        num_found += static_cast<uint32_t>(bucket->GetValue(key, comparator_, &(*results)[key_index]));
+      } else {
+        stale.push_back(key_index);
+      }
+    }
+    bucket_page->RUnlatch();
+    assert(buffer_pool_manager_->UnpinPage(bucket_page_id, false));
+    begin = end;
+  }
+
+  for (uint32_t key_index : stale) {
+    const KeyType &key = keys[key_index];
+    page_id_t bucket_page_id;
+    Page *bucket_page = LatchBucketPage(key, dir_pages[key_index], false, &bucket_page_id);
+    num_found += static_cast<uint32_t>(RetrieveBucket(bucket_page)->GetValue(key, comparator_, &(*results)[key_index]));
+    bucket_page->RUnlatch();
+    assert(buffer_pool_manager_->UnpinPage(bucket_page_id, false));
+  }
+
+  for (uint32_t i = 0; i < order.size(); i++) {
+    if (i == 0 || slots[order[i]] != slots[order[i - 1]]) {
+      UnpinDirectoryPage(slots[order[i]], false);
+      slot_latches_[slots[order[i]]].RUnlock();
+    }
+  }
+  return num_found;
+}
+
 /*****************************************************************************
  * INSERTION
  *****************************************************************************/
 template <typename KeyType, typename ValueType, typename KeyComparator>
 bool HASH_TABLE_TYPE::Insert(Transaction *transaction, const KeyType &key, const ValueType &value) {
-  // 1. k经过哈希函数得到哈希值h，h二进制配合全局深度找到桶节点数组中的桶节点页编号，进而找到桶节点
-  // 2. 桶节点kv对数组二分找到第一个大于k的kv对，后续全部往后挪，插入kv对
-  // 3. 如果桶节点kv对数组大小等于容量，桶节点拆分
-
-  table_latch_.RLock();
-  HashTableDirectoryPage *dir_page = FetchDirectoryPage();
-  page_id_t bucket_page_id = KeyToPageId(key, dir_page);
-  Page *page = FetchBucketPage(bucket_page_id);
-  page->WLatch();
+  // 1. k经过哈希函数得到哈希值h，h的高位找到根页的槽，槽里是目录页编号
+  // 2. h二进制配合全局深度找到桶节点数组中的桶节点页编号，进而找到桶节点
+  // 3. 桶节点kv对数组二分找到第一个大于k的kv对，后续全部往后挪，插入kv对
+  // 4. 如果桶节点kv对数组大小等于容量，桶节点拆分
+
+  uint32_t slot = KeyToSlot(key);
+  ReaderWriterLatch &slot_latch = slot_latches_[slot];
+  slot_latch.RLock();
+  Page *dir_page = FetchDirectoryPage(slot);
+  page_id_t bucket_page_id;
+  Page *page = LatchBucketPage(key, dir_page, true, &bucket_page_id);
 
   HASH_TABLE_BUCKET_TYPE *bucket = RetrieveBucket(page);
   if (!bucket->IsFull()) {
     bool res = bucket->Insert(key, value, comparator_);
     page->WUnlatch();
     assert(buffer_pool_manager_->UnpinPage(bucket_page_id, true));
-    assert(buffer_pool_manager_->UnpinPage(dir_page->GetPageId(), false));
-    table_latch_.RUnlock();
+    UnpinDirectoryPage(slot, false);
+    slot_latch.RUnlock();
     return res;
   }
 
   page->WUnlatch();
   assert(buffer_pool_manager_->UnpinPage(bucket_page_id, false));
-  assert(buffer_pool_manager_->UnpinPage(dir_page->GetPageId(), false));
-  table_latch_.RUnlock();
+  UnpinDirectoryPage(slot, false);
+  slot_latch.RUnlock();
   return SplitInsert(transaction, key, value);
 }
 
 template <typename KeyType, typename ValueType, typename KeyComparator>
 bool HASH_TABLE_TYPE::SplitInsert(Transaction *transaction, const KeyType &key, const ValueType &value) {
-  // 1. 对于当前桶节点，创建兄弟桶节点，局部深度和当前桶节点的局部深度都++
-  //   a. 如果局部深度大于全局深度
-  //   b. 全局深度++，相当于桶节点数组和局部深度数组容量翻倍
-  //   c. 将目录节点的桶节点数组前半部分的桶节点编号依次拷贝到后半部分
-  //   d. 将目录节点的局部深度数组前半部分的局部深度依次拷贝到后半部分
-  // 2.
-  // 将当前桶节点kv数组的部分交给兄弟桶节点，如果k通过哈希函数的h，h的二进制在当前局部深度的位是1，则转移到兄弟桶节点。
-  // 3.
-  // 将目录节点的桶节点数组中所有存放当前桶节点编号，其中一半改为兄弟桶节点的编号，将桶节点数组的下标二进制中，根据局部深度所在的位，如果是1，将编号改为兄弟桶节点的编号。
-
-  table_latch_.WLock();
-
-  HashTableDirectoryPage *dir_page = FetchDirectoryPage();
-  int64_t split_bucket_index = KeyToDirectoryIndex(key, dir_page);
-  uint32_t split_bucket_depth = dir_page->GetLocalDepth(split_bucket_index);
-
-  if (split_bucket_depth >= MAX_BUCKET_DEPTH) {
-    assert(buffer_pool_manager_->UnpinPage(dir_page->GetPageId(), false));
-    table_latch_.WUnlock();
-    //    LOG_DEBUG("Bucket is full and can't split.");
-    return false;
+  // 1. 写锁住要拆分的桶节点，期间别的线程可能已经拆过它了，不满就直接插入
+  // 2. 局部深度到了上限，目录放不下了，拆分目录后重新插入
+  // 3. 创建兄弟桶节点，把当前桶节点kv数组的部分交给兄弟桶节点：k的哈希值h，h的二进制在当前局部深度的位是1，则转移到兄弟桶节点。
+  //    兄弟桶节点在目录里还看不到，不用锁
+  // 4. 写锁住目录，只改目录：
+  //   a. 如果局部深度等于全局深度，全局深度++，桶节点数组和局部深度数组前半部分依次拷贝到后半部分
+  //   b. 桶节点数组中存放当前桶节点编号的下标，局部深度都++，下标二进制在原局部深度的位是1的，改为兄弟桶节点的编号
+  // 5. 放掉目录和桶节点，重新插入
+
+  uint32_t slot = KeyToSlot(key);
+  ReaderWriterLatch &slot_latch = slot_latches_[slot];
+  slot_latch.RLock();
+  Page *dir_page = FetchDirectoryPage(slot);
+  HashTableDirectoryPage *dir = RetrieveDirectory(dir_page);
+  page_id_t split_bucket_page_id;
+  Page *split_page = LatchBucketPage(key, dir_page, true, &split_bucket_page_id);
+  HASH_TABLE_BUCKET_TYPE *split_bucket = RetrieveBucket(split_page);
+  if (!split_bucket->IsFull()) {
+    bool res = split_bucket->Insert(key, value, comparator_);
+    split_page->WUnlatch();
+    assert(buffer_pool_manager_->UnpinPage(split_bucket_page_id, true));
+    UnpinDirectoryPage(slot, false);
+    slot_latch.RUnlock();
+    return res;
   }
 
-  if (split_bucket_depth == dir_page->GetGlobalDepth()) {
-    dir_page->IncrGlobalDepth();
+  dir_page->RLatch();
+  uint32_t split_bucket_depth = dir->GetLocalDepth(KeyToDirectoryIndex(key, dir));
+  dir_page->RUnlatch();
+  if (split_bucket_depth >= MAX_BUCKET_DEPTH) {
+    split_page->WUnlatch();
+    assert(buffer_pool_manager_->UnpinPage(split_bucket_page_id, false));
+    UnpinDirectoryPage(slot, false);
+    slot_latch.RUnlock();
+    //    LOG_DEBUG("Bucket is full, split its directory.");
+    return SplitDirectory(key) && Insert(transaction, key, value);
   }
 
-  page_id_t split_bucket_page_id = KeyToPageId(key, dir_page);
-  Page *split_page = FetchBucketPage(split_bucket_page_id);
-  split_page->WLatch();
-  HASH_TABLE_BUCKET_TYPE *split_bucket = RetrieveBucket(split_page);
-  MappingType *origin_array = split_bucket->GetArrayCopy();
-  uint32_t origin_array_size = split_bucket->NumReadable();
-  split_bucket->Clear();
-
   page_id_t image_bucket_page;
   HASH_TABLE_BUCKET_TYPE *image_bucket = RetrieveBucket(AssertPage(buffer_pool_manager_->NewPage(&image_bucket_page)));
+  MoveEntries(split_bucket, image_bucket, 1U << split_bucket_depth);
 
-  dir_page->IncrLocalDepth(split_bucket_index);
-  uint32_t split_image_bucket_index = dir_page->GetSplitImageIndex(split_bucket_index);
-  dir_page->SetLocalDepth(split_image_bucket_index, dir_page->GetLocalDepth(split_bucket_index));
-
-  dir_page->SetBucketPageId(split_image_bucket_index, image_bucket_page);
-
-  uint32_t diff = 1 << dir_page->GetLocalDepth(split_bucket_index);
-  for (uint32_t i = split_bucket_index; i >= 0; i -= diff) {
-    dir_page->SetBucketPageId(i, split_bucket_page_id);
-    dir_page->SetLocalDepth(i, dir_page->GetLocalDepth(split_bucket_index));
-    if (i < diff) {
-      break;
-    }
-  }
-  for (uint32_t i = split_bucket_index; i < dir_page->Size(); i += diff) {
-    dir_page->SetBucketPageId(i, split_bucket_page_id);
-    dir_page->SetLocalDepth(i, dir_page->GetLocalDepth(split_bucket_index));
+  dir_page->WLatch();
+  if (split_bucket_depth == dir->GetGlobalDepth()) {
+    dir->IncrGlobalDepth();
   }
-  for (uint32_t i = split_image_bucket_index; i >= 0; i -= diff) {
-    dir_page->SetBucketPageId(i, image_bucket_page);
-    dir_page->SetLocalDepth(i, dir_page->GetLocalDepth(split_bucket_index));
-    if (i < diff) {
-      break;
+  uint32_t image_bit = 1U << split_bucket_depth;
+  for (uint32_t i = 0; i < dir->Size(); i++) {
+    if (dir->GetBucketPageId(i) == split_bucket_page_id) {
+      dir->SetLocalDepth(i, split_bucket_depth + 1);
+      if ((i & image_bit) != 0) {
+        dir->SetBucketPageId(i, image_bucket_page);
+      }
     }
   }
-  for (uint32_t i = split_image_bucket_index; i < dir_page->Size(); i += diff) {
-    dir_page->SetBucketPageId(i, image_bucket_page);
-    dir_page->SetLocalDepth(i, dir_page->GetLocalDepth(split_bucket_index));
-  }
+  dir_page->WUnlatch();
 
-  uint32_t mask = dir_page->GetLocalDepthMask(split_bucket_index);
+  split_page->WUnlatch();
+  assert(buffer_pool_manager_->UnpinPage(split_bucket_page_id, true));
+  assert(buffer_pool_manager_->UnpinPage(image_bucket_page, true));
+  UnpinDirectoryPage(slot, true);
+  slot_latch.RUnlock();
+
+  return Insert(transaction, key, value);
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+void HASH_TABLE_TYPE::MoveEntries(HASH_TABLE_BUCKET_TYPE *bucket, HASH_TABLE_BUCKET_TYPE *image_bucket,
+                                  uint32_t image_hash_bit) {
+  MappingType *origin_array = bucket->GetArrayCopy();
+  uint32_t origin_array_size = bucket->NumReadable();
+  bucket->Clear();
   for (uint32_t i = 0; i < origin_array_size; i++) {
     MappingType tmp = origin_array[i];
-    uint32_t target_bucket_index = Hash(tmp.first) & mask;
-    page_id_t target_bucket_index_page = dir_page->GetBucketPageId(target_bucket_index);
-    assert(target_bucket_index_page == split_bucket_page_id || target_bucket_index_page == image_bucket_page);
-    if (target_bucket_index_page == split_bucket_page_id) {
-      assert(split_bucket->Insert(tmp.first, tmp.second, comparator_));
+    if ((Hash(tmp.first) & image_hash_bit) == 0) {
+      assert(bucket->Insert(tmp.first, tmp.second, comparator_));
     } else {
       assert(image_bucket->Insert(tmp.first, tmp.second, comparator_));
     }
   }
   delete[] origin_array;
-  split_page->WUnlatch();
-  assert(buffer_pool_manager_->UnpinPage(split_bucket_page_id, true));
-  assert(buffer_pool_manager_->UnpinPage(image_bucket_page, true));
+}
 
-  assert(buffer_pool_manager_->UnpinPage(dir_page->GetPageId(), true));
-  table_latch_.WUnlock();
+template <typename KeyType, typename ValueType, typename KeyComparator>
+bool HASH_TABLE_TYPE::IsDirectorySplittable(HASH_TABLE_BUCKET_TYPE *bucket, uint32_t directory_depth) {
+  // 目录还能用的位是哈希值从高往低第d+1位到第MAX_DIRECTORY_DEPTH位
+  auto mask = static_cast<uint32_t>((uint64_t{1} << (32 - directory_depth)) -
+                                    (uint64_t{1} << (32 - MAX_DIRECTORY_DEPTH)));
+  bool found = false;
+  uint32_t first_bits = 0;
+  for (uint32_t i = 0; i < BUCKET_ARRAY_SIZE; i++) {
+    if (!bucket->IsReadable(i)) {
+      continue;
+    }
+    uint32_t bits = Hash(bucket->KeyAt(i)) & mask;
+    if (found && bits != first_bits) {
+      return true;
+    }
+    found = true;
+    first_bits = bits;
+  }
+  return false;
+}
 
-  return Insert(transaction, key, value);
+template <typename KeyType, typename ValueType, typename KeyComparator>
+bool HASH_TABLE_TYPE::SplitDirectory(const KeyType &key) {
+  // 1. 根页找到key所在的目录和它的深度d，到了上限就插不进去了
+  // 2. 按顺序写锁住目录占的所有槽，等目录里的操作都结束，也挡住新的；锁上后目录变了就不拆，让调用者重试
+  // 3. key所在的桶还是满的才拆，桶里的kv对在目录剩下的位上都一样（比如同一个key的很多值）就插不进去了，
+  //    拆多少次都腾不出空间：创建兄弟目录，结构和当前目录一样，每个桶创建一个兄弟桶，
+  //    桶里哈希值从高往低第d+1位是1的kv对转移到兄弟桶。桶页一个个处理，同时pin住的桶页不超过两个
+  // 4. 根页里目录占的后一半槽指向兄弟目录，所有槽的深度++，兄弟目录和别的目录一样一直pin着
+
+  HashTableRootPage *root_page = FetchRootPage();
+  uint32_t slot = KeyToSlot(key);
+  page_id_t directory_page_id = root_page->GetDirectoryPageId(slot);
+  uint32_t directory_depth = root_page->GetDirectoryDepth(slot);
+  uint32_t first_slot = root_page->GetFirstSlot(slot);
+  uint32_t num_slots = root_page->GetNumSlots(slot);
+  assert(buffer_pool_manager_->UnpinPage(root_page_id_, false));
+  if (directory_depth >= MAX_DIRECTORY_DEPTH) {
+    return false;
+  }
+
+  for (uint32_t i = first_slot; i < first_slot + num_slots; i++) {
+    slot_latches_[i].WLock();
+  }
+  root_page = FetchRootPage();
+  bool is_split = root_page->GetDirectoryPageId(slot) == directory_page_id &&
+                  root_page->GetDirectoryDepth(slot) == directory_depth;
+  bool is_splittable = true;
+  if (is_split) {
+    Page *dir_page = FetchDirectoryPage(slot);
+    HashTableDirectoryPage *dir = RetrieveDirectory(dir_page);
+    Page *bucket_page = FetchBucketPage(KeyToPageId(key, dir));
+    HASH_TABLE_BUCKET_TYPE *bucket = RetrieveBucket(bucket_page);
+    is_split = bucket->IsFull();
+    if (is_split && !IsDirectorySplittable(bucket, directory_depth)) {
+      is_split = is_splittable = false;
+    }
+    assert(buffer_pool_manager_->UnpinPage(bucket_page->GetPageId(), false));
+
+    if (is_split) {
+      page_id_t image_directory_page_id;
+      Page *image_dir_page = AssertPage(buffer_pool_manager_->NewPage(&image_directory_page_id));
+      HashTableDirectoryPage *image_dir = RetrieveDirectory(image_dir_page);
+      image_dir->SetPageId(image_directory_page_id);
+      while (image_dir->GetGlobalDepth() < dir->GetGlobalDepth()) {
+        image_dir->IncrGlobalDepth();
+      }
+      uint32_t image_hash_bit = 1U << (31 - directory_depth);
+      std::unordered_map<page_id_t, page_id_t> image_bucket_page_ids;
+      for (uint32_t i = 0; i < dir->Size(); i++) {
+        page_id_t bucket_page_id = dir->GetBucketPageId(i);
+        auto image = image_bucket_page_ids.find(bucket_page_id);
+        if (image == image_bucket_page_ids.end()) {
+          page_id_t image_bucket_page_id;
+          Page *image_bucket_page = AssertPage(buffer_pool_manager_->NewPage(&image_bucket_page_id));
+          bucket_page = FetchBucketPage(bucket_page_id);
+          MoveEntries(RetrieveBucket(bucket_page), RetrieveBucket(image_bucket_page), image_hash_bit);
+          assert(buffer_pool_manager_->UnpinPage(bucket_page_id, true));
+          assert(buffer_pool_manager_->UnpinPage(image_bucket_page_id, true));
+          image = image_bucket_page_ids.emplace(bucket_page_id, image_bucket_page_id).first;
+        }
+        image_dir->SetBucketPageId(i, image->second);
+        image_dir->SetLocalDepth(i, dir->GetLocalDepth(i));
+      }
+      UnpinDirectoryPage(slot, false);
+      // 一直pin着的目录页数量有上限，超过了兄弟目录就和桶页一样每次用的时候再取
+      if (num_pinned_directories_.fetch_add(1) < max_pinned_directories_) {
+        assert(buffer_pool_manager_->MarkPageDirty(image_directory_page_id));
+      } else {
+        num_pinned_directories_--;
+        assert(buffer_pool_manager_->UnpinPage(image_directory_page_id, true));
+        image_dir_page = nullptr;
+      }
+
+      for (uint32_t i = first_slot; i < first_slot + num_slots; i++) {
+        if (i >= first_slot + num_slots / 2) {
+          root_page->SetDirectoryPageId(i, image_directory_page_id);
+          directories_[i] = {image_directory_page_id, image_dir_page};
+        }
+        root_page->SetDirectoryDepth(i, directory_depth + 1);
+      }
+    } else {
+      UnpinDirectoryPage(slot, false);
+    }
+  }
+  assert(buffer_pool_manager_->UnpinPage(root_page_id_, is_split));
+  for (uint32_t i = first_slot; i < first_slot + num_slots; i++) {
+    slot_latches_[i].WUnlock();
+  }
+  return is_splittable;
 }
 
 /*****************************************************************************
@@ -260,31 +585,27 @@ bool HASH_TABLE_TYPE::SplitInsert(Transaction *transaction, const KeyType &key,
  *****************************************************************************/
 template <typename KeyType, typename ValueType, typename KeyComparator>
 bool HASH_TABLE_TYPE::Remove(Transaction *transaction, const KeyType &key, const ValueType &value) {
-  // 1. k经过哈希函数得到哈希值h，h二进制配合全局深度找到桶节点数组中的桶节点页编号，进而找到桶节点
-  // 2. 桶节点kv对数组二分找到第一个大于k的kv对，后续全部往前挪，覆盖kv对
-  // 3. 如果桶节点kv对数组大小等于0，桶节点合并
-
-  table_latch_.RLock();
-
-  HashTableDirectoryPage *dir_page = FetchDirectoryPage();
-  page_id_t bucket_page_id = KeyToPageId(key, dir_page);
-  uint32_t bucket_index = KeyToDirectoryIndex(key, dir_page);
-  Page *page = FetchBucketPage(bucket_page_id);
-  page->WLatch();
+  // 1. k经过哈希函数得到哈希值h，h的高位找到根页的槽，槽里是目录页编号
+  // 2. h二进制配合全局深度找到桶节点数组中的桶节点页编号，进而找到桶节点
+  // 3. 桶节点kv对数组二分找到第一个大于k的kv对，后续全部往前挪，覆盖kv对
+  // 4. 如果桶节点kv对数组大小等于0，桶节点合并
+
+  uint32_t slot = KeyToSlot(key);
+  ReaderWriterLatch &slot_latch = slot_latches_[slot];
+  slot_latch.RLock();
+  Page *dir_page = FetchDirectoryPage(slot);
+  page_id_t bucket_page_id;
+  Page *page = LatchBucketPage(key, dir_page, true, &bucket_page_id);
   HASH_TABLE_BUCKET_TYPE *bucket = RetrieveBucket(page);
   bool res = bucket->Remove(key, value, comparator_);
-  if (bucket->IsEmpty()) {
-    page->WUnlatch();
-    assert(buffer_pool_manager_->UnpinPage(bucket_page_id, true));
-    assert(buffer_pool_manager_->UnpinPage(dir_page->GetPageId(), false));
-    table_latch_.RUnlock();
-    Merge(transaction, bucket_index);
-    return res;
-  }
+  bool is_empty = bucket->IsEmpty();
   page->WUnlatch();
-  assert(buffer_pool_manager_->UnpinPage(bucket_page_id, true));
-  assert(buffer_pool_manager_->UnpinPage(dir_page->GetPageId(), false));
-  table_latch_.RUnlock();
+  assert(buffer_pool_manager_->UnpinPage(bucket_page_id, res));
+  UnpinDirectoryPage(slot, false);
+  slot_latch.RUnlock();
+  if (is_empty) {
+    Merge(transaction, key);
+  }
   return res;
 }
 
@@ -292,71 +613,75 @@ bool HASH_TABLE_TYPE::Remove(Transaction *transaction, const KeyType &key, const
  * MERGE
  *****************************************************************************/
 template <typename KeyType, typename ValueType, typename KeyComparator>
-void HASH_TABLE_TYPE::Merge(Transaction *transaction, uint32_t target_bucket_index) {
-  // 1. 对于当前桶节点，找到兄弟桶节点
-  // 2.
-  // 桶节点数组中找到下标存放当前桶节点的编号，根据当前桶节点局部深度，将下标二进制在局部深度的位翻转，得到新下标，存放兄弟桶节点编号
-  // 3. 将兄弟桶节点kv对转移到当前桶节点
-  // 4. 将桶节点数组所有兄弟桶节点页编号改为当前桶节点页编号。
-  // 5. 局部深度--，如果所有局部深度小于全局深度，全局深度--，相当于桶节点数组和局部深度数组容量减半。
-
-  table_latch_.WLock();
-
-  HashTableDirectoryPage *dir_page = FetchDirectoryPage();
-  if (target_bucket_index >= dir_page->Size()) {
-    table_latch_.WUnlock();
-    return;
-  }
-
-  page_id_t target_bucket_page_id = dir_page->GetBucketPageId(target_bucket_index);
-  uint32_t image_bucket_index = dir_page->GetSplitImageIndex(target_bucket_index);
-
-  uint32_t local_depth = dir_page->GetLocalDepth(target_bucket_index);
-  if (local_depth == 0) {
-    assert(buffer_pool_manager_->UnpinPage(dir_page->GetPageId(), false));
-    table_latch_.WUnlock();
-    return;
+void HASH_TABLE_TYPE::Merge(Transaction *transaction, const KeyType &key) {
+  // 1. 对于key所在的当前桶节点，根据局部深度找到兄弟桶节点
+  // 2. 按页编号从小到大写锁住两个桶节点，避免和另一边的合并死锁；锁上后重新检查合并的条件，不满足就放弃
+  // 3. 写锁住目录，桶节点数组所有当前桶节点和兄弟桶节点的页编号改为兄弟桶节点页编号，局部深度--
+  // 4. 如果所有局部深度小于全局深度，全局深度--，相当于桶节点数组和局部深度数组容量减半。
+  // 5. 放掉桶节点，删除当前桶节点
+  // 目录拆开后不再合并回去
+
+  uint32_t slot = KeyToSlot(key);
+  ReaderWriterLatch &slot_latch = slot_latches_[slot];
+  slot_latch.RLock();
+  Page *dir_page = FetchDirectoryPage(slot);
+  HashTableDirectoryPage *dir = RetrieveDirectory(dir_page);
+  dir_page->RLatch();
+  uint32_t target_bucket_index = KeyToDirectoryIndex(key, dir);
+  page_id_t target_bucket_page_id = dir->GetBucketPageId(target_bucket_index);
+  uint32_t local_depth = dir->GetLocalDepth(target_bucket_index);
+  page_id_t image_bucket_page_id = INVALID_PAGE_ID;
+  if (local_depth > 0) {
+    image_bucket_page_id = dir->GetBucketPageId(dir->GetSplitImageIndex(target_bucket_index));
   }
-
-  if (local_depth != dir_page->GetLocalDepth(image_bucket_index)) {
-    assert(buffer_pool_manager_->UnpinPage(dir_page->GetPageId(), false));
-    table_latch_.WUnlock();
+  dir_page->RUnlatch();
+  if (local_depth == 0 || image_bucket_page_id == target_bucket_page_id) {
+    UnpinDirectoryPage(slot, false);
+    slot_latch.RUnlock();
     return;
   }
 
   Page *target_page = FetchBucketPage(target_bucket_page_id);
-  target_page->RLatch();
-  HASH_TABLE_BUCKET_TYPE *target_bucket = RetrieveBucket(target_page);
-  if (!target_bucket->IsEmpty()) {
-    target_page->RUnlatch();
-    assert(buffer_pool_manager_->UnpinPage(target_bucket_page_id, false));
-    assert(buffer_pool_manager_->UnpinPage(dir_page->GetPageId(), false));
-    table_latch_.WUnlock();
-    return;
+  Page *image_page = FetchBucketPage(image_bucket_page_id);
+  if (target_bucket_page_id < image_bucket_page_id) {
+    target_page->WLatch();
+    image_page->WLatch();
+  } else {
+    image_page->WLatch();
+    target_page->WLatch();
   }
 
-  target_page->RUnlatch();
-  assert(buffer_pool_manager_->UnpinPage(target_bucket_page_id, false));
-  assert(buffer_pool_manager_->DeletePage(target_bucket_page_id));
-
-  page_id_t image_bucket_page_id = dir_page->GetBucketPageId(image_bucket_index);
-  dir_page->SetBucketPageId(target_bucket_index, image_bucket_page_id);
-  dir_page->DecrLocalDepth(target_bucket_index);
-  dir_page->DecrLocalDepth(image_bucket_index);
-  assert(dir_page->GetLocalDepth(target_bucket_index) == dir_page->GetLocalDepth(image_bucket_index));
-
-  for (uint32_t i = 0; i < dir_page->Size(); i++) {
-    if (dir_page->GetBucketPageId(i) == target_bucket_page_id || dir_page->GetBucketPageId(i) == image_bucket_page_id) {
-      dir_page->SetBucketPageId(i, image_bucket_page_id);
-      dir_page->SetLocalDepth(i, dir_page->GetLocalDepth(target_bucket_index));
+  dir_page->WLatch();
+  target_bucket_index = KeyToDirectoryIndex(key, dir);
+  bool is_merged = dir->GetBucketPageId(target_bucket_index) == target_bucket_page_id &&
+                   dir->GetLocalDepth(target_bucket_index) == local_depth && RetrieveBucket(target_page)->IsEmpty();
+  if (is_merged) {
+    uint32_t image_bucket_index = dir->GetSplitImageIndex(target_bucket_index);
+    is_merged = dir->GetBucketPageId(image_bucket_index) == image_bucket_page_id &&
+                dir->GetLocalDepth(image_bucket_index) == local_depth;
+  }
+  if (is_merged) {
+    for (uint32_t i = 0; i < dir->Size(); i++) {
+      if (dir->GetBucketPageId(i) == target_bucket_page_id || dir->GetBucketPageId(i) == image_bucket_page_id) {
+        dir->SetBucketPageId(i, image_bucket_page_id);
+        dir->SetLocalDepth(i, local_depth - 1);
+      }
+    }
+    while (dir->CanShrink()) {
+      dir->DecrGlobalDepth();
     }
   }
+  dir_page->WUnlatch();
 
-  while (dir_page->CanShrink()) {
-    dir_page->DecrGlobalDepth();
+  target_page->WUnlatch();
+  image_page->WUnlatch();
+  assert(buffer_pool_manager_->UnpinPage(target_bucket_page_id, false));
+  assert(buffer_pool_manager_->UnpinPage(image_bucket_page_id, false));
+  UnpinDirectoryPage(slot, is_merged);
+  slot_latch.RUnlock();
+  if (is_merged) {
+    DeleteBucketPage(target_bucket_page_id);
   }
-  assert(buffer_pool_manager_->UnpinPage(dir_page->GetPageId(), true));
-  table_latch_.WUnlock();
 }
 
 /*****************************************************************************
@@ -364,11 +689,20 @@ void HASH_TABLE_TYPE::Merge(Transaction *transaction, uint32_t target_bucket_ind
  *****************************************************************************/
 template <typename KeyType, typename ValueType, typename KeyComparator>
 uint32_t HASH_TABLE_TYPE::GetGlobalDepth() {
-  table_latch_.RLock();
-  HashTableDirectoryPage *dir_page = FetchDirectoryPage();
-  uint32_t global_depth = dir_page->GetGlobalDepth();
-  assert(buffer_pool_manager_->UnpinPage(directory_page_id_, false, nullptr));
-  table_latch_.RUnlock();
+  // 用到的哈希位数：根页上的深度加上目录的全局深度，取最大的
+  uint32_t global_depth = 0;
+  HashTableRootPage *root_page = FetchRootPage();
+  for (uint32_t slot = 0; slot < ROOT_ARRAY_SIZE; slot += root_page->GetNumSlots(slot)) {
+    slot_latches_[slot].RLock();
+    Page *dir_page = FetchDirectoryPage(slot);
+    dir_page->RLatch();
+    global_depth =
+        std::max(global_depth, root_page->GetDirectoryDepth(slot) + RetrieveDirectory(dir_page)->GetGlobalDepth());
+    dir_page->RUnlatch();
+    UnpinDirectoryPage(slot, false);
+    slot_latches_[slot].RUnlock();
+  }
+  assert(buffer_pool_manager_->UnpinPage(root_page_id_, false, nullptr));
   return global_depth;
 }
 
@@ -377,11 +711,18 @@ uint32_t HASH_TABLE_TYPE::GetGlobalDepth() {
  *****************************************************************************/
 template <typename KeyType, typename ValueType, typename KeyComparator>
 void HASH_TABLE_TYPE::VerifyIntegrity() {
-  table_latch_.RLock();
-  HashTableDirectoryPage *dir_page = FetchDirectoryPage();
-  dir_page->VerifyIntegrity();
-  assert(buffer_pool_manager_->UnpinPage(directory_page_id_, false, nullptr));
-  table_latch_.RUnlock();
+  HashTableRootPage *root_page = FetchRootPage();
+  root_page->VerifyIntegrity();
+  for (uint32_t slot = 0; slot < ROOT_ARRAY_SIZE; slot += root_page->GetNumSlots(slot)) {
+    slot_latches_[slot].RLock();
+    Page *dir_page = FetchDirectoryPage(slot);
+    dir_page->RLatch();
+    RetrieveDirectory(dir_page)->VerifyIntegrity();
+    dir_page->RUnlatch();
+    UnpinDirectoryPage(slot, false);
+    slot_latches_[slot].RUnlock();
+  }
+  assert(buffer_pool_manager_->UnpinPage(root_page_id_, false, nullptr));
 }
 template <typename KeyType, typename ValueType, typename KeyComparator>
 Page *ExtendibleHashTable<KeyType, ValueType, KeyComparator>::AssertPage(Page *page) {
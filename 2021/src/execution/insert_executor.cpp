@@ -11,6 +11,7 @@
 //===----------------------------------------------------------------------===//
 
 #include <memory>
+#include <vector>
 
 #include "execution/executors/insert_executor.h"
 
@@ -44,51 +45,63 @@ bool InsertExecutor::Next([[maybe_unused]] Tuple *tuple, RID *rid) {
   // 3. 将输入行插入输入表指定行编号，行编号来自参数，输入表来自catalog利用输入表编号获取，输入表编号来自计划节点
   // 4. 将输入行插入索引，索引来自catalog
 
+  // 每次从输入取一批行，整批插入表，一页只钉一次、锁一次，再逐行加锁和插索引
+  Transaction *txn = GetExecutorContext()->GetTransaction();
+  LockManager *lock_mgr = GetExecutorContext()->GetLockManager();
   std::vector<Tuple> tuples;
-
-  if (!plan_->IsRawInsert()) {
-    if (!child_executor_->Next(tuple, rid)) {
+  std::vector<RID> rids;
+  while (true) {
+    tuples.clear();
+    tuples.emplace_back();
+    while (tuples.size() <= BATCH_SIZE && NextInputTuple(&tuples.back(), rid)) {
+      tuples.emplace_back();
+    }
+    tuples.pop_back();
+    if (tuples.empty()) {
       return false;
     }
-  } else {
-    if (iter_ == plan_->RawValues().end()) {
+
+    if (!table_heap_->InsertTuples(tuples, &rids, txn, &strategy_)) {
+      LOG_DEBUG("INSERT FAIL");
       return false;
     }
-    *tuple = Tuple(*iter_, &table_info_->schema_);
-    iter_++;
-  }
 
-  if (!table_heap_->InsertTuple(*tuple, rid, exec_ctx_->GetTransaction())) {
-    LOG_DEBUG("INSERT FAIL");
-    return false;
-  }
+    for (size_t i = 0; i < tuples.size(); i++) {
+      if (txn->IsSharedLocked(rids[i])) {
+        if (!lock_mgr->LockUpgrade(txn, rids[i])) {
+          throw TransactionAbortException(txn->GetTransactionId(), AbortReason::DEADLOCK);
+        }
+      } else {
+        if (!lock_mgr->LockExclusive(txn, rids[i])) {
+          throw TransactionAbortException(txn->GetTransactionId(), AbortReason::DEADLOCK);
+        }
+      }
 
-  Transaction *txn = GetExecutorContext()->GetTransaction();
-  LockManager *lock_mgr = GetExecutorContext()->GetLockManager();
+      for (const auto &index : catalog_->GetTableIndexes(table_info_->name_)) {
+        index->index_->InsertEntry(
+            tuples[i].KeyFromTuple(table_info_->schema_, *index->index_->GetKeySchema(), index->index_->GetKeyAttrs()),
+            rids[i], txn);
+      }
 
-  if (txn->IsSharedLocked(*rid)) {
-    if (!lock_mgr->LockUpgrade(txn, *rid)) {
-      throw TransactionAbortException(txn->GetTransactionId(), AbortReason::DEADLOCK);
-    }
-  } else {
-    if (!lock_mgr->LockExclusive(txn, *rid)) {
-      throw TransactionAbortException(txn->GetTransactionId(), AbortReason::DEADLOCK);
+      if (txn->GetIsolationLevel() != IsolationLevel::REPEATABLE_READ) {
+        if (!lock_mgr->Unlock(txn, rids[i])) {
+          throw TransactionAbortException(txn->GetTransactionId(), AbortReason::DEADLOCK);
+        }
+      }
     }
   }
+}
 
-  for (const auto &index : catalog_->GetTableIndexes(table_info_->name_)) {
-    index->index_->InsertEntry(
-        tuple->KeyFromTuple(table_info_->schema_, *index->index_->GetKeySchema(), index->index_->GetKeyAttrs()), *rid,
-        exec_ctx_->GetTransaction());
+bool InsertExecutor::NextInputTuple(Tuple *tuple, RID *rid) {
+  if (!plan_->IsRawInsert()) {
+    return child_executor_->Next(tuple, rid);
   }
-
-  if (txn->GetIsolationLevel() != IsolationLevel::REPEATABLE_READ) {
-    if (!lock_mgr->Unlock(txn, *rid)) {
-      throw TransactionAbortException(txn->GetTransactionId(), AbortReason::DEADLOCK);
-    }
+  if (iter_ == plan_->RawValues().end()) {
+    return false;
   }
-
-  return Next(tuple, rid);
+  *tuple = Tuple(*iter_, &table_info_->schema_);
+  iter_++;
+  return true;
 }
 
 }  // namespace bustub
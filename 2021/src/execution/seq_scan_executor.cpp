@@ -24,47 +24,51 @@ SeqScanExecutor::SeqScanExecutor(ExecutorContext *exec_ctx, const SeqScanPlanNod
 void SeqScanExecutor::Init() { iter_ = table_heap_->Begin(exec_ctx_->GetTransaction()); }
 
 bool SeqScanExecutor::Next(Tuple *tuple, RID *rid) {
-  // 1. 循环，直到输入表迭代器到输入表末尾，从计划节点获得输入表编号，从catalog获得输入表编号对应的输入表信息
-  // 2. 准备输出行，遍历输出行每个列，从计划节点获得输出行的列类型数组，获得输出行的列数量
-  // 3.
-  // 使用当前输入行、输入行的列类型数组、输出行的当前列的列类型，来获取输出行当前列的值。输入行的列类型数组从输入表信息获取
-  // 4. 使用计划节点的判断条件判断当前输出行是否满足判断条件，满足返回，不满足重新开始
-
-  if (iter_ == table_heap_->End()) {
-    return false;
-  }
-
-  *tuple = *iter_;
-  *rid = tuple->GetRid();
+  // 1. 循环，直到输入表迭代器到输入表末尾，先对当前行加读锁，加锁时不能持有页的读锁
+  // 2. 不拷贝输入行，直接在页里看它，用输入表的列类型数组判断是否满足判断条件
+  // 3. 满足条件的行才准备输出行，使用输入行、输入行的列类型数组、输出行的当前列的列类型，来获取输出行当前列的值
+  // 4. 放掉页，读已提交在这里释放读锁，移动迭代器，满足条件就返回
 
   LockManager *lock_mgr = GetExecutorContext()->GetLockManager();
   Transaction *txn = GetExecutorContext()->GetTransaction();
-  if (txn->GetIsolationLevel() != IsolationLevel::READ_UNCOMMITTED) {
-    if (!lock_mgr->LockShared(txn, *rid)) {
-      throw TransactionAbortException(txn->GetTransactionId(), AbortReason::DEADLOCK);
+  const AbstractExpression *predict = plan_->GetPredicate();
+  const Schema *output_schema = plan_->OutputSchema();
+  TupleView view;
+  while (iter_ != table_heap_->End()) {
+    RID cur_rid = iter_.GetRid();
+    if (txn->GetIsolationLevel() != IsolationLevel::READ_UNCOMMITTED) {
+      if (!lock_mgr->LockShared(txn, cur_rid)) {
+        throw TransactionAbortException(txn->GetTransactionId(), AbortReason::DEADLOCK);
+      }
     }
-  }
-
-  std::vector<Value> values;
-  for (size_t i = 0; i < plan_->OutputSchema()->GetColumnCount(); i++) {
-    values.push_back(plan_->OutputSchema()->GetColumn(i).GetExpr()->Evaluate(tuple, schema_));
-  }
 
-  *tuple = Tuple(values, plan_->OutputSchema());
-
-  if (txn->GetIsolationLevel() == IsolationLevel::READ_COMMITTED) {
-    if (!lock_mgr->Unlock(txn, *rid)) {
-      throw TransactionAbortException(txn->GetTransactionId(), AbortReason::DEADLOCK);
+    bool is_produced = false;
+    if (iter_.GetTupleView(&view)) {
+      const Tuple &row = view.GetTuple();
+      if (predict == nullptr || predict->Evaluate(&row, schema_).GetAs<bool>()) {
+        std::vector<Value> values;
+        values.reserve(output_schema->GetColumnCount());
+        for (size_t i = 0; i < output_schema->GetColumnCount(); i++) {
+          values.push_back(output_schema->GetColumn(i).GetExpr()->Evaluate(&row, schema_));
+        }
+        *tuple = Tuple(values, output_schema);
+        *rid = cur_rid;
+        is_produced = true;
+      }
+      view.Release();
     }
-  }
 
-  ++iter_;
+    if (txn->GetIsolationLevel() == IsolationLevel::READ_COMMITTED) {
+      if (!lock_mgr->Unlock(txn, cur_rid)) {
+        throw TransactionAbortException(txn->GetTransactionId(), AbortReason::DEADLOCK);
+      }
+    }
 
-  const AbstractExpression *predict = plan_->GetPredicate();
-  if (predict != nullptr && !predict->Evaluate(tuple, plan_->OutputSchema()).GetAs<bool>()) {
-    return Next(tuple, rid);
+    ++iter_;
+    if (is_produced) {
+      return true;
+    }
   }
-
-  return true;
+  return false;
 }
 }  // namespace bustub
@@ -0,0 +1,107 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// buffer_access_strategy.h
+//
+// Identification: src/include/buffer/buffer_access_strategy.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+#include "common/config.h"
+#include "common/macros.h"
+
+namespace bustub {
+
+/**
+ * The kind of bulk operation a BufferAccessStrategy serves.
+ */
+enum class BufferAccessType {
+  /** A sequential scan over a table, see BULK_READ_RING_SIZE. */
+  BULK_READ,
+  /** A large batch of inserts, see BULK_WRITE_RING_SIZE. */
+  BULK_WRITE,
+};
+
+/**
+ * BufferAccessStrategy is a small private ring of buffer pool frames owned by one bulk operation.
+ *
+ * When a page requested with a strategy is not resident, the buffer pool first tries to recycle the frame the
+ * operation used ring-size misses ago, and only takes a frame from the free list or the replacer when that frame has
+ * been pinned or evicted by someone else in the meantime. A scan or bulk insert therefore cycles through its own
+ * handful of frames instead of pushing the working set of concurrent transactions out of the pool. Pages that are
+ * already resident are served from wherever they are, without touching the ring.
+ *
+ * A strategy belongs to a single operation and must not be shared between threads.
+ */
+class BufferAccessStrategy {
+  friend class BufferPoolManagerInstance;
+
+ public:
+  /**
+   * Create a strategy with the default ring size of the access type.
+   * @param type the kind of bulk operation
+   */
+  explicit BufferAccessStrategy(BufferAccessType type)
+      : BufferAccessStrategy(type, type == BufferAccessType::BULK_READ ? BULK_READ_RING_SIZE : BULK_WRITE_RING_SIZE) {}
+
+  /**
+   * Create a strategy.
+   * @param type the kind of bulk operation
+   * @param ring_size the number of frames in the ring of every buffer pool instance
+   */
+  BufferAccessStrategy(BufferAccessType type, size_t ring_size) : type_(type), ring_size_(ring_size) {
+    BUSTUB_ASSERT(ring_size > 0, "A ring needs at least one frame");
+  }
+
+  DISALLOW_COPY(BufferAccessStrategy);
+
+  /** @return the kind of bulk operation */
+  BufferAccessType GetType() const { return type_; }
+
+  /** @return the number of frames in the ring of every buffer pool instance */
+  size_t GetRingSize() const { return ring_size_; }
+
+ private:
+  /** A frame of the ring, together with the page the operation put in it. */
+  struct RingSlot {
+    frame_id_t frame_id_{-1};
+    page_id_t page_id_{INVALID_PAGE_ID};
+  };
+
+  /** The ring of one buffer pool instance. */
+  struct Ring {
+    std::vector<RingSlot> slots_;
+    size_t current_{0};
+  };
+
+  /**
+   * Advance the ring of a buffer pool instance to its next slot.
+   * @param instance_index index of the buffer pool instance
+   * @param max_ring_size the most frames the instance is willing to give to the ring
+   * @return the slot to be recycled for the next miss
+   */
+  RingSlot &NextSlot(uint32_t instance_index, size_t max_ring_size) {
+    Ring &ring = rings_[instance_index];
+    if (ring.slots_.empty()) {
+      ring.slots_.resize(std::min(ring_size_, max_ring_size));
+    }
+    ring.current_ = (ring.current_ + 1) % ring.slots_.size();
+    return ring.slots_[ring.current_];
+  }
+
+  BufferAccessType type_;
+  size_t ring_size_;
+  /** One ring per buffer pool instance, since frames are local to an instance. */
+  std::unordered_map<uint32_t, Ring> rings_;
+};
+
+}  // namespace bustub
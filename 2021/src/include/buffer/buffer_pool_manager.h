@@ -16,6 +16,7 @@
 #include <mutex>  // NOLINT
 #include <unordered_map>
 
+#include "buffer/buffer_access_strategy.h"
 #include "buffer/lru_replacer.h"
 #include "recovery/log_manager.h"
 #include "storage/disk/disk_manager.h"
@@ -84,9 +85,49 @@ class BufferPoolManager {
     GradingCallback(callback, CallbackType::AFTER, INVALID_PAGE_ID);
   }
 
+  /**
+   * Start reading a page into the buffer pool in the background without pinning it, so that a later FetchPage does
+   * not have to wait for the disk. This is only a hint: it may do nothing, e.g. when every frame is in use.
+   * @param page_id id of the page to read ahead
+   * @param strategy if not nullptr, the read-ahead recycles a frame of this bulk operation's ring
+   * @return true if the page is resident and can be fetched without waiting for I/O, false otherwise
+   */
+  bool PrefetchPage(page_id_t page_id, BufferAccessStrategy *strategy = nullptr) {
+    return PrefetchPgImp(page_id, strategy);
+  }
+
+  /**
+   * Mark a page the caller keeps pinned as dirty without unpinning it, e.g. a page pinned for a long time.
+   * @param page_id id of the page, which must be pinned
+   * @return false if the page is not resident or not pinned
+   */
+  bool MarkPageDirty(page_id_t page_id) { return MarkPageDirtyImp(page_id); }
+
+  /**
+   * Fetch a page on behalf of a bulk operation. On a miss, the page is read into a frame of the strategy's ring
+   * rather than into a frame evicted from the rest of the pool.
+   * @param page_id id of page to be fetched
+   * @param strategy the ring of the bulk operation, nullptr behaves like FetchPage
+   * @return the requested page
+   */
+  Page *FetchPageWithStrategy(page_id_t page_id, BufferAccessStrategy *strategy) {
+    return FetchPgImp(page_id, strategy);
+  }
+
+  /**
+   * Create a new page on behalf of a bulk operation, in a frame of the strategy's ring.
+   * @param[out] page_id id of created page
+   * @param strategy the ring of the bulk operation, nullptr behaves like NewPage
+   * @return nullptr if no new pages could be created, otherwise pointer to new page
+   */
+  Page *NewPageWithStrategy(page_id_t *page_id, BufferAccessStrategy *strategy) { return NewPgImp(page_id, strategy); }
+
   /** @return size of the buffer pool */
   virtual size_t GetPoolSize() = 0;
 
+  /** @return size of every page in the buffer pool, which is the page size of its database file */
+  virtual size_t GetPageSize() { return PAGE_SIZE; }
+
  protected:
   /**
    * Grading function. Do not modify!
@@ -141,5 +182,38 @@ class BufferPoolManager {
    * Flushes all the pages in the buffer pool to disk.
    */
   virtual void FlushAllPgsImp() = 0;
+
+  /**
+   * Start reading a page into the buffer pool in the background. Buffer pools without read-ahead ignore the hint.
+   * @param page_id id of the page to read ahead
+   * @param strategy the ring of the bulk operation issuing the read-ahead, may be nullptr
+   * @return true if the page is resident and can be fetched without waiting for I/O, false otherwise
+   */
+  virtual bool PrefetchPgImp(page_id_t page_id, BufferAccessStrategy *strategy) { return false; }
+
+  /**
+   * Mark a pinned page as dirty. The default pins the page once more and unpins it dirty.
+   * @param page_id id of the page, which must be pinned
+   * @return false if the page is not resident or not pinned
+   */
+  virtual bool MarkPageDirtyImp(page_id_t page_id) {
+    return FetchPgImp(page_id) != nullptr && UnpinPgImp(page_id, true);
+  }
+
+  /**
+   * Fetch the requested page on behalf of a bulk operation. Buffer pools without rings ignore the strategy.
+   * @param page_id id of page to be fetched
+   * @param strategy the ring of the bulk operation, may be nullptr
+   * @return the requested page
+   */
+  virtual Page *FetchPgImp(page_id_t page_id, BufferAccessStrategy *strategy) { return FetchPgImp(page_id); }
+
+  /**
+   * Creates a new page on behalf of a bulk operation. Buffer pools without rings ignore the strategy.
+   * @param[out] page_id id of created page
+   * @param strategy the ring of the bulk operation, may be nullptr
+   * @return nullptr if no new pages could be created, otherwise pointer to new page
+   */
+  virtual Page *NewPgImp(page_id_t *page_id, BufferAccessStrategy *strategy) { return NewPgImp(page_id); }
 };
 }  // namespace bustub
@@ -12,11 +12,21 @@
 
 #pragma once
 
+#include <array>
+#include <climits>
+#include <condition_variable>  // NOLINT
+#include <future>              // NOLINT
 #include <list>
-#include <mutex>  // NOLINT
+#include <mutex>         // NOLINT
+#include <shared_mutex>  // NOLINT
+#include <thread>        // NOLINT
 #include <unordered_map>
 
 #include "buffer/buffer_pool_manager.h"
+#include "buffer/buffer_pool_stats.h"
+#include "buffer/clock_replacer.h"
+#include "buffer/frame_arena.h"
+#include "buffer/lru_k_replacer.h"
 #include "buffer/lru_replacer.h"
 #include "recovery/log_manager.h"
 #include "storage/disk/disk_manager.h"
@@ -34,8 +44,10 @@ class BufferPoolManagerInstance : public BufferPoolManager {
    * @param pool_size the size of the buffer pool
    * @param disk_manager the disk manager
    * @param log_manager the log manager (for testing only: nullptr = disable logging)
+   * @param replacer_policy the replacement policy used to pick victim frames
    */
-  BufferPoolManagerInstance(size_t pool_size, DiskManager *disk_manager, LogManager *log_manager = nullptr);
+  BufferPoolManagerInstance(size_t pool_size, DiskManager *disk_manager, LogManager *log_manager = nullptr,
+                            ReplacerPolicy replacer_policy = ReplacerPolicy::LRU);
   /**
    * Creates a new BufferPoolManagerInstance.
    * @param pool_size the size of the buffer pool
@@ -43,9 +55,12 @@ class BufferPoolManagerInstance : public BufferPoolManager {
    * @param instance_index index of this BPI in the parallel BPM
    * @param disk_manager the disk manager
    * @param log_manager the log manager (for testing only: nullptr = disable logging)
+   * @param replacer_policy the replacement policy used to pick victim frames
+   * @param numa_node the NUMA node the frames should be allocated on, -1 for no preference
    */
   BufferPoolManagerInstance(size_t pool_size, uint32_t num_instances, uint32_t instance_index,
-                            DiskManager *disk_manager, LogManager *log_manager = nullptr);
+                            DiskManager *disk_manager, LogManager *log_manager = nullptr,
+                            ReplacerPolicy replacer_policy = ReplacerPolicy::LRU, int numa_node = -1);
 
   /**
    * Destroys an existing BufferPoolManagerInstance.
@@ -55,14 +70,39 @@ class BufferPoolManagerInstance : public BufferPoolManager {
   /** @return size of the buffer pool */
   size_t GetPoolSize() override { return pool_size_; }
 
+  /** @return size of every page in the buffer pool */
+  size_t GetPageSize() override { return arena_->GetFrameSize(); }
+
   /** @return pointer to all the pages in the buffer pool */
   Page *GetPages() { return pages_; }
 
+  /** @return the number of frames on the free list, read without taking latch_ and possibly stale */
+  size_t GetNumFreeFrames() const { return num_free_frames_.load(std::memory_order_relaxed); }
+
+  /** @return the hit, eviction and flush counters and latency histograms of this instance so far */
+  BufferPoolStatsSnapshot GetStats() const { return stats_.Snapshot(); }
+
+  /**
+   * Start a background thread that writes dirty, unpinned pages back to disk ahead of eviction, so that NewPage and
+   * FetchPage mostly find clean victims. The thread wakes up every background_flush_interval, or as soon as more than
+   * high_watermark of the pool is dirty, and then writes pages back in page id order until at most low_watermark of
+   * the pool is dirty.
+   * @param low_watermark fraction of the pool that may stay dirty after a round of write-back
+   * @param high_watermark fraction of the pool that, once exceeded, wakes the thread up early
+   */
+  void RunFlushThread(double low_watermark = 0.1, double high_watermark = 0.3);
+
+  /** Stop and join the background flush thread, if it is running. */
+  void StopFlushThread();
+
+  /** @return the number of dirty pages in the buffer pool */
+  size_t GetNumDirtyPages() const { return num_dirty_; }
+
  protected:
   /**
    * Fetch the requested page from the buffer pool.
    * @param page_id id of page to be fetched
-   * @return the requested page
+   * @return the requested page, nullptr if no frame is available or the page failed checksum verification
    */
   Page *FetchPgImp(page_id_t page_id) override;
 
@@ -91,7 +131,8 @@ class BufferPoolManagerInstance : public BufferPoolManager {
   /**
    * Deletes a page from the buffer pool.
    * @param page_id id of page to be deleted
-   * @return false if the page exists but could not be deleted, true if the page didn't exist or deletion succeeded
+   * @return false if the page exists but could not be deleted or its id was never allocated by this instance, true if
+   * the page didn't exist or deletion succeeded
    */
   bool DeletePgImp(page_id_t page_id) override;
 
@@ -101,18 +142,135 @@ class BufferPoolManagerInstance : public BufferPoolManager {
   void FlushAllPgsImp() override;
 
   /**
-   * Allocate a page on disk.∂
+   * Start reading a page into a frame in the background, without pinning it. The frame only becomes visible in the
+   * page table once the read has completed and somebody fetches the page or needs the frame.
+   * @param page_id id of the page to read ahead
+   * @param strategy if not nullptr, the frame comes from the ring of this bulk operation
+   * @return true if the page is resident and can be fetched without waiting for I/O, false otherwise
+   */
+  bool PrefetchPgImp(page_id_t page_id, BufferAccessStrategy *strategy) override;
+
+  /**
+   * Set the dirty flag of a pinned page directly, without a fetch and unpin.
+   * @param page_id id of the page, which must be pinned
+   * @return false if the page is not resident or not pinned
+   */
+  bool MarkPageDirtyImp(page_id_t page_id) override;
+
+  /**
+   * Fetch the requested page, reading it into a frame of the strategy's ring on a miss.
+   * @param page_id id of page to be fetched
+   * @param strategy the ring of the bulk operation, nullptr for a regular fetch
+   * @return the requested page, nullptr if no frame is available or the page failed checksum verification
+   */
+  Page *FetchPgImp(page_id_t page_id, BufferAccessStrategy *strategy) override;
+
+  /**
+   * Creates a new page in a frame of the strategy's ring.
+   * @param[out] page_id id of created page
+   * @param strategy the ring of the bulk operation, nullptr for a regular new page
+   * @return nullptr if no new pages could be created, otherwise pointer to new page
+   */
+  Page *NewPgImp(page_id_t *page_id, BufferAccessStrategy *strategy) override;
+
+  /**
+   * Allocate a page on disk, reusing the lowest free page of this instance before growing the file.
    * @return the id of the allocated page
    */
   page_id_t AllocatePage();
 
   /**
-   * Deallocate a page on disk.
+   * Deallocate a page on disk, so that AllocatePage can reuse it.
    * @param page_id id of the page to deallocate
    */
-  void DeallocatePage(__attribute__((unused)) page_id_t page_id) {
-    // This is a no-nop right now without a more complex data structure to track deallocated pages
-  }
+  void DeallocatePage(page_id_t page_id);
+
+  /**
+   * One partition of the page table. Lookups only take the shared latch, while inserting or erasing a mapping takes
+   * the exclusive latch of the partition the page id hashes to.
+   */
+  struct PageTableShard {
+    std::shared_mutex latch_;
+    std::unordered_map<page_id_t, frame_id_t> table_;
+  };
+
+  /** Number of partitions in the page table. */
+  static constexpr size_t PAGE_TABLE_SHARD_NUM = 16;
+
+  /** @return the page table partition responsible for the given page id */
+  PageTableShard &GetShard(page_id_t page_id);
+
+  /**
+   * Pin a page that is already resident in the buffer pool. Only the shared latch of one page table partition is
+   * taken, so concurrent hits do not serialize.
+   * @param page_id id of the page to pin
+   * @return the pinned page, or nullptr if the page is not resident
+   */
+  Page *PinResidentPage(page_id_t page_id);
+
+  /**
+   * Take a frame from the free list or evict one from the replacer, writing it back if it is dirty.
+   * Must be called with latch_ held.
+   * @param[out] frame_id the frame that can be reused
+   * @return false if every frame is pinned, true otherwise
+   */
+  bool AcquireFrame(frame_id_t *frame_id);
+
+  /**
+   * Take a frame for a page requested by a bulk operation. The frame the operation used a ring-size misses ago is
+   * recycled if it still holds the page the operation put there and nobody has it pinned; otherwise a frame is taken
+   * with AcquireFrame and remembered in the ring. Must be called with latch_ held.
+   * @param[out] frame_id the frame that can be reused
+   * @param page_id the page that is going to live in the frame
+   * @param strategy the ring of the bulk operation, nullptr to fall back to AcquireFrame
+   * @return false if every frame is pinned, true otherwise
+   */
+  bool AcquireFrame(frame_id_t *frame_id, page_id_t page_id, BufferAccessStrategy *strategy);
+
+  /** A read-ahead that has been issued but whose frame is not in the page table yet. */
+  struct PendingRead {
+    frame_id_t frame_id_;
+    std::future<bool> read_;
+  };
+
+  /**
+   * Wait for a read-ahead and publish its frame in the page table. Must be called with latch_ held.
+   * @param iter the pending read, erased by this call
+   * @param pin_count initial pin count of the page; an unpinned page becomes evictable right away
+   * @return the page, or nullptr if the read failed and the frame went back to the free list
+   */
+  Page *CompletePendingRead(std::unordered_map<page_id_t, PendingRead>::iterator iter, int pin_count);
+
+  /** Publish every read-ahead that has already completed, as an unpinned page. Must be called with latch_ held. */
+  void ReapPendingReads();
+
+  /** Mark a page dirty, waking up the flush thread if the high watermark is crossed. */
+  void MarkDirty(Page *page);
+
+  /** Clear the dirty flag of a page. @return true if the page was dirty */
+  bool MarkClean(Page *page);
+
+  /** Body of the background flush thread. */
+  void FlushThreadLoop();
+
+  /**
+   * Write back a resident page if it is dirty and nobody has it pinned. The page is pinned and read latched for the
+   * duration of the write, so it can neither be evicted nor modified meanwhile.
+   * @param page_id id of the page
+   * @param frame_id frame the page was seen in
+   */
+  void WriteBackUnpinned(page_id_t page_id, frame_id_t frame_id);
+
+  /**
+   * Pin a resident page so that it is not evicted while it is written back, without touching the replacer.
+   * @param page_id id of the page
+   * @param[out] frame_id frame holding the page
+   * @return false if the page is not resident
+   */
+  bool PinForFlush(page_id_t page_id, frame_id_t *frame_id);
+
+  /** Drop the pin taken by PinForFlush, handing the frame back to the replacer if it was the last one. */
+  void UnpinAfterFlush(page_id_t page_id, frame_id_t frame_id);
 
   /**
    * Validate that the page_id being used is accessible to this BPI. This can be used in all of the functions to
@@ -130,19 +288,55 @@ class BufferPoolManagerInstance : public BufferPoolManager {
   /** Each BPI maintains its own counter for page_ids to hand out, must ensure they mod back to its instance_index_ */
   std::atomic<page_id_t> next_page_id_ = instance_index_;
 
-  /** Array of buffer pool pages. */
+  /** Array of buffer pool pages, i.e. the metadata of every frame. */
   Page *pages_;
+  /** The data of every frame. */
+  FrameArena *arena_;
   /** Pointer to the disk manager. */
   DiskManager *disk_manager_ __attribute__((__unused__));
   /** Pointer to the log manager. */
   LogManager *log_manager_ __attribute__((__unused__));
-  /** Page table for keeping track of buffer pool pages. */
-  std::unordered_map<page_id_t, frame_id_t> page_table_;
+  /** Page table for keeping track of buffer pool pages, partitioned by page id. */
+  std::array<PageTableShard, PAGE_TABLE_SHARD_NUM> page_table_;
   /** Replacer to find unpinned pages for replacement. */
   Replacer *replacer_;
   /** List of free pages. */
   std::list<frame_id_t> free_list_;
-  /** This latch protects shared data structures. We recommend updating this comment to describe what it protects. */
+  /** Size of free_list_, readable without latch_ so that a parallel BPM can route new pages cheaply. */
+  std::atomic<size_t> num_free_frames_{0};
+  /**
+   * Serializes everything that changes which page lives in which frame: the free list, victim selection, page
+   * allocation and deletion. Hits and unpins never take it.
+   */
   std::mutex latch_;
+
+  /** Read-aheads in flight, keyed by page id. Protected by latch_. */
+  std::unordered_map<page_id_t, PendingRead> pending_reads_;
+  /** Read-aheads may tie up at most one in PENDING_READ_RATIO frames of the pool (but always at least one). */
+  static constexpr size_t PENDING_READ_RATIO = 4;
+  /** The ring of a bulk operation may span at most one in MAX_RING_RATIO frames of the pool (but at least one). */
+  static constexpr size_t MAX_RING_RATIO = 4;
+
+  /** Number of dirty pages in the buffer pool. */
+  std::atomic<size_t> num_dirty_{0};
+  /** Counters and latency histograms, recorded without any latch. */
+  BufferPoolStats stats_;
+  /**
+   * Serializes writing back resident pages, so that an older image can never overwrite a newer one on disk. It is
+   * taken before the latch of the page being written.
+   */
+  std::mutex flush_latch_;
+  /** Background flush thread, nullptr when not running. */
+  std::thread *flush_thread_{nullptr};
+  /** Protects the flush thread state below. */
+  std::mutex flush_thread_latch_;
+  /** Wakes up the flush thread. */
+  std::condition_variable flush_cv_;
+  /** True while the flush thread should keep running. */
+  bool flush_thread_running_{false};
+  /** The flush thread writes back until at most this many pages are dirty. */
+  size_t flush_low_watermark_{0};
+  /** More than this many dirty pages wake up the flush thread early. */
+  std::atomic<size_t> flush_high_watermark_{SIZE_MAX};
 };
 }  // namespace bustub
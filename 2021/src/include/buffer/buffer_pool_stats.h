@@ -0,0 +1,150 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// buffer_pool_stats.h
+//
+// Identification: src/include/buffer/buffer_pool_stats.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <cstdint>
+#include <string>
+
+#include "common/macros.h"
+
+namespace bustub {
+
+/** Events counted by a buffer pool. */
+enum class BufferPoolCounter {
+  /** FetchPage found the page resident. */
+  HITS,
+  /** FetchPage had to read the page from disk (or wait for its read-ahead). */
+  MISSES,
+  /** A resident page was evicted to make room for another one. */
+  EVICTIONS,
+  /** An evicted page was dirty and had to be written back first. */
+  DIRTY_EVICTIONS,
+  /** A dirty page was written back by FlushPage, FlushAllPages or the background flush thread. */
+  FLUSHES,
+  /** A read-ahead was issued. */
+  PREFETCHES,
+  NUM_COUNTERS
+};
+
+/** Operations whose latency a buffer pool records. */
+enum class BufferPoolLatency {
+  /** Serving a FetchPage miss, from the lookup until the page is resident. */
+  FETCH_MISS,
+  /** Evicting a victim, including its write-back. */
+  EVICT,
+  /** Writing back a single page outside of eviction. */
+  FLUSH,
+  /** Waiting for the instance latch that serializes frame reassignment. */
+  LATCH_WAIT,
+  NUM_LATENCIES
+};
+
+/**
+ * A point-in-time copy of a latency histogram. Bucket i counts the samples of [2^i, 2^(i+1)) nanoseconds.
+ */
+struct LatencyHistogramSnapshot {
+  static constexpr size_t NUM_BUCKETS = 40;
+
+  std::array<uint64_t, NUM_BUCKETS> buckets_{};
+  uint64_t count_{0};
+  uint64_t sum_ns_{0};
+
+  /** @return the mean latency in nanoseconds, 0 without samples */
+  double MeanNs() const { return count_ == 0 ? 0 : static_cast<double>(sum_ns_) / count_; }
+
+  /**
+   * @param percentile between 0 and 1, e.g. 0.99
+   * @return an upper bound of the latency below which the given fraction of samples fall, 0 without samples
+   */
+  uint64_t PercentileNs(double percentile) const;
+
+  LatencyHistogramSnapshot &operator+=(const LatencyHistogramSnapshot &other);
+};
+
+/**
+ * A point-in-time copy of the statistics of one or more buffer pools.
+ */
+struct BufferPoolStatsSnapshot {
+  std::array<uint64_t, static_cast<size_t>(BufferPoolCounter::NUM_COUNTERS)> counters_{};
+  std::array<LatencyHistogramSnapshot, static_cast<size_t>(BufferPoolLatency::NUM_LATENCIES)> latencies_{};
+
+  /** @return the value of a counter */
+  uint64_t Get(BufferPoolCounter counter) const { return counters_[static_cast<size_t>(counter)]; }
+
+  /** @return the histogram of an operation */
+  const LatencyHistogramSnapshot &Get(BufferPoolLatency latency) const {
+    return latencies_[static_cast<size_t>(latency)];
+  }
+
+  /** @return the fraction of fetches served without I/O, 0 before the first fetch */
+  double HitRatio() const;
+
+  /** @return a one-line human readable summary */
+  std::string ToString() const;
+
+  BufferPoolStatsSnapshot &operator+=(const BufferPoolStatsSnapshot &other);
+};
+
+/**
+ * BufferPoolStats collects the counters and latency histograms of one buffer pool instance.
+ *
+ * Recording never takes a latch. Every thread is assigned one of NUM_SLOTS cache-line aligned slots the first time it
+ * records anything, and only does relaxed atomic increments on its own slot, so threads do not bounce cache lines
+ * between cores. Snapshot sums up all slots; it is not atomic with respect to concurrent recording.
+ */
+class BufferPoolStats {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  /** Number of slots that threads are spread over. */
+  static constexpr size_t NUM_SLOTS = 16;
+
+  BufferPoolStats() = default;
+  DISALLOW_COPY_AND_MOVE(BufferPoolStats);
+
+  /** @return the start time of an operation, to be passed to RecordLatency */
+  static Clock::time_point Now() { return Clock::now(); }
+
+  /** Count one event. */
+  void Increment(BufferPoolCounter counter) {
+    GetSlot().counters_[static_cast<size_t>(counter)].fetch_add(1, std::memory_order_relaxed);
+  }
+
+  /** Record the latency of an operation that started at start_time and ends now. */
+  void RecordLatency(BufferPoolLatency latency, Clock::time_point start_time);
+
+  /** @return the sum over all slots */
+  BufferPoolStatsSnapshot Snapshot() const;
+
+ private:
+  struct Histogram {
+    std::array<std::atomic<uint64_t>, LatencyHistogramSnapshot::NUM_BUCKETS> buckets_{};
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> sum_ns_{0};
+  };
+
+  struct alignas(64) Slot {
+    std::array<std::atomic<uint64_t>, static_cast<size_t>(BufferPoolCounter::NUM_COUNTERS)> counters_{};
+    std::array<Histogram, static_cast<size_t>(BufferPoolLatency::NUM_LATENCIES)> latencies_{};
+  };
+
+  /** @return the slot of the calling thread */
+  Slot &GetSlot();
+
+  std::array<Slot, NUM_SLOTS> slots_{};
+};
+
+}  // namespace bustub
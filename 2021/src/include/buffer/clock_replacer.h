@@ -12,8 +12,7 @@
 
 #pragma once
 
-#include <list>
-#include <mutex>  // NOLINT
+#include <atomic>
 #include <vector>
 
 #include "buffer/replacer.h"
@@ -23,6 +22,11 @@ namespace bustub {
 
 /**
  * ClockReplacer implements the clock replacement policy, which approximates the Least Recently Used policy.
+ *
+ * Every frame owns one byte in a contiguous array holding its evictable and reference bits. Pin and Unpin are a
+ * single atomic read-modify-write on that byte, so the replacer takes no latch on a buffer pool hit. Victim sweeps
+ * the clock hand over the array, clearing reference bits with compare-and-swap until it finds an evictable frame
+ * whose reference bit is already clear.
  */
 class ClockReplacer : public Replacer {
  public:
@@ -43,10 +47,22 @@ class ClockReplacer : public Replacer {
 
   void Unpin(frame_id_t frame_id) override;
 
+  void Remove(frame_id_t frame_id) override;
+
   size_t Size() override;
 
  private:
-  // TODO(student): implement me!
+  /** The frame may be victimized. */
+  static constexpr uint8_t EVICTABLE = 0x1;
+  /** The frame was unpinned since the clock hand last passed over it. */
+  static constexpr uint8_t REFERENCED = 0x2;
+
+  /** Evictable and reference bits of every frame, indexed by frame id. */
+  std::vector<std::atomic<uint8_t>> frames_;
+  /** Position of the clock hand, taken modulo the number of frames. */
+  std::atomic<size_t> hand_{0};
+  /** Number of evictable frames. */
+  std::atomic<size_t> size_{0};
 };
 
 }  // namespace bustub
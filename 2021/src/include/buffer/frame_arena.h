@@ -0,0 +1,76 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// frame_arena.h
+//
+// Identification: src/include/buffer/frame_arena.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "common/config.h"
+#include "common/macros.h"
+
+namespace bustub {
+
+/**
+ * FrameArena is one contiguous, page-aligned allocation holding the data of every frame of a buffer pool instance.
+ *
+ * Keeping frame data in one region, apart from the Page metadata, lets large pools be backed by 2 MB huge pages:
+ * explicit hugetlbfs pages if the system has reserved some, transparent huge pages otherwise. This cuts TLB misses
+ * when a multi-GB pool is accessed randomly. The arena can also be bound to a NUMA node, so that an instance of a
+ * parallel buffer pool keeps its frames close to the threads it serves.
+ */
+class FrameArena {
+ public:
+  /** Size of a huge page. Arenas smaller than this use ordinary pages. */
+  static constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+  /**
+   * Map the memory of a new arena. The memory is zeroed.
+   * @param num_frames the number of frames in the arena
+   * @param numa_node the NUMA node the memory should preferably come from, -1 for no preference
+   * @param frame_size the size of a frame, i.e. the page size of the buffer pool
+   */
+  explicit FrameArena(size_t num_frames, int numa_node = -1, size_t frame_size = PAGE_SIZE);
+
+  /**
+   * Unmap the memory of the arena.
+   */
+  ~FrameArena();
+
+  DISALLOW_COPY_AND_MOVE(FrameArena);
+
+  /** @return the data of a frame, frame size bytes aligned to at least DIRECT_IO_ALIGNMENT */
+  char *GetFrameData(frame_id_t frame_id) const { return data_ + static_cast<size_t>(frame_id) * frame_size_; }
+
+  /** @return the size of a frame */
+  size_t GetFrameSize() const { return frame_size_; }
+
+  /** @return true if the arena is backed by explicitly reserved huge pages */
+  bool IsHugeTlb() const { return huge_tlb_; }
+
+  /** @return true if the arena was bound to a NUMA node */
+  bool IsNumaBound() const { return numa_bound_; }
+
+  /** @return the ids of the NUMA nodes that have memory, empty if the system does not tell */
+  static std::vector<int> GetNumaNodes();
+
+ private:
+  /** Start of the mapping. */
+  char *data_;
+  /** Length of the mapping, a multiple of HUGE_PAGE_SIZE for arenas that use huge pages. */
+  size_t size_;
+  size_t frame_size_;
+  bool huge_tlb_{false};
+  bool numa_bound_{false};
+};
+
+}  // namespace bustub
@@ -0,0 +1,90 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// lru_k_replacer.h
+//
+// Identification: src/include/buffer/lru_k_replacer.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <list>
+#include <mutex>  // NOLINT
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "buffer/replacer.h"
+#include "common/config.h"
+
+namespace bustub {
+
+/**
+ * LRUKReplacer implements the LRU-K replacement policy.
+ *
+ * Every Pin counts as an access to the frame, and the replacer remembers the timestamps of the last K accesses. The
+ * victim is the frame whose K-th most recent access lies furthest in the past (the largest backward K-distance).
+ * Frames with fewer than K accesses have an infinite backward K-distance and are evicted first, oldest first access
+ * first. A page touched once by a scan is therefore evicted before any page that has been re-referenced, which keeps
+ * index pages resident across large scans.
+ *
+ * Accesses to a frame that follow its previous access within the correlated reference period are considered part of
+ * the same reference (e.g. a scan fetching the same page once per tuple), and only refresh its last access.
+ */
+class LRUKReplacer : public Replacer {
+ public:
+  /**
+   * Create a new LRUKReplacer.
+   * @param num_pages the maximum number of pages the LRUKReplacer will be required to store
+   * @param k number of accesses remembered per frame
+   * @param correlated_period accesses closer than this many timestamps to the previous one count as the same reference
+   */
+  explicit LRUKReplacer(size_t num_pages, size_t k = LRUK_REPLACER_K,
+                        uint64_t correlated_period = LRUK_CORRELATED_PERIOD);
+
+  /**
+   * Destroys the LRUKReplacer.
+   */
+  ~LRUKReplacer() override;
+
+  bool Victim(frame_id_t *frame_id) override;
+
+  void Pin(frame_id_t frame_id) override;
+
+  void Unpin(frame_id_t frame_id) override;
+
+  void Remove(frame_id_t frame_id) override;
+
+  size_t Size() override;
+
+ private:
+  /** Access history of a single frame. */
+  struct FrameHistory {
+    /** Timestamps of the last (at most) k accesses, oldest first. */
+    std::list<uint64_t> accesses_;
+    /** True if the frame is currently in cold_set_ or hot_set_. */
+    bool evictable_{false};
+    /** Timestamp ordering the frame inside cold_set_ or hot_set_ while it is evictable. */
+    uint64_t evict_timestamp_{0};
+  };
+
+  /** Number of accesses remembered per frame. */
+  size_t k_;
+  /** See the constructor. */
+  uint64_t correlated_period_;
+  /** Logical clock, advanced by every access that is not correlated with the previous one. */
+  uint64_t current_timestamp_{0};
+  /** History of every frame, indexed by frame id. */
+  std::vector<FrameHistory> history_;
+  /** Evictable frames with fewer than k accesses, ordered by their oldest access. */
+  std::set<std::pair<uint64_t, frame_id_t>> cold_set_;
+  /** Evictable frames with k accesses, ordered by their k-th most recent access. */
+  std::set<std::pair<uint64_t, frame_id_t>> hot_set_;
+  std::mutex latch_;
+};
+
+}  // namespace bustub
@@ -12,6 +12,9 @@
 
 #pragma once
 
+#include <atomic>
+#include <vector>
+
 #include "buffer/buffer_pool_manager.h"
 #include "buffer/buffer_pool_manager_instance.h"
 #include "recovery/log_manager.h"
@@ -28,9 +31,10 @@ class ParallelBufferPoolManager : public BufferPoolManager {
    * @param pool_size the pool size of each BufferPoolManagerInstance
    * @param disk_manager the disk manager
    * @param log_manager the log manager (for testing only: nullptr = disable logging)
+   * @param replacer_policy the replacement policy of every BufferPoolManagerInstance
    */
   ParallelBufferPoolManager(size_t num_instances, size_t pool_size, DiskManager *disk_manager,
-                            LogManager *log_manager = nullptr);
+                            LogManager *log_manager = nullptr, ReplacerPolicy replacer_policy = ReplacerPolicy::LRU);
 
   /**
    * Destroys an existing ParallelBufferPoolManager.
@@ -40,6 +44,26 @@ class ParallelBufferPoolManager : public BufferPoolManager {
   /** @return size of the buffer pool */
   size_t GetPoolSize() override;
 
+  /** @return size of every page, the same in all BufferPoolManagerInstances */
+  size_t GetPageSize() override { return (*managers_)->GetPageSize(); }
+
+  /**
+   * Start the background flush thread of every BufferPoolManagerInstance.
+   * @param low_watermark fraction of each instance that may stay dirty after a round of write-back
+   * @param high_watermark fraction of each instance that, once exceeded, wakes its flush thread up early
+   */
+  void RunFlushThread(double low_watermark = 0.1, double high_watermark = 0.3);
+
+  /** Stop the background flush thread of every BufferPoolManagerInstance. */
+  void StopFlushThread();
+
+  /**
+   * @return the counters and latency histograms summed over all BufferPoolManagerInstances
+   * @param instance_stats if not nullptr, receives the statistics of each instance, so that skew between instances
+   * (e.g. a hot instance with a low hit ratio or long latch waits) can be spotted
+   */
+  BufferPoolStatsSnapshot GetStats(std::vector<BufferPoolStatsSnapshot> *instance_stats = nullptr) const;
+
  protected:
   /**
    * @param page_id id of page
@@ -88,11 +112,42 @@ class ParallelBufferPoolManager : public BufferPoolManager {
    */
   void FlushAllPgsImp() override;
 
+  /**
+   * Start reading a page into the responsible BufferPoolManagerInstance in the background.
+   * @param page_id id of the page to read ahead
+   * @param strategy the ring of the bulk operation issuing the read-ahead, may be nullptr
+   * @return true if the page is resident and can be fetched without waiting for I/O, false otherwise
+   */
+  bool PrefetchPgImp(page_id_t page_id, BufferAccessStrategy *strategy) override;
+
+  /**
+   * Mark a pinned page as dirty in the responsible BufferPoolManagerInstance.
+   * @param page_id id of the page, which must be pinned
+   * @return false if the page is not resident or not pinned
+   */
+  bool MarkPageDirtyImp(page_id_t page_id) override;
+
+  /**
+   * Fetch page for page_id from the responsible BufferPoolManagerInstance, on behalf of a bulk operation.
+   * @param page_id id of page to be fetched
+   * @param strategy the ring of the bulk operation, may be nullptr
+   * @return the requested page
+   */
+  Page *FetchPgImp(page_id_t page_id, BufferAccessStrategy *strategy) override;
+
+  /**
+   * Create a new page in one of the BufferPoolManagerInstances, on behalf of a bulk operation.
+   * @param[out] page_id id of created page
+   * @param strategy the ring of the bulk operation, may be nullptr
+   * @return nullptr if no new pages could be created, otherwise pointer to new page
+   */
+  Page *NewPgImp(page_id_t *page_id, BufferAccessStrategy *strategy) override;
+
  private:
   BufferPoolManager **managers_;
   size_t num_instances_;
   size_t pool_size_;
-  std::mutex latch_;
-  size_t next_instance_;
+  /** Instance that the next NewPage starts looking at; advanced atomically, so allocation takes no global latch. */
+  std::atomic<size_t> next_instance_{0};
 };
 }  // namespace bustub
@@ -16,6 +16,18 @@
 
 namespace bustub {
 
+/**
+ * Replacement policies a BufferPoolManagerInstance can be constructed with.
+ */
+enum class ReplacerPolicy {
+  /** Least recently used, see LRUReplacer. */
+  LRU,
+  /** LRU-K, which keeps re-referenced pages resident across large scans, see LRUKReplacer. */
+  LRU_K,
+  /** CLOCK, which takes no latch on Pin and Unpin, see ClockReplacer. */
+  CLOCK,
+};
+
 /**
  * Replacer is an abstract class that tracks page usage.
  */
@@ -43,6 +55,13 @@ class Replacer {
    */
   virtual void Unpin(frame_id_t frame_id) = 0;
 
+  /**
+   * Removes a frame together with whatever the policy remembers about it, because the buffer pool reuses the frame
+   * for another page without going through Victim.
+   * @param frame_id the id of the frame to remove
+   */
+  virtual void Remove(frame_id_t frame_id) { Pin(frame_id); }
+
   /** @return the number of elements in the replacer that can be victimized */
   virtual size_t Size() = 0;
 };
@@ -0,0 +1,61 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// channel.h
+//
+// Identification: src/include/common/channel.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <condition_variable>  // NOLINT
+#include <mutex>               // NOLINT
+#include <queue>
+#include <utility>
+
+namespace bustub {
+
+/**
+ * Channel is an unbounded, thread-safe multi-producer multi-consumer queue.
+ */
+template <class T>
+class Channel {
+ public:
+  Channel() = default;
+  ~Channel() = default;
+
+  /**
+   * Put an element into the channel and wake up one waiting consumer.
+   * @param element the element to be put
+   */
+  void Put(T element) {
+    {
+      std::lock_guard<std::mutex> guard(latch_);
+      queue_.push(std::move(element));
+    }
+    cv_.notify_one();
+  }
+
+  /**
+   * Take an element out of the channel, blocking until one is available.
+   * @return the element at the front of the channel
+   */
+  T Get() {
+    std::unique_lock<std::mutex> lock(latch_);
+    cv_.wait(lock, [&] { return !queue_.empty(); });
+    T element = std::move(queue_.front());
+    queue_.pop();
+    return element;
+  }
+
+ private:
+  std::mutex latch_;
+  std::condition_variable cv_;
+  std::queue<T> queue_;
+};
+
+}  // namespace bustub
@@ -27,14 +27,24 @@ extern std::atomic<bool> enable_logging;
 /** If ENABLE_LOGGING is true, the log should be flushed to disk every LOG_TIMEOUT. */
 extern std::chrono::duration<int64_t> log_timeout;
 
+/** A running buffer pool flush thread wakes up every BACKGROUND_FLUSH_INTERVAL milliseconds. */
+extern std::chrono::milliseconds background_flush_interval;
+
 static constexpr int INVALID_PAGE_ID = -1;                                    // invalid page id
 static constexpr int INVALID_TXN_ID = -1;                                     // invalid transaction id
 static constexpr int INVALID_LSN = -1;                                        // invalid log sequence number
 static constexpr int HEADER_PAGE_ID = 0;                                      // the header page id
-static constexpr int PAGE_SIZE = 4096;                                        // size of a data page in byte
+static constexpr int PAGE_SIZE = 4096;                                        // default and minimum page size in byte
+static constexpr int MAX_PAGE_SIZE = 65536;                                   // maximum page size in byte
+static constexpr int DIRECT_IO_ALIGNMENT = 512;                               // buffer alignment for O_DIRECT
 static constexpr int BUFFER_POOL_SIZE = 10;                                   // size of buffer pool
 static constexpr int LOG_BUFFER_SIZE = ((BUFFER_POOL_SIZE + 1) * PAGE_SIZE);  // size of a log buffer in byte
 static constexpr int BUCKET_SIZE = 50;                                        // size of extendible hash bucket
+static constexpr int SCAN_PREFETCH_DEPTH = 4;                                 // pages read ahead of a table scan
+static constexpr size_t LRUK_REPLACER_K = 2;                                  // accesses remembered by LRU-K
+static constexpr uint64_t LRUK_CORRELATED_PERIOD = 16;                        // LRU-K correlated reference period
+static constexpr size_t BULK_READ_RING_SIZE = 32;                             // frames recycled by a table scan
+static constexpr size_t BULK_WRITE_RING_SIZE = 128;                           // frames recycled by a bulk insert
 
 using frame_id_t = int32_t;    // frame id type
 using page_id_t = int32_t;     // page id type
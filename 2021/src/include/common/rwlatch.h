@@ -12,27 +12,31 @@
 
 #pragma once
 
+#include <atomic>
 #include <climits>
 #include <condition_variable>  // NOLINT
-#include <mutex>               // NOLINT
+#include <cstdint>
+#include <mutex>   // NOLINT
+#include <thread>  // NOLINT
 
 #include "common/macros.h"
 
 namespace bustub {
 
 /**
- * Reader-Writer latch backed by std::mutex.
+ * Reader-Writer latch backed by std::mutex. Every operation takes the mutex, even an uncontended RLock; kept as the
+ * baseline that ReaderWriterLatch is measured against.
  */
-class ReaderWriterLatch {
+class BlockingReaderWriterLatch {
   using mutex_t = std::mutex;
   using cond_t = std::condition_variable;
   static const uint32_t MAX_READERS = UINT_MAX;
 
  public:
-  ReaderWriterLatch() = default;
-  ~ReaderWriterLatch() { std::lock_guard<mutex_t> guard(mutex_); }
+  BlockingReaderWriterLatch() = default;
+  ~BlockingReaderWriterLatch() { std::lock_guard<mutex_t> guard(mutex_); }
 
-  DISALLOW_COPY(ReaderWriterLatch);
+  DISALLOW_COPY(BlockingReaderWriterLatch);
 
   /**
    * Acquire a write latch.
@@ -93,4 +97,179 @@ class ReaderWriterLatch {
   bool writer_entered_{false};
 };
 
+/**
+ * Reader-Writer latch with writer preference that only touches a single atomic word while uncontended.
+ *
+ * The word holds the number of readers and a writer bit. Readers enter with a CAS as long as the writer bit is clear;
+ * a writer sets the bit, which keeps new readers out, and then waits for the readers inside to drain. A thread that
+ * cannot get in spins for a bounded number of rounds and then parks on a condition variable. Threads leaving the latch
+ * only take the mutex to wake parked threads up if there are any.
+ */
+class ReaderWriterLatch {
+  static constexpr uint32_t WRITER_BIT = 1U << 31;
+  static constexpr uint32_t MAX_READERS = WRITER_BIT - 1;
+  /** Failed attempts before a thread gives up spinning and parks. */
+  static constexpr int SPIN_LIMIT = 64;
+  /** Failed attempts that are retried right away, before spinning starts yielding the CPU. */
+  static constexpr int BUSY_SPIN_LIMIT = 16;
+
+ public:
+  ReaderWriterLatch() = default;
+  ~ReaderWriterLatch() = default;
+
+  DISALLOW_COPY(ReaderWriterLatch);
+
+  /**
+   * Acquire a write latch.
+   */
+  void WLock() {
+    // 先抢到写标志，挡住新来的读者，再等里面的读者离开
+    WaitUntil([this] { return TrySetWriterBit(); });
+    WaitUntil([this] { return state_.load() == WRITER_BIT; });
+  }
+
+  /**
+   * Release a write latch.
+   */
+  void WUnlock() {
+    state_.fetch_and(~WRITER_BIT);
+    WakeUpWaiters();
+  }
+
+  /**
+   * Acquire a read latch.
+   */
+  void RLock() {
+    WaitUntil([this] { return TryAddReader(); });
+  }
+
+  /**
+   * Release a read latch.
+   */
+  void RUnlock() {
+    uint32_t state = state_.fetch_sub(1);
+    // 最后一个读者离开时，可能有写者在等
+    if (state == (WRITER_BIT | 1) || state == MAX_READERS) {
+      WakeUpWaiters();
+    }
+  }
+
+ private:
+  bool TrySetWriterBit() {
+    uint32_t state = state_.load();
+    return (state & WRITER_BIT) == 0 && state_.compare_exchange_weak(state, state | WRITER_BIT);
+  }
+
+  bool TryAddReader() {
+    uint32_t state = state_.load();
+    return (state & WRITER_BIT) == 0 && state < MAX_READERS && state_.compare_exchange_weak(state, state + 1);
+  }
+
+  /** Spin on try_enter for a while, then park until it succeeds. */
+  template <class TryEnter>
+  void WaitUntil(TryEnter try_enter) {
+    for (int i = 0; i < SPIN_LIMIT; i++) {
+      if (try_enter()) {
+        return;
+      }
+      if (i >= BUSY_SPIN_LIMIT) {
+        std::this_thread::yield();
+      }
+    }
+    // 先登记再重试，离开的线程要么看到登记，要么它的修改已经能被这次重试看到，不会丢唤醒
+    std::unique_lock<std::mutex> lock(park_mutex_);
+    num_parked_++;
+    park_cv_.wait(lock, try_enter);
+    num_parked_--;
+  }
+
+  void WakeUpWaiters() {
+    if (num_parked_.load() > 0) {
+      // 拿一下mutex，保证登记过的线程已经在wait里了
+      { std::lock_guard<std::mutex> guard(park_mutex_); }
+      park_cv_.notify_all();
+    }
+  }
+
+  /** Writer bit and reader count. */
+  std::atomic<uint32_t> state_{0};
+  /** Number of threads parked, or about to park, on park_cv_. */
+  std::atomic<uint32_t> num_parked_{0};
+  std::mutex park_mutex_;
+  std::condition_variable park_cv_;
+};
+
+/**
+ * Reader-Writer latch with a version counter, which additionally lets readers run optimistically (seqlock style).
+ *
+ * Writers take the latch exclusively and bump the version to odd on entry and back to even on exit. An optimistic
+ * reader remembers the (even) version, reads without latching anything, and then validates that the version did not
+ * change. Optimistic readers never write to the latch, so many of them can read the same object without bouncing its
+ * cache line between cores. In exchange they may observe a torn state while validation is pending, and must not act
+ * on what they read (e.g. follow a pointer or an offset read from the data without bounds checks) before validating.
+ */
+class VersionedLatch {
+ public:
+  VersionedLatch() = default;
+  ~VersionedLatch() = default;
+
+  DISALLOW_COPY(VersionedLatch);
+
+  /**
+   * Acquire a write latch.
+   */
+  void WLock() {
+    latch_.WLock();
+    version_.store(version_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    // 写数据不能被重排到版本号变成奇数之前
+    std::atomic_thread_fence(std::memory_order_release);
+  }
+
+  /**
+   * Release a write latch.
+   */
+  void WUnlock() {
+    version_.store(version_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    latch_.WUnlock();
+  }
+
+  /**
+   * Acquire a read latch, for readers that cannot tolerate torn reads or retries.
+   */
+  void RLock() { latch_.RLock(); }
+
+  /**
+   * Release a read latch.
+   */
+  void RUnlock() { latch_.RUnlock(); }
+
+  /**
+   * Start an optimistic read.
+   * @param[out] version the version to be passed to ValidateRead
+   * @return false if a writer holds the latch right now, in which case reading optimistically is pointless
+   */
+  bool TryOptimisticRead(uint64_t *version) const {
+    *version = version_.load(std::memory_order_acquire);
+    return (*version & 1) == 0;
+  }
+
+  /**
+   * Finish an optimistic read.
+   * @param version the version returned by TryOptimisticRead
+   * @return true if no writer ran since TryOptimisticRead, i.e. everything read in between is consistent
+   */
+  bool ValidateRead(uint64_t version) const {
+    // 读数据不能被重排到再次读版本号之后
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return version_.load(std::memory_order_relaxed) == version;
+  }
+
+  /** @return the current version, odd while a writer holds the latch */
+  uint64_t GetVersion() const { return version_.load(std::memory_order_acquire); }
+
+ private:
+  ReaderWriterLatch latch_;
+  std::atomic<uint64_t> version_{0};
+};
+
 }  // namespace bustub
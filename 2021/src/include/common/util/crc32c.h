@@ -0,0 +1,50 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// crc32c.h
+//
+// Identification: src/include/common/util/crc32c.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace bustub {
+
+/**
+ * Crc32cUtil computes CRC-32C (Castagnoli) checksums, as used for page checksums.
+ *
+ * On x86-64 CPUs with SSE 4.2 the crc32 instruction is used on three interleaved streams, so that its latency is hidden
+ * and a page is checksummed at close to memory bandwidth. Elsewhere a table driven slicing-by-8 implementation is used.
+ * Both produce the same checksums.
+ */
+class Crc32cUtil {
+ public:
+  /**
+   * @param crc the checksum of the preceding data, 0 to start a new checksum
+   * @param data the data to be appended
+   * @param length number of bytes of data
+   * @return the checksum of the preceding data followed by data
+   */
+  static uint32_t Extend(uint32_t crc, const char *data, size_t length);
+
+  /** @return the checksum of data */
+  static uint32_t Compute(const char *data, size_t length) { return Extend(0, data, length); }
+
+  /**
+   * Checksum without the hardware path, exposed for testing.
+   * @return same as Extend
+   */
+  static uint32_t ExtendSoftware(uint32_t crc, const char *data, size_t length);
+
+  /** @return true if Extend uses the crc32 instruction */
+  static bool IsHardwareAccelerated();
+};
+
+}  // namespace bustub
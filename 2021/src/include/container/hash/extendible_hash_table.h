@@ -12,15 +12,20 @@
 
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <mutex>  // NOLINT
 #include <queue>
 #include <string>
 #include <vector>
 
 #include "buffer/buffer_pool_manager.h"
+#include "common/macros.h"
 #include "concurrency/transaction.h"
 #include "container/hash/hash_function.h"
 #include "storage/page/hash_table_bucket_page.h"
 #include "storage/page/hash_table_directory_page.h"
+#include "storage/page/hash_table_root_page.h"
 
 namespace bustub {
 
@@ -30,6 +35,11 @@ namespace bustub {
  * Implementation of extendible hash table that is backed by a buffer pool
  * manager. Non-unique keys are supported. Supports insert and delete. The
  * table grows/shrinks dynamically as buckets become full/empty.
+ *
+ * A root page fans out to up to ROOT_ARRAY_SIZE directory pages by the top bits
+ * of the hash, each directory maps the low bits to buckets. When a directory is
+ * full it is split in two, so the table can grow to ROOT_ARRAY_SIZE *
+ * DIRECTORY_ARRAY_SIZE buckets.
  */
 template <typename KeyType, typename ValueType, typename KeyComparator>
 class ExtendibleHashTable {
@@ -44,6 +54,15 @@ class ExtendibleHashTable {
   explicit ExtendibleHashTable(const std::string &name, BufferPoolManager *buffer_pool_manager,
                                const KeyComparator &comparator, HashFunction<KeyType> hash_fn);
 
+  /**
+   * Unpins the directory pages the table keeps pinned, so that the buffer pool can evict them. The destructor leaves
+   * them pinned and never calls the buffer pool manager, so call this first if the buffer pool outlives the table.
+   * The table must not be used afterwards.
+   */
+  void Close();
+
+  DISALLOW_COPY_AND_MOVE(ExtendibleHashTable);
+
   /**
    * Inserts a key-value pair into the hash table.
    *
@@ -77,7 +96,21 @@ class ExtendibleHashTable {
   bool GetValue(Transaction *transaction, const KeyType &key, std::vector<ValueType> *result);
 
   /**
-   * Returns the global depth.  Do not touch.
+   * Performs a batch of point queries on the hash table. The keys are grouped by bucket page, so every bucket is
+   * fetched and latched once per batch, and the bucket page of the next group is prefetched while one is probed.
+   *
+   * @param transaction the current transaction
+   * @param keys the keys to look up, duplicates allowed
+   * @param[out] results results[i] receives the value(s) associated with keys[i]
+   * @return the number of keys with at least one value
+   */
+  uint32_t GetValues(Transaction *transaction, const std::vector<KeyType> &keys,
+                     std::vector<std::vector<ValueType>> *results);
+
+  /**
+   * Returns the global depth: the number of hash bits used to find a bucket, which is
+   * the depth of a directory in the root plus the global depth of the directory, for
+   * the deepest directory.
    */
   uint32_t GetGlobalDepth();
 
@@ -124,11 +157,43 @@ class ExtendibleHashTable {
   inline uint32_t KeyToPageId(KeyType key, HashTableDirectoryPage *dir_page);
 
   /**
-   * Fetches the directory page from the buffer pool manager.
+   * @param key the key for lookup
+   * @return the slot of the root page the key belongs to
+   */
+  inline uint32_t KeyToSlot(KeyType key);
+
+  /**
+   * Creates the root page, the first directory page and the first bucket page. The first directory page stays pinned
+   * until Close.
+   */
+  void CreateRoot();
+
+  /**
+   * Fetches the root page from the buffer pool manager, creating the table on the first call. Only directory splits
+   * and the debugging helpers need it, operations find their directory in directories_.
+   *
+   * @return a pointer to the root page
+   */
+  HashTableRootPage *FetchRootPage();
+
+  /**
+   * Returns the directory page of a slot of the root page, fetching it from the buffer pool manager unless it is kept
+   * pinned. The caller holds the latch of the slot, and releases the page with UnpinDirectoryPage.
+   *
+   * @param slot the slot of the root page
+   * @return the directory page, its latch protects the directory
+   */
+  Page *FetchDirectoryPage(uint32_t slot);
+
+  /**
+   * Releases a page returned by FetchDirectoryPage. A directory page kept pinned is only marked dirty.
    *
-   * @return a pointer to the directory page
+   * @param slot the slot of the root page
+   * @param is_dirty true if the directory was modified
    */
-  HashTableDirectoryPage *FetchDirectoryPage();
+  void UnpinDirectoryPage(uint32_t slot, bool is_dirty);
+
+  HashTableDirectoryPage *RetrieveDirectory(Page *page);
 
   /**
    * Fetches the a bucket page from the buffer pool manager using the bucket's page_id.
@@ -150,6 +215,29 @@ class ExtendibleHashTable {
    */
   bool SplitInsert(Transaction *transaction, const KeyType &key, const ValueType &value);
 
+  /**
+   * Moves the entries of a bucket whose hash has image_hash_bit set to image_bucket.
+   */
+  void MoveEntries(HASH_TABLE_BUCKET_TYPE *bucket, HASH_TABLE_BUCKET_TYPE *image_bucket, uint32_t image_hash_bit);
+
+  /**
+   * @param bucket a full bucket
+   * @param directory_depth the depth of the bucket's directory
+   * @return true if the hashes of the bucket's entries differ in a bit that splitting the directory further would use,
+   * false if they would stay together however far the directory is split, e.g. when they all have the same key
+   */
+  bool IsDirectorySplittable(HASH_TABLE_BUCKET_TYPE *bucket, uint32_t directory_depth);
+
+  /**
+   * Splits the directory of a key by the next top bit of the hash, because the key's bucket is full and can't be split
+   * within the directory. Every slot of the directory is write-latched meanwhile.
+   *
+   * @param key the key to be inserted
+   * @return false if the directory can't be split any more or splitting it wouldn't make room in the key's bucket,
+   * true if it was split or the caller should retry
+   */
+  bool SplitDirectory(const KeyType &key);
+
   /**
    * Optionally merges an empty bucket into it's pair.  This is called by Remove,
    * if Remove makes a bucket empty.
@@ -159,23 +247,67 @@ class ExtendibleHashTable {
    * 2. The bucket has local depth 0.
    * 3. The bucket's local depth doesn't match its split image's local depth.
    *
+   * Only the two bucket pages are latched while they are checked, and the directory only while it is changed.
+   *
    * @param transaction a pointer to the current transaction
    * @param key the key that was removed
-   * @param value the value that was removed
    */
-  void Merge(Transaction *transaction, uint32_t target_bucket_index);
+  void Merge(Transaction *transaction, const KeyType &key);
+
+  /**
+   * Pins and latches the bucket page a key maps to. The directory latch is not held while waiting for the bucket
+   * latch; instead the mapping is checked again once the bucket is latched, and the lookup is retried if the bucket
+   * was split or merged in between. Splits and merges latch the buckets they change, so the mapping then stays put
+   * until the bucket is unlatched.
+   *
+   * @param key the key for lookup
+   * @param dir_page the directory page of the key
+   * @param exclusive true for a write latch, false for a read latch
+   * @param[out] bucket_page_id the page_id of the bucket
+   * @return the pinned and latched bucket page
+   */
+  Page *LatchBucketPage(const KeyType &key, Page *dir_page, bool exclusive, page_id_t *bucket_page_id);
+
+  /** @return true if the key still maps to the bucket page in the directory */
+  bool IsBucketOf(const KeyType &key, Page *dir_page, page_id_t bucket_page_id);
+
+  /**
+   * Deletes a bucket page that was merged away. A page still pinned by a thread that looked it up before the merge is
+   * deleted by a later merge.
+   */
+  void DeleteBucketPage(page_id_t bucket_page_id);
 
   Page *AssertPage(Page *page);
 
-  std::mutex init_lock_;
+  /** The directory of a slot of the root page. */
+  struct SlotDirectory {
+    page_id_t page_id_;
+    /** The directory page if it is kept pinned, nullptr if it is fetched on every use. */
+    Page *page_;
+  };
+
+  /** Directory pages may stay pinned in at most one in PINNED_DIRECTORY_RATIO frames of the pool (but at least one). */
+  static constexpr size_t PINNED_DIRECTORY_RATIO = 8;
 
   // member variables
-  page_id_t directory_page_id_ = INVALID_PAGE_ID;
+  std::once_flag root_once_;
+  page_id_t root_page_id_ = INVALID_PAGE_ID;
+  // The directory of every slot of the root page, so operations don't read the root page. An entry only changes
+  // while its slot is write-latched.
+  std::array<SlotDirectory, ROOT_ARRAY_SIZE> directories_{};
+  std::atomic<size_t> num_pinned_directories_{0};
+  size_t max_pinned_directories_;
   BufferPoolManager *buffer_pool_manager_;
   KeyComparator comparator_;
 
-  // Readers includes inserts and removes, writers are splits and merges
-  ReaderWriterLatch table_latch_;
+  // One per slot of the root page. Operations read-latch the slot of their key, directory splits write-latch every slot
+  // of the directory. The latch of a directory page protects the directory: splits and merges write-latch it only
+  // while they change the directory, after their bucket pages are latched; nobody waits for a bucket latch while
+  // holding it.
+  std::array<ReaderWriterLatch, ROOT_ARRAY_SIZE> slot_latches_;
+  // Bucket pages merged away but still pinned when they were to be deleted
+  std::mutex retired_latch_;
+  std::vector<page_id_t> retired_page_ids_;
   HashFunction<KeyType> hash_fn_;
 };
 
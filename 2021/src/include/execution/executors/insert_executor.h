@@ -16,6 +16,7 @@
 #include <utility>
 #include <vector>
 
+#include "buffer/buffer_access_strategy.h"
 #include "execution/executor_context.h"
 #include "execution/executors/abstract_executor.h"
 #include "execution/plans/insert_plan.h"
@@ -31,6 +32,9 @@ namespace bustub {
  */
 class InsertExecutor : public AbstractExecutor {
  public:
+  /** Number of tuples handed to the table heap at once. */
+  static constexpr size_t BATCH_SIZE = 256;
+
   /**
    * Construct a new InsertExecutor instance.
    * @param exec_ctx The executor context
@@ -58,6 +62,9 @@ class InsertExecutor : public AbstractExecutor {
   const Schema *GetOutputSchema() override { return plan_->OutputSchema(); };
 
  private:
+  /** Pull the next tuple to insert from the plan or the child executor. @return false if there are no more */
+  bool NextInputTuple(Tuple *tuple, RID *rid);
+
   /** The insert plan node to be executed*/
   const InsertPlanNode *plan_;
   std::unique_ptr<AbstractExecutor> child_executor_;
@@ -65,6 +72,8 @@ class InsertExecutor : public AbstractExecutor {
   TableInfo *table_info_;
   TableHeap *table_heap_;
   std::vector<std::vector<Value>>::const_iterator iter_;
+  /** Ring of frames the pages appended by this insert are created in. */
+  BufferAccessStrategy strategy_{BufferAccessType::BULK_WRITE};
 };
 
 }  // namespace bustub
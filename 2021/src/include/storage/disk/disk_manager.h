@@ -15,10 +15,14 @@
 #include <atomic>
 #include <fstream>
 #include <future>  // NOLINT
-#include <mutex>   // NOLINT
+#include <memory>
+#include <mutex>  // NOLINT
+#include <shared_mutex>  // NOLINT
 #include <string>
+#include <vector>
 
 #include "common/config.h"
+#include "storage/disk/disk_scheduler.h"
 
 namespace bustub {
 
@@ -31,8 +35,14 @@ class DiskManager {
   /**
    * Creates a new disk manager that writes to the specified database file.
    * @param db_file the file name of the database file to write to
+   * @param use_direct_io open the database file with O_DIRECT, falling back to buffered I/O if unsupported
+   * @param page_checksums stamp every page written with a CRC-32C checksum, kept in a .crc file next to the database
+   * file, and verify it when the page is read back
+   * @param page_size size of every page in the database file, a power of two between PAGE_SIZE and MAX_PAGE_SIZE.
+   * It is not recorded in the file, so a file must always be opened with the page size it was created with.
    */
-  explicit DiskManager(const std::string &db_file);
+  explicit DiskManager(const std::string &db_file, bool use_direct_io = false, bool page_checksums = false,
+                       size_t page_size = PAGE_SIZE);
 
   ~DiskManager() = default;
 
@@ -52,8 +62,27 @@ class DiskManager {
    * Read a page from the database file.
    * @param page_id id of the page
    * @param[out] page_data output buffer
+   * @param verify_checksum verify the page checksum, if page checksums are enabled
+   * @return false if the page failed checksum verification, e.g. because its last write was torn
    */
-  void ReadPage(page_id_t page_id, char *page_data);
+  bool ReadPage(page_id_t page_id, char *page_data, bool verify_checksum = true);
+
+  /**
+   * Asynchronously write a page to the database file.
+   * @param page_id id of the page
+   * @param page_data raw page data, must stay valid until the returned future is ready
+   * @return future that becomes true once the page is on disk, false on an I/O error
+   */
+  std::future<bool> WritePageAsync(page_id_t page_id, const char *page_data);
+
+  /**
+   * Asynchronously read a page from the database file.
+   * @param page_id id of the page
+   * @param[out] page_data output buffer, must stay valid until the returned future is ready
+   * @return future that becomes true once the page has been read, false on an I/O error. The checksum is not
+   * verified, call VerifyChecksum once the future is ready.
+   */
+  std::future<bool> ReadPageAsync(page_id_t page_id, char *page_data);
 
   /**
    * Flush the entire log buffer into disk.
@@ -80,6 +109,57 @@ class DiskManager {
   /** @return the number of disk writes */
   int GetNumWrites() const;
 
+  /** @return the number of disk reads */
+  int GetNumReads() const;
+
+  /** @return the number of page reads that failed checksum verification */
+  int GetNumChecksumFailures() const { return num_checksum_failures_; }
+
+  /** @return true if pages are checksummed */
+  bool HasPageChecksums() const { return checksum_fd_ >= 0; }
+
+  /**
+   * Verify the checksum of a page read from disk.
+   * @param page_id id of the page
+   * @param page_data the page as read from disk
+   * @return false if the page was written with a different checksum; true if it matches, or if page checksums are
+   * disabled or the page was never written with a checksum
+   */
+  bool VerifyChecksum(page_id_t page_id, const char *page_data);
+
+  /**
+   * Record that a page is no longer in use, so that AllocateFreePage can hand it out again. The free-page map is kept
+   * in a .fsm file next to the database file, one bit per page, and the disk space of the page is released right away
+   * where the file system supports punching holes.
+   * @param page_id id of the page
+   */
+  void DeallocatePage(page_id_t page_id);
+
+  /**
+   * Take the lowest-numbered free page whose id is congruent to instance_index modulo num_instances, i.e. a page id
+   * owned by that buffer pool instance. Handing out low ids first keeps the file dense.
+   * @param num_instances number of buffer pool instances sharing the database file
+   * @param instance_index index of the buffer pool instance asking
+   * @return the page id, or INVALID_PAGE_ID if there is no free page for the instance
+   */
+  page_id_t AllocateFreePage(uint32_t num_instances = 1, uint32_t instance_index = 0);
+
+  /** @return the number of free pages in the free-page map */
+  size_t GetNumFreePages();
+
+  /**
+   * Shrink the database file so that it ends at its last page in use. The free pages cut off stay in the free-page map
+   * and grow the file again once they are reused. Pages written concurrently are never cut off.
+   * @return the number of pages left in the database file
+   */
+  size_t Truncate();
+
+  /** @return the size of every page in the database file */
+  size_t GetPageSize() const { return page_size_; }
+
+  /** @return true if the database file is accessed with O_DIRECT */
+  bool IsDirectIo() const { return direct_io_; }
+
   /**
    * Sets the future which is used to check for non-blocking flushes.
    * @param f the non-blocking flush check
@@ -91,18 +171,56 @@ class DiskManager {
 
  private:
   int GetFileSize(const std::string &file_name);
+  /** Grow the cached database file size so that it covers the given page. Must precede the write of the page. */
+  void ExtendFileSize(page_id_t page_id);
+  /** @return the disk scheduler serving asynchronous requests, started on first use */
+  DiskScheduler *GetDiskScheduler();
+  /** Open the checksum file, discarding its content if the database file is new. */
+  void OpenChecksumFile(const std::string &checksum_file);
+  /** Compute the checksum of a page about to be written and record it. */
+  void StampChecksum(page_id_t page_id, const char *page_data);
+  /** Open the free-page map if it exists and load it, discarding its content if the database file is new. */
+  void OpenFreeMapFile();
+  /** Set or clear the bit of a page in the free-page map and write its byte through. Requires free_map_latch_. */
+  void SetFree(page_id_t page_id, bool is_free);
+
   // stream to write log file
   std::fstream log_io_;
   std::string log_name_;
-  // stream to write db file
-  std::fstream db_io_;
   std::string file_name_;
-  int num_flushes_;
-  int num_writes_;
-  bool flush_log_;
+  std::atomic<int> num_flushes_;
+  std::atomic<int> num_writes_;
+  std::atomic<int> num_reads_{0};
+  std::atomic<bool> flush_log_;
   std::future<void> *flush_log_f_;
-  // With multiple buffer pool instances, need to protect file access
-  std::mutex db_io_latch_;
+  // db file, accessed only with positional I/O so that buffer pool instances never share a cursor
+  int db_fd_{-1};
+  bool direct_io_{false};
+  size_t page_size_;
+  // cached size of the db file, so that reads need no stat call
+  std::atomic<int64_t> db_file_size_{0};
+  // shared while a write grows the db file, exclusive while Truncate shrinks it
+  std::shared_mutex file_size_latch_;
+  std::once_flag scheduler_once_;
+  std::unique_ptr<DiskScheduler> disk_scheduler_;
+  // checksum file, -1 if page checksums are disabled; holds one uint32_t per page, 0 for pages never stamped
+  int checksum_fd_{-1};
+  // in-memory copy of the checksum file
+  std::vector<uint32_t> checksums_;
+  std::mutex checksum_latch_;
+  std::atomic<int> num_checksum_failures_{0};
+  // free-page map file, created by the first deallocation; bit (page_id % 8) of byte page_id / 8 is set if the page
+  // is free
+  std::string free_map_name_;
+  int free_map_fd_{-1};
+  // in-memory copy of the free-page map
+  std::vector<uint8_t> free_map_;
+  size_t num_free_pages_{0};
+  // per buffer pool instance: no page owned by the instance with a lower id than this one is free
+  std::vector<size_t> free_page_hints_;
+  // number of instances free_page_hints_ was built for
+  uint32_t free_map_num_instances_{0};
+  std::mutex free_map_latch_;
 };
 
 }  // namespace bustub
@@ -0,0 +1,178 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// disk_scheduler.h
+//
+// Identification: src/include/storage/disk/disk_scheduler.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <sys/uio.h>
+
+#include <condition_variable>  // NOLINT
+#include <cstdlib>
+#include <future>              // NOLINT
+#include <memory>
+#include <mutex>  // NOLINT
+#include <optional>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "common/channel.h"
+#include "common/config.h"
+#include "common/macros.h"
+
+namespace bustub {
+
+/**
+ * A single asynchronous page read or write.
+ */
+struct DiskRequest {
+  /** True for a write, false for a read. */
+  bool is_write_;
+  /**
+   * Buffer of the scheduler's page size. For a write it holds the data to be written; for a read it receives the page
+   * content. It must stay valid until the callback is fulfilled.
+   */
+  char *data_;
+  /** The page being read or written. */
+  page_id_t page_id_;
+  /** Fulfilled with true once the request completed successfully, false on an I/O error. */
+  std::promise<bool> callback_;
+};
+
+/**
+ * DiskScheduler keeps many page reads and writes outstanding against one database file descriptor.
+ *
+ * Requests are submitted to an io_uring submission queue and completed by a reaper thread. When io_uring is not
+ * available (old kernel, seccomp, ...) the scheduler falls back to a pool of worker threads issuing pread/pwrite.
+ * Either way the caller learns about completion through the promise in the DiskRequest.
+ */
+class DiskScheduler {
+ public:
+  /** Default number of requests that may be in flight on the io_uring. */
+  static constexpr uint32_t DEFAULT_QUEUE_DEPTH = 64;
+  /** Default number of pread/pwrite workers used when io_uring is unavailable. */
+  static constexpr size_t DEFAULT_NUM_WORKERS = 4;
+
+  /**
+   * Creates a new DiskScheduler.
+   * @param fd file descriptor of the database file, owned by the caller
+   * @param queue_depth maximum number of requests in flight on the io_uring
+   * @param num_workers number of worker threads for the pread/pwrite fallback
+   * @param use_io_uring false to force the pread/pwrite fallback
+   * @param direct_io true if fd was opened with O_DIRECT, in which case unaligned buffers are bounced
+   * @param page_size size of every page read or written, in bytes
+   */
+  explicit DiskScheduler(int fd, uint32_t queue_depth = DEFAULT_QUEUE_DEPTH, size_t num_workers = DEFAULT_NUM_WORKERS,
+                         bool use_io_uring = true, bool direct_io = false, size_t page_size = PAGE_SIZE);
+
+  /**
+   * Waits for all outstanding requests and stops the background threads.
+   */
+  ~DiskScheduler();
+
+  DISALLOW_COPY_AND_MOVE(DiskScheduler);
+
+  /**
+   * Schedule a request. Returns as soon as the request has been queued.
+   * @param r the request to be scheduled
+   */
+  void Schedule(DiskRequest r);
+
+  /** @return true if requests are served by io_uring, false if by the pread/pwrite workers */
+  bool IsUsingIoUring() const { return ring_fd_ >= 0; }
+
+  /**
+   * Synchronously serve a request with pread/pwrite. Reads past the end of the file are zero-filled.
+   * @param fd file descriptor of the database file
+   * @param page_id the page to read or write
+   * @param data page-sized buffer
+   * @param is_write true for a write, false for a read
+   * @param direct_io true if fd was opened with O_DIRECT, in which case an unaligned buffer is bounced
+   * @param page_size size of the page in bytes, at most MAX_PAGE_SIZE
+   * @return true on success, false on an I/O error
+   */
+  static bool ExecuteSync(int fd, page_id_t page_id, char *data, bool is_write, bool direct_io = false,
+                          size_t page_size = PAGE_SIZE);
+
+  /** @return true if the buffer can be used for O_DIRECT I/O without bouncing */
+  static bool IsDirectIoAligned(const char *data) {
+    return reinterpret_cast<uintptr_t>(data) % DIRECT_IO_ALIGNMENT == 0;
+  }
+
+ private:
+  /** Frees buffers obtained from std::aligned_alloc. */
+  struct AlignedDeleter {
+    void operator()(char *data) const { std::free(data); }  // NOLINT
+  };
+
+  /** A request while it sits on the io_uring, together with the iovec the kernel reads from. */
+  struct InFlightRequest {
+    DiskRequest request_;
+    iovec iov_;
+    /** Aligned copy of the caller's buffer, only used for O_DIRECT with an unaligned buffer. */
+    std::unique_ptr<char, AlignedDeleter> bounce_;
+  };
+
+  /** Map the io_uring submission and completion rings. @return false if io_uring is unavailable */
+  bool SetupIoUring(uint32_t queue_depth);
+  /** Unmap the rings and close the io_uring. */
+  void TeardownIoUring();
+  /** Push one SQE and tell the kernel about it. Blocks while the ring is full; falls back to pread/pwrite if the
+   * kernel rejects the submission. */
+  void SubmitIoUring(std::unique_ptr<InFlightRequest> request);
+  /** Body of the reaper thread: waits for CQEs and fulfills their promises. */
+  void ReapIoUring();
+  /** Body of a fallback worker thread. */
+  void WorkerLoop();
+
+  /** The database file. */
+  int fd_;
+  /** True if fd_ was opened with O_DIRECT. */
+  bool direct_io_;
+  /** Size of every page read or written. */
+  size_t page_size_;
+
+  /** io_uring file descriptor, -1 when running on the fallback workers. */
+  int ring_fd_{-1};
+  /** Submission ring. */
+  void *sq_ptr_{nullptr};
+  size_t sq_ring_size_{0};
+  unsigned *sq_tail_{nullptr};
+  unsigned *sq_mask_{nullptr};
+  unsigned *sq_array_{nullptr};
+  /** Submission queue entries. */
+  void *sqes_{nullptr};
+  size_t sqes_size_{0};
+  /** Completion ring, may share the mapping of the submission ring. */
+  void *cq_ptr_{nullptr};
+  size_t cq_ring_size_{0};
+  unsigned *cq_head_{nullptr};
+  unsigned *cq_tail_{nullptr};
+  unsigned *cq_mask_{nullptr};
+  void *cqes_{nullptr};
+  /** Number of SQEs, which also bounds the requests in flight. */
+  uint32_t sq_entries_{0};
+
+  /** Protects the submission ring and in_flight_. */
+  std::mutex submit_latch_;
+  /** Signalled whenever a request completes. */
+  std::condition_variable submit_cv_;
+  /** Requests submitted to the kernel but not reaped yet. */
+  uint32_t in_flight_{0};
+  /** Reaper thread for io_uring completions. */
+  std::optional<std::thread> reaper_;
+
+  /** Queue feeding the fallback workers; std::nullopt asks a worker to exit. */
+  Channel<std::optional<DiskRequest>> request_queue_;
+  /** Fallback worker threads. */
+  std::vector<std::thread> workers_;
+};
+
+}  // namespace bustub
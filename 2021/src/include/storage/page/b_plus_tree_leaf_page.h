@@ -19,7 +19,9 @@ namespace bustub {
 
 #define B_PLUS_TREE_LEAF_PAGE_TYPE BPlusTreeLeafPage<KeyType, ValueType, KeyComparator>
 #define LEAF_PAGE_HEADER_SIZE 28
-#define LEAF_PAGE_SIZE ((PAGE_SIZE - LEAF_PAGE_HEADER_SIZE) / sizeof(MappingType))
+// number of entries that fit into a leaf page of the given page size
+#define LEAF_PAGE_CAPACITY(page_size) (((page_size)-LEAF_PAGE_HEADER_SIZE) / sizeof(MappingType))
+#define LEAF_PAGE_SIZE LEAF_PAGE_CAPACITY(PAGE_SIZE)
 
 /**
  * Store indexed key and record id(record id = page id combined with slot id,
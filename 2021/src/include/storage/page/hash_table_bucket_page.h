@@ -33,6 +33,10 @@ namespace bustub {
  *  The above format omits the space required for the occupied_ and
  *  readable_ arrays. More information is in storage/page/hash_table_page_defs.h.
  *
+ *  Next to the flags each slot keeps a one-byte fingerprint of its key. A
+ *  probe compares the fingerprints of 32 slots at a time (AVX2 or SSE2 when
+ *  the CPU has them) and only calls the comparator on the slots that match.
+ *
  */
 template <typename KeyType, typename ValueType, typename KeyComparator>
 class HashTableBucketPage {
@@ -146,10 +150,30 @@ class HashTableBucketPage {
   void Clear();
 
  private:
+  /** Number of slots whose fingerprints and flags are probed together. */
+  static constexpr uint32_t PROBE_BLOCK_SIZE = 32;
+
+  /**
+   * @return the one-byte fingerprint of a key; equal keys have equal bytes, as the hash table assumes for hashing
+   */
+  static uint8_t Fingerprint(const KeyType &key);
+
+  /**
+   * @param block the block of PROBE_BLOCK_SIZE slots starting at block * PROBE_BLOCK_SIZE
+   * @param fingerprint the fingerprint to look for
+   * @return a mask with bit i set if slot block * PROBE_BLOCK_SIZE + i is readable and has the fingerprint
+   */
+  uint32_t MatchFingerprint(uint32_t block, uint8_t fingerprint) const;
+
+  /** @return a mask with bit i set if slot block * PROBE_BLOCK_SIZE + i is readable */
+  uint32_t ReadableMask(uint32_t block) const;
+
   //  For more on BUCKET_ARRAY_SIZE see storage/page/hash_table_page_defs.h
   char occupied_[(BUCKET_ARRAY_SIZE - 1) / 8 + 1];
   // 0 if tombstone/brand new (never occupied), 1 otherwise.
   char readable_[(BUCKET_ARRAY_SIZE - 1) / 8 + 1];
+  // Fingerprint of the key in each readable slot.
+  uint8_t fingerprints_[BUCKET_ARRAY_SIZE];
   MappingType array_[BUCKET_ARRAY_SIZE];
 };
 
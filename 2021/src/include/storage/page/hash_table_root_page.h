@@ -0,0 +1,125 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// hash_table_root_page.h
+//
+// Identification: src/include/storage/page/hash_table_root_page.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <cassert>
+#include <climits>
+#include <cstdlib>
+#include <string>
+
+#include "common/config.h"
+#include "storage/page/hash_table_page_defs.h"
+
+#define MAX_DIRECTORY_DEPTH 9
+
+namespace bustub {
+
+/**
+ *
+ * Root Page for extendible hash table, a directory of directory pages.
+ *
+ * The top MAX_DIRECTORY_DEPTH bits of a key's hash pick one of the root's slots, and the slot names the directory
+ * page that maps the low bits of the hash to a bucket. A table starts out with a single directory that all slots
+ * point to. When a bucket cannot be split because its directory is full, the directory is split in two by the next
+ * top bit of the hash, the same way a bucket is split in the directory: a directory of depth d owns 2^(9 - d)
+ * consecutive slots.
+ *
+ * Root format (size in byte):
+ * --------------------------------------------------------------------------------------------
+ * | LSN (4) | PageId(4) | DirectoryDepths(512) | DirectoryPageIds(2048) | Free(1528)
+ * --------------------------------------------------------------------------------------------
+ */
+class HashTableRootPage {
+ public:
+  /**
+   * Point every slot to the same directory of depth 0.
+   *
+   * @param page_id the page id of this page
+   * @param directory_page_id the page id of the directory
+   */
+  void Init(page_id_t page_id, page_id_t directory_page_id);
+
+  /**
+   * @return the page ID of this page
+   */
+  page_id_t GetPageId() const;
+
+  /**
+   * @return the lsn of this page
+   */
+  lsn_t GetLSN() const;
+
+  /**
+   * Sets the LSN of this page
+   *
+   * @param lsn the log sequence number to which to set the lsn field
+   */
+  void SetLSN(lsn_t lsn);
+
+  /**
+   * @param hash the 32-bit hash of a key
+   * @return the slot the key belongs to
+   */
+  static uint32_t HashToSlot(uint32_t hash) { return hash >> (32 - MAX_DIRECTORY_DEPTH); }
+
+  /**
+   * @param slot the slot to lookup
+   * @return the page_id of the directory the slot points to
+   */
+  page_id_t GetDirectoryPageId(uint32_t slot);
+
+  /**
+   * @param slot the slot to update
+   * @param directory_page_id page_id of the directory
+   */
+  void SetDirectoryPageId(uint32_t slot, page_id_t directory_page_id);
+
+  /**
+   * @param slot the slot to lookup
+   * @return the number of top hash bits the directory at slot is split by
+   */
+  uint32_t GetDirectoryDepth(uint32_t slot);
+
+  /**
+   * @param slot the slot to update
+   * @param depth the number of top hash bits the directory at slot is split by
+   */
+  void SetDirectoryDepth(uint32_t slot, uint8_t depth);
+
+  /**
+   * @param slot a slot of a directory
+   * @return the first of the slots the directory owns
+   */
+  uint32_t GetFirstSlot(uint32_t slot);
+
+  /**
+   * @param slot a slot of a directory
+   * @return the number of slots the directory owns
+   */
+  uint32_t GetNumSlots(uint32_t slot);
+
+  /**
+   * VerifyIntegrity
+   *
+   * Verify that each directory of depth d is pointed to by 2^(9 - d) consecutive slots.
+   */
+  void VerifyIntegrity();
+
+ private:
+  lsn_t lsn_;
+  page_id_t page_id_;
+  uint8_t directory_depths_[ROOT_ARRAY_SIZE];
+  page_id_t directory_page_ids_[ROOT_ARRAY_SIZE];
+};
+
+}  // namespace bustub
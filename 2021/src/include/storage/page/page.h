@@ -12,6 +12,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <cstring>
 #include <iostream>
 
@@ -30,8 +31,8 @@ class Page {
   friend class BufferPoolManagerInstance;
 
  public:
-  /** Constructor. Zeros out the page data. */
-  Page() { ResetMemory(); }
+  /** Constructor. The page has no data until the buffer pool assigns it a frame of its FrameArena. */
+  Page() = default;
 
   /** Default destructor. */
   ~Page() = default;
@@ -39,6 +40,9 @@ class Page {
   /** @return the actual data contained within this page */
   inline char *GetData() { return data_; }
 
+  /** @return the size of the data of this page, the page size of the buffer pool it belongs to */
+  inline size_t GetPageSize() const { return page_size_; }
+
   /** @return the page id of this page */
   inline page_id_t GetPageId() { return page_id_; }
 
@@ -60,6 +64,21 @@ class Page {
   /** Release the page read latch. */
   inline void RUnlatch() { rwlatch_.RUnlock(); }
 
+  /**
+   * Start an optimistic read of the page, which does not write to the latch. Everything read from the page must be
+   * treated as possibly torn until ValidateOptimisticRLatch succeeded; on failure, fall back to RLatch.
+   * @param[out] version the version to be passed to ValidateOptimisticRLatch
+   * @return false if the page is write latched right now
+   */
+  inline bool TryOptimisticRLatch(uint64_t *version) const { return rwlatch_.TryOptimisticRead(version); }
+
+  /**
+   * Finish an optimistic read of the page.
+   * @param version the version returned by TryOptimisticRLatch
+   * @return true if the page was not write latched since TryOptimisticRLatch
+   */
+  inline bool ValidateOptimisticRLatch(uint64_t version) const { return rwlatch_.ValidateRead(version); }
+
   /** @return the page LSN. */
   inline lsn_t GetLSN() { return *reinterpret_cast<lsn_t *>(GetData() + OFFSET_LSN); }
 
@@ -76,18 +95,23 @@ class Page {
 
  private:
   /** Zeroes out the data that is held within the page. */
-  inline void ResetMemory() { memset(data_, OFFSET_PAGE_START, PAGE_SIZE); }
-
-  /** The actual data that is stored within a page. */
-  char data_[PAGE_SIZE]{};
+  inline void ResetMemory() { memset(data_, OFFSET_PAGE_START, page_size_); }
+
+  /**
+   * The actual data that is stored within a page. It lives in the FrameArena of the buffer pool, apart from this
+   * metadata, and is aligned so that it can be handed to O_DIRECT I/O as is.
+   */
+  char *data_{nullptr};
+  /** The size of data_. */
+  size_t page_size_{PAGE_SIZE};
   /** The ID of this page. */
   page_id_t page_id_ = INVALID_PAGE_ID;
-  /** The pin count of this page. */
-  int pin_count_ = 0;
+  /** The pin count of this page. Updated atomically so that buffer pool hits do not need an exclusive latch. */
+  std::atomic<int> pin_count_ = 0;
   /** True if the page is dirty, i.e. it is different from its corresponding page on disk. */
-  bool is_dirty_ = false;
-  /** Page latch. */
-  ReaderWriterLatch rwlatch_;
+  std::atomic<bool> is_dirty_ = false;
+  /** Page latch, versioned so that readers may also read optimistically. */
+  VersionedLatch rwlatch_;
 };
 
 }  // namespace bustub
@@ -40,6 +40,10 @@ namespace bustub {
  *  | TupleCount (4) | Tuple_1 offset (4) | Tuple_1 size (4) | ... |
  *  ----------------------------------------------------------------
  *
+ *  The top bits of a tuple size are flags. Besides the deleted flag, a slot may hold a forwarding stub instead of a
+ *  tuple: the RID (page id, slot number) of the slot the tuple was moved to when it outgrew its page. The tuple keeps
+ *  its RID; the slot it was moved to is flagged as moved, so that scans skip it and only reach it through the stub.
+ *
  */
 class TablePage : public Page {
  public:
@@ -106,14 +110,42 @@ class TablePage : public Page {
   bool UpdateTuple(const Tuple &new_tuple, Tuple *old_tuple, const RID &rid, Transaction *txn,
                    LockManager *lock_manager, LogManager *log_manager);
 
-  /** To be called on commit or abort. Actually perform the delete or rollback an insert. */
+  /**
+   * @param rid rid of the slot
+   * @param[out] forward_rid the rid of the slot the tuple was moved to
+   * @return true if the slot holds a forwarding stub, deleted or not
+   */
+  bool GetForwardRid(const RID &rid, RID *forward_rid);
+
+  /**
+   * Replace the tuple in a slot with a forwarding stub, or point an existing stub elsewhere.
+   * @param rid rid of the slot
+   * @param forward_rid the rid of the slot the tuple was moved to
+   * @return false if the slot is invalid or empty, or the stub does not fit into the page
+   */
+  bool SetForwardRid(const RID &rid, const RID &forward_rid);
+
+  /** Flag a tuple just inserted as moved here from the home slot of its RID, which hides it from scans. */
+  void SetMoved(const RID &rid);
+
+  /**
+   * Defragment the page: pack the tuples against the end of the page and drop the empty slots at the end of the slot
+   * array. The slots of the remaining tuples, and thus their RIDs, do not change.
+   * @return the number of bytes of free space gained
+   */
+  uint32_t Compact();
+
+  /**
+   * To be called on commit or abort. Actually perform the delete or rollback an insert. A moved tuple is deleted by
+   * the table heap together with its forwarding stub, so no lock on the rid of the moved tuple is required.
+   */
   void ApplyDelete(const RID &rid, Transaction *txn, LogManager *log_manager);
 
   /** To be called on abort. Rollback a delete, i.e. this reverses a MarkDelete. */
   void RollbackDelete(const RID &rid, Transaction *txn, LogManager *log_manager);
 
   /**
-   * Read a tuple from a table.
+   * Read a tuple from a table. A forwarding stub is read like a tuple; see GetForwardRid.
    * @param rid rid of the tuple to read
    * @param[out] tuple the tuple that was read
    * @param txn transaction performing the read
@@ -122,6 +154,17 @@ class TablePage : public Page {
    */
   bool GetTuple(const RID &rid, Tuple *tuple, Transaction *txn, LockManager *lock_manager);
 
+  /**
+   * Read a tuple from a table without copying it: the tuple points into this page and is only valid while the page
+   * stays pinned and latched.
+   * @param rid rid of the tuple to read
+   * @param[out] tuple the tuple that was read, not owning its data
+   * @param txn transaction performing the read
+   * @param lock_manager the lock manager
+   * @return true if the read is successful (i.e. the tuple exists)
+   */
+  bool ViewTuple(const RID &rid, Tuple *tuple, Transaction *txn, LockManager *lock_manager);
+
   /** @return the rid of the first tuple in this page */
 
   /**
@@ -137,6 +180,14 @@ class TablePage : public Page {
    */
   bool GetNextTupleRid(const RID &cur_rid, RID *next_rid);
 
+  /** @return the number of free bytes between the slot array and the tuples */
+  uint32_t GetFreeSpaceRemaining() {
+    return GetFreeSpacePointer() - SIZE_TABLE_PAGE_HEADER - SIZE_TUPLE * GetTupleCount();
+  }
+
+  /** @return the free space InsertTuple requires for a tuple of the given size, including its slot */
+  static uint32_t GetSpaceNeeded(uint32_t tuple_size) { return tuple_size + SIZE_TUPLE; }
+
  private:
   static_assert(sizeof(page_id_t) == 4);
 
@@ -148,6 +199,12 @@ class TablePage : public Page {
   static constexpr size_t OFFSET_TUPLE_COUNT = 20;
   static constexpr size_t OFFSET_TUPLE_OFFSET = 24;  // Naming things is hard.
   static constexpr size_t OFFSET_TUPLE_SIZE = 28;
+  /** Flag of a slot holding a forwarding stub. */
+  static constexpr uint32_t FORWARD_FLAG = 1U << 30;
+  /** Flag of a slot holding a tuple moved here from the home slot of its RID. */
+  static constexpr uint32_t MOVED_FLAG = 1U << 29;
+  /** Size of a forwarding stub: page id and slot number. */
+  static constexpr uint32_t SIZE_FORWARD_RID = 8;
 
   /** @return pointer to the end of the current free space, see header comment */
   uint32_t GetFreeSpacePointer() { return *reinterpret_cast<uint32_t *>(GetData() + OFFSET_FREE_SPACE); }
@@ -166,10 +223,6 @@ class TablePage : public Page {
   /** Set the number of tuples in this page. */
   void SetTupleCount(uint32_t tuple_count) { memcpy(GetData() + OFFSET_TUPLE_COUNT, &tuple_count, sizeof(uint32_t)); }
 
-  uint32_t GetFreeSpaceRemaining() {
-    return GetFreeSpacePointer() - SIZE_TABLE_PAGE_HEADER - SIZE_TUPLE * GetTupleCount();
-  }
-
   /** @return tuple offset at slot slot_num */
   uint32_t GetTupleOffsetAtSlot(uint32_t slot_num) {
     return *reinterpret_cast<uint32_t *>(GetData() + OFFSET_TUPLE_OFFSET + SIZE_TUPLE * slot_num);
@@ -190,6 +243,18 @@ class TablePage : public Page {
     memcpy(GetData() + OFFSET_TUPLE_SIZE + SIZE_TUPLE * slot_num, &size, sizeof(uint32_t));
   }
 
+  /** @return the length in bytes of a tuple, without the flags */
+  static uint32_t GetLength(uint32_t tuple_size) { return tuple_size & (MOVED_FLAG - 1); }
+
+  /** @return true if a scan should return the tuple in this slot */
+  static bool IsVisible(uint32_t tuple_size) { return !IsDeleted(tuple_size) && (tuple_size & MOVED_FLAG) == 0; }
+
+  /**
+   * Grow or shrink the tuple in a slot, moving the tuples in front of it. The flags of the slot are kept.
+   * @return the new offset of the tuple
+   */
+  uint32_t ResizeTuple(uint32_t slot_num, uint32_t new_length);
+
   /** @return true if the tuple is deleted or empty */
   static bool IsDeleted(uint32_t tuple_size) { return static_cast<bool>(tuple_size & DELETE_MASK) || tuple_size == 0; }
 
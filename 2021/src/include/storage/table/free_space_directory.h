@@ -0,0 +1,87 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// free_space_directory.h
+//
+// Identification: src/include/storage/table/free_space_directory.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <mutex>  // NOLINT
+#include <unordered_map>
+#include <vector>
+
+#include "common/config.h"
+
+namespace bustub {
+
+/**
+ * FreeSpaceDirectory remembers how much free space every page of a table heap has, so that an insert can go straight
+ * to a page with room instead of walking the page chain.
+ *
+ * Pages are grouped into NUM_CLASSES size classes of page_size / NUM_CLASSES bytes each. Every page of a class has at
+ * least as much free space as the lower bound of the class, so FindPage only needs to look at the first non-empty
+ * class whose lower bound covers the request. The directory lives in memory only and is rebuilt by its table heap.
+ */
+class FreeSpaceDirectory {
+ public:
+  /** Number of size classes, one bit each in the mask of non-empty classes. */
+  static constexpr uint32_t NUM_CLASSES = 64;
+
+  /**
+   * Creates an empty directory.
+   * @param page_size size of the pages of the table heap
+   */
+  explicit FreeSpaceDirectory(size_t page_size);
+
+  /**
+   * Record the free space of a page, adding the page if the directory does not know it yet.
+   * @param page_id id of the page
+   * @param free_space number of free bytes in the page
+   */
+  void Update(page_id_t page_id, uint32_t free_space);
+
+  /**
+   * Find a page with at least the given number of free bytes. The page with the least free space that is guaranteed
+   * to fit is preferred, which keeps the pages of the table full.
+   * @param size number of bytes needed
+   * @return the id of the page, or INVALID_PAGE_ID if no page known to the directory is guaranteed to fit
+   */
+  page_id_t FindPage(uint32_t size);
+
+  /** @return the free space last recorded for a page, 0 if the page is unknown */
+  uint32_t GetFreeSpace(page_id_t page_id);
+
+  /** @return the number of pages in the directory */
+  size_t GetNumPages();
+
+ private:
+  /** Where a page sits in the directory. */
+  struct Entry {
+    uint32_t free_space_;
+    uint32_t class_;
+    /** Position of the page in the vector of its class. */
+    size_t index_;
+  };
+
+  /** @return the size class of a page with the given free space */
+  uint32_t ClassOf(uint32_t free_space) const;
+  /** Take a page out of the vector of its class. Requires latch_. */
+  void RemoveFromClass(const Entry &entry);
+
+  size_t page_size_;
+  std::mutex latch_;
+  std::unordered_map<page_id_t, Entry> pages_;
+  std::array<std::vector<page_id_t>, NUM_CLASSES> classes_;
+  /** Bit c is set if classes_[c] is not empty. */
+  uint64_t non_empty_classes_{0};
+};
+
+}  // namespace bustub
@@ -12,17 +12,25 @@
 
 #pragma once
 
+#include <atomic>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <vector>
+
 #include "buffer/buffer_pool_manager.h"
 #include "recovery/log_manager.h"
 #include "storage/page/table_page.h"
+#include "storage/table/free_space_directory.h"
 #include "storage/table/table_iterator.h"
 #include "storage/table/tuple.h"
+#include "storage/table/tuple_view.h"
 
 namespace bustub {
 
 /**
  * TableHeap represents a physical table on disk.
- * This is just a doubly-linked list of pages.
+ * This is just a doubly-linked list of pages. A free-space directory next to it tells inserts which page has room, so
+ * they do not walk the list.
  */
 class TableHeap {
   friend class TableIterator;
@@ -52,12 +60,27 @@ class TableHeap {
 
   /**
    * Insert a tuple into the table. If the tuple is too large (>= page_size), return false.
+   * The tuple goes to a page the free-space directory knows to have room, or else to the last page, or else to a page
+   * appended to the table.
    * @param tuple tuple to insert
    * @param[out] rid the rid of the inserted tuple
    * @param txn the transaction performing the insert
+   * @param strategy if not nullptr, pages appended to the table are created in this bulk operation's ring of frames
    * @return true iff the insert is successful
    */
-  bool InsertTuple(const Tuple &tuple, RID *rid, Transaction *txn);
+  bool InsertTuple(const Tuple &tuple, RID *rid, Transaction *txn, BufferAccessStrategy *strategy = nullptr);
+
+  /**
+   * Insert a batch of tuples into the table. Each page is filled with as many of the tuples, in order, as fit while it
+   * is pinned and latched once. If a tuple is too large (>= page_size), nothing is inserted and false is returned.
+   * @param tuples tuples to insert
+   * @param[out] rids the rids of the inserted tuples, in the order of the tuples
+   * @param txn the transaction performing the insert
+   * @param strategy if not nullptr, pages appended to the table are created in this bulk operation's ring of frames
+   * @return true iff all tuples were inserted; if not, the transaction is aborted and rolls back the inserted ones
+   */
+  bool InsertTuples(const std::vector<Tuple> &tuples, std::vector<RID> *rids, Transaction *txn,
+                    BufferAccessStrategy *strategy = nullptr);
 
   /**
    * Mark the tuple as deleted. The actual delete will occur when ApplyDelete is called.
@@ -68,7 +91,9 @@ class TableHeap {
   bool MarkDelete(const RID &rid, Transaction *txn);  // for delete
 
   /**
-   * if the new tuple is too large to fit in the old page, return false (will delete and insert)
+   * Update a tuple in place. If the new tuple does not fit into its page even after the page is compacted, it is moved
+   * to another page and a forwarding stub is left in its slot, so that its RID stays valid.
+   * If the new tuple is too large to fit in any page, return false (will delete and insert)
    * @param tuple new tuple
    * @param rid rid of the old tuple
    * @param txn transaction performing the update
@@ -99,6 +124,17 @@ class TableHeap {
    */
   bool GetTuple(const RID &rid, Tuple *tuple, Transaction *txn);
 
+  /**
+   * Read a tuple in place, without copying it out of its page. The view keeps the page pinned and read-latched until
+   * it is released, so release it before taking locks or reading other tuples that may be on the same page.
+   * @param rid rid of the tuple to read
+   * @param[out] view the view of the tuple; whatever it viewed before is released
+   * @param txn transaction performing the read
+   * @param strategy if not nullptr, a page missed is read into this scan's ring of frames
+   * @return true if the read was successful (i.e. the tuple exists)
+   */
+  bool GetTupleView(const RID &rid, TupleView *view, Transaction *txn, BufferAccessStrategy *strategy = nullptr);
+
   /** @return the begin iterator of this table */
   TableIterator Begin(Transaction *txn);
 
@@ -108,11 +144,57 @@ class TableHeap {
   /** @return the id of the first page of this table */
   inline page_id_t GetFirstPageId() const { return first_page_id_; }
 
+  /** @return the free-space directory of this table, built by walking the page list the first time */
+  FreeSpaceDirectory *GetFreeSpaceDirectory();
+
  private:
+  /**
+   * Insert num_tuples tuples, the single and the batched insert share this.
+   * @param is_moved true if the tuples are moved out of their home page by an update; they are flagged as moved and
+   * get no write record, as they belong to the forwarding stub in their home slot
+   */
+  bool InsertTuples(const Tuple *tuples, size_t num_tuples, RID *rids, Transaction *txn,
+                    BufferAccessStrategy *strategy, bool is_moved);
+
+  /**
+   * Insert tuples into a latched page, starting at *next_tuple, until one does not fit. The inserted tuples are added
+   * to the write set of the transaction and the free space of the page is recorded.
+   * @return the number of tuples inserted
+   */
+  size_t FillPage(TablePage *page, const Tuple *tuples, size_t num_tuples, RID *rids, size_t *next_tuple,
+                  Transaction *txn, bool is_moved);
+
+  /** Update a tuple in a latched page, compacting the page if the new tuple does not fit otherwise. */
+  bool UpdateInPage(TablePage *page, const Tuple &tuple, Tuple *old_tuple, const RID &rid, Transaction *txn);
+
+  /** Update a tuple whose home slot at rid holds a forwarding stub to forward_rid. */
+  bool UpdateForwardedTuple(const Tuple &tuple, Tuple *old_tuple, const RID &rid, const RID &forward_rid,
+                            Transaction *txn);
+
+  /**
+   * Move the new value of a tuple to another page and point the home slot at rid to it.
+   * @param old_forward_rid where the tuple was moved to before, removed once the stub points to the new place; an
+   * invalid RID if the tuple is still in its home slot
+   * @return false if the stub does not fit into the home page, in which case nothing changed
+   */
+  bool MoveTuple(const Tuple &tuple, const RID &rid, const RID &old_forward_rid, Transaction *txn);
+
+  /** Physically delete a tuple that was moved out of its home page. */
+  void RemoveMovedTuple(const RID &moved_rid, Transaction *txn);
+
+  /** Record the free space of a page after a tuple was inserted, deleted or updated. Requires the page latch. */
+  void UpdateFreeSpace(TablePage *page) {
+    GetFreeSpaceDirectory()->Update(page->GetTablePageId(), page->GetFreeSpaceRemaining());
+  }
+
   BufferPoolManager *buffer_pool_manager_;
   LockManager *lock_manager_;
   LogManager *log_manager_;
   page_id_t first_page_id_{};
+  /** The last page of the list as far as we know; appenders follow the next page ids from here. */
+  std::atomic<page_id_t> last_page_id_{INVALID_PAGE_ID};
+  std::once_flag free_space_once_;
+  std::unique_ptr<FreeSpaceDirectory> free_space_;
 };
 
 }  // namespace bustub
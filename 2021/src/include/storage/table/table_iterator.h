@@ -13,10 +13,13 @@
 #pragma once
 
 #include <cassert>
+#include <memory>
 
+#include "buffer/buffer_access_strategy.h"
 #include "common/rid.h"
 #include "concurrency/transaction.h"
 #include "storage/table/tuple.h"
+#include "storage/table/tuple_view.h"
 
 namespace bustub {
 
@@ -24,15 +27,31 @@ class TableHeap;
 
 /**
  * TableIterator enables the sequential scan of a TableHeap.
+ * The tuple under the iterator is only copied out of its page when it is dereferenced; a scan that reads it through
+ * GetTupleView instead never copies it.
  */
 class TableIterator {
   friend class Cursor;
 
  public:
-  TableIterator(TableHeap *table_heap, RID rid, Transaction *txn);
+  /**
+   * Create an iterator positioned at rid.
+   * @param table_heap the table being scanned
+   * @param rid the tuple the iterator points to, RID(INVALID_PAGE_ID, 0) for the end iterator
+   * @param txn the transaction performing the scan
+   * @param strategy the ring of frames that pages missed by the scan are read into, nullptr to use the whole pool
+   */
+  TableIterator(TableHeap *table_heap, RID rid, Transaction *txn,
+                std::shared_ptr<BufferAccessStrategy> strategy = nullptr);
 
   TableIterator(const TableIterator &other)
-      : table_heap_(other.table_heap_), tuple_(new Tuple(*other.tuple_)), txn_(other.txn_) {}
+      : table_heap_(other.table_heap_),
+        tuple_(new Tuple(*other.tuple_)),
+        loaded_(other.loaded_),
+        txn_(other.txn_),
+        strategy_(other.strategy_),
+        prefetch_frontier_(other.prefetch_frontier_),
+        prefetch_ahead_(other.prefetch_ahead_) {}
 
   ~TableIterator() { delete tuple_; }
 
@@ -48,17 +67,47 @@ class TableIterator {
 
   TableIterator operator++(int);
 
+  /** @return the rid of the tuple the iterator points to */
+  const RID &GetRid() const { return tuple_->rid_; }
+
+  /**
+   * Read the tuple the iterator points to in place, see TableHeap::GetTupleView.
+   * @param[out] view the view of the tuple
+   * @return true if the read was successful
+   */
+  bool GetTupleView(TupleView *view);
+
   TableIterator &operator=(const TableIterator &other) {
     table_heap_ = other.table_heap_;
     *tuple_ = *other.tuple_;
+    loaded_ = other.loaded_;
     txn_ = other.txn_;
+    strategy_ = other.strategy_;
+    prefetch_frontier_ = other.prefetch_frontier_;
+    prefetch_ahead_ = other.prefetch_ahead_;
     return *this;
   }
 
  private:
+  /**
+   * Keep up to SCAN_PREFETCH_DEPTH pages of the page chain in flight ahead of the scan, so that the scan overlaps
+   * disk reads with tuple processing instead of stalling on every page miss.
+   * @param next_page_id the page following the page the iterator is currently on
+   * @param pages_advanced how many pages the iterator moved forward since the last call
+   */
+  void ReadAhead(page_id_t next_page_id, int pages_advanced);
+
   TableHeap *table_heap_;
   Tuple *tuple_;
+  /** True if tuple_ holds the data of the tuple at its rid, not just the rid. */
+  bool loaded_{false};
   Transaction *txn_;
+  /** Ring of frames shared by all copies of the iterator, so that a scan recycles its own frames. */
+  std::shared_ptr<BufferAccessStrategy> strategy_;
+  /** The furthest page of the chain that has been handed to PrefetchPage. */
+  page_id_t prefetch_frontier_{INVALID_PAGE_ID};
+  /** How many pages between the current page and prefetch_frontier_ (inclusive) have been read ahead. */
+  int prefetch_ahead_{0};
 };
 
 }  // namespace bustub
@@ -0,0 +1,71 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// tuple_view.h
+//
+// Identification: src/include/storage/table/tuple_view.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <utility>
+
+#include "buffer/buffer_pool_manager.h"
+#include "common/macros.h"
+#include "storage/page/page.h"
+#include "storage/table/tuple.h"
+
+namespace bustub {
+
+/**
+ * TupleView reads a tuple in place in its table page, without copying it out.
+ *
+ * The view holds a pin and the read latch of the page for as long as it lives, so it is meant to be short-lived:
+ * evaluate predicates and projections on GetTuple(), then let the view go before blocking on anything else. Only
+ * Materialize copies the tuple, for when it has to outlive the view.
+ */
+class TupleView {
+ public:
+  /** Creates an empty view. */
+  TupleView() = default;
+
+  /**
+   * Creates a view of a tuple in a page, taking over a pin and the read latch of the page.
+   * @param buffer_pool_manager the buffer pool manager the page is pinned in
+   * @param page the pinned and read-latched page
+   * @param tuple the tuple, pointing into the page
+   */
+  TupleView(BufferPoolManager *buffer_pool_manager, Page *page, const Tuple &tuple)
+      : buffer_pool_manager_(buffer_pool_manager), page_(page), tuple_(tuple) {}
+
+  TupleView(TupleView &&other) noexcept { *this = std::move(other); }
+
+  TupleView &operator=(TupleView &&other) noexcept;
+
+  DISALLOW_COPY(TupleView);
+
+  ~TupleView() { Release(); }
+
+  /** @return true if the view points to a tuple */
+  bool IsValid() const { return page_ != nullptr; }
+
+  /** @return the tuple, valid until the view is released; copies of it do not copy its data */
+  const Tuple &GetTuple() const { return tuple_; }
+
+  /** @return a copy of the tuple that owns its data */
+  Tuple Materialize() const;
+
+  /** Unlatch and unpin the page. The view is empty afterwards. */
+  void Release();
+
+ private:
+  BufferPoolManager *buffer_pool_manager_{nullptr};
+  Page *page_{nullptr};
+  Tuple tuple_;
+};
+
+}  // namespace bustub
@@ -10,16 +10,18 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <fcntl.h>
 #include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
 #include <cassert>
 #include <cstring>
 #include <iostream>
-#include <mutex>  // NOLINT
 #include <string>
-#include <thread>  // NOLINT
 
 #include "common/exception.h"
 #include "common/logger.h"
+#include "common/util/crc32c.h"
 #include "storage/disk/disk_manager.h"
 
 namespace bustub {
@@ -29,9 +31,22 @@ static char *buffer_used;
 /**
  * Constructor: open/create a single database file & log file
  * @input db_file: database file name
+ * @input use_direct_io: bypass the OS page cache for the database file
+ * @input page_checksums: checksum pages in a .crc file next to the database file
+ * @input page_size: size of every page in the database file
  */
-DiskManager::DiskManager(const std::string &db_file)
-    : file_name_(db_file), num_flushes_(0), num_writes_(0), flush_log_(false), flush_log_f_(nullptr) {
+DiskManager::DiskManager(const std::string &db_file, bool use_direct_io, bool page_checksums, size_t page_size)
+    : file_name_(db_file),
+      num_flushes_(0),
+      num_writes_(0),
+      flush_log_(false),
+      flush_log_f_(nullptr),
+      page_size_(page_size) {
+  // 页大小是2的幂，才能和O_DIRECT以及大页对齐
+  if (page_size_ < static_cast<size_t>(PAGE_SIZE) || page_size_ > static_cast<size_t>(MAX_PAGE_SIZE) ||
+      (page_size_ & (page_size_ - 1)) != 0) {
+    throw Exception("page size must be a power of two between PAGE_SIZE and MAX_PAGE_SIZE");
+  }
   std::string::size_type n = file_name_.rfind('.');
   if (n == std::string::npos) {
     LOG_DEBUG("wrong file format");
@@ -53,80 +68,107 @@ DiskManager::DiskManager(const std::string &db_file)
     }
   }
 
-  std::scoped_lock scoped_db_io_latch(db_io_latch_);
-  db_io_.open(db_file, std::ios::binary | std::ios::in | std::ios::out);
-  // directory or file does not exist
-  if (!db_io_.is_open()) {
-    db_io_.clear();
-    // create a new file
-    db_io_.open(db_file, std::ios::binary | std::ios::trunc | std::ios::out);
-    db_io_.close();
-    // reopen with original mode
-    db_io_.open(db_file, std::ios::binary | std::ios::in | std::ios::out);
-    if (!db_io_.is_open()) {
-      throw Exception("can't open db file");
+  int flags = O_RDWR | O_CREAT;
+  if (use_direct_io) {
+    db_fd_ = open(db_file.c_str(), flags | O_DIRECT, 0644);
+    if (db_fd_ >= 0) {
+      direct_io_ = true;
+    } else {
+      // e.g. tmpfs does not support O_DIRECT
+      LOG_DEBUG("O_DIRECT not supported for %s, falling back to buffered I/O", db_file.c_str());
     }
   }
+  if (db_fd_ < 0) {
+    db_fd_ = open(db_file.c_str(), flags, 0644);
+  }
+  // directory does not exist
+  if (db_fd_ < 0) {
+    throw Exception("can't open db file");
+  }
+  struct stat stat_buf;
+  db_file_size_ = fstat(db_fd_, &stat_buf) == 0 ? static_cast<int64_t>(stat_buf.st_size) : 0;
   buffer_used = nullptr;
+
+  if (page_checksums) {
+    OpenChecksumFile(file_name_.substr(0, n) + ".crc");
+  }
+  free_map_name_ = file_name_.substr(0, n) + ".fsm";
+  OpenFreeMapFile();
 }
 
 /**
  * Close all file streams
  */
 void DiskManager::ShutDown() {
-  {
-    std::scoped_lock scoped_db_io_latch(db_io_latch_);
-    db_io_.close();
+  // wait for outstanding asynchronous requests before closing the file
+  disk_scheduler_.reset();
+  if (db_fd_ >= 0) {
+    close(db_fd_);
+    db_fd_ = -1;
+  }
+  if (checksum_fd_ >= 0) {
+    close(checksum_fd_);
+    checksum_fd_ = -1;
+  }
+  if (free_map_fd_ >= 0) {
+    close(free_map_fd_);
+    free_map_fd_ = -1;
   }
   log_io_.close();
 }
 
 /**
  * Write the contents of the specified page into disk file
+ * Positional write, so concurrent callers need no shared cursor or latch
  */
 void DiskManager::WritePage(page_id_t page_id, const char *page_data) {
-  std::scoped_lock scoped_db_io_latch(db_io_latch_);
-  size_t offset = static_cast<size_t>(page_id) * PAGE_SIZE;
-  // set write cursor to offset
   num_writes_ += 1;
-  db_io_.seekp(offset);
-  db_io_.write(page_data, PAGE_SIZE);
-  // check for I/O error
-  if (db_io_.bad()) {
+  StampChecksum(page_id, page_data);
+  ExtendFileSize(page_id);
+  if (!DiskScheduler::ExecuteSync(db_fd_, page_id, const_cast<char *>(page_data), true, direct_io_, page_size_)) {
     LOG_DEBUG("I/O error while writing");
-    return;
   }
-  // needs to flush to keep disk file in sync
-  db_io_.flush();
 }
 
 /**
  * Read the contents of the specified page into the given memory area
+ * Pages past the end of the file read back as zeros, which only passes verification if the page was never stamped
  */
-void DiskManager::ReadPage(page_id_t page_id, char *page_data) {
-  std::scoped_lock scoped_db_io_latch(db_io_latch_);
-  int offset = page_id * PAGE_SIZE;
-  // check if read beyond file length
-  if (offset > GetFileSize(file_name_)) {
+bool DiskManager::ReadPage(page_id_t page_id, char *page_data, bool verify_checksum) {
+  num_reads_ += 1;
+  int64_t offset = static_cast<int64_t>(page_id) * page_size_;
+  // check if read beyond file length, using the cached size instead of a stat per read
+  if (offset >= db_file_size_.load()) {
     LOG_DEBUG("I/O error reading past end of file");
-    // std::cerr << "I/O error while reading" << std::endl;
-  } else {
-    // set read cursor to offset
-    db_io_.seekp(offset);
-    db_io_.read(page_data, PAGE_SIZE);
-    if (db_io_.bad()) {
-      LOG_DEBUG("I/O error while reading");
-      return;
-    }
-    // if file ends before reading PAGE_SIZE
-    int read_count = db_io_.gcount();
-    if (read_count < PAGE_SIZE) {
-      LOG_DEBUG("Read less than a page");
-      db_io_.clear();
-      // std::cerr << "Read less than a page" << std::endl;
-      memset(page_data + read_count, 0, PAGE_SIZE - read_count);
-    }
+    memset(page_data, 0, page_size_);
+  } else if (!DiskScheduler::ExecuteSync(db_fd_, page_id, page_data, false, direct_io_, page_size_)) {
+    LOG_DEBUG("I/O error while reading");
   }
+  return !verify_checksum || VerifyChecksum(page_id, page_data);
+}
+
+/**
+ * Hand a page write to the disk scheduler and return immediately
+ */
+std::future<bool> DiskManager::WritePageAsync(page_id_t page_id, const char *page_data) {
+  num_writes_ += 1;
+  StampChecksum(page_id, page_data);
+  ExtendFileSize(page_id);
+  DiskRequest r{true, const_cast<char *>(page_data), page_id, std::promise<bool>()};
+  std::future<bool> future = r.callback_.get_future();
+  GetDiskScheduler()->Schedule(std::move(r));
+  return future;
+}
+
+/**
+ * Hand a page read to the disk scheduler and return immediately
+ */
+std::future<bool> DiskManager::ReadPageAsync(page_id_t page_id, char *page_data) {
+  num_reads_ += 1;
+  DiskRequest r{false, page_data, page_id, std::promise<bool>()};
+  std::future<bool> future = r.callback_.get_future();
+  GetDiskScheduler()->Schedule(std::move(r));
+  return future;
 }
 
 /**
@@ -201,6 +243,11 @@ int DiskManager::GetNumFlushes() const { return num_flushes_; }
  */
 int DiskManager::GetNumWrites() const { return num_writes_; }
 
+/**
+ * Returns number of Reads made so far
+ */
+int DiskManager::GetNumReads() const { return num_reads_; }
+
 /**
  * Returns true if the log is currently being flushed
  */
@@ -215,4 +262,272 @@ int DiskManager::GetFileSize(const std::string &file_name) {
   return rc == 0 ? static_cast<int>(stat_buf.st_size) : -1;
 }
 
+/**
+ * Private helper function to grow the cached file size so that it covers the given page
+ */
+void DiskManager::ExtendFileSize(page_id_t page_id) {
+  int64_t end = (static_cast<int64_t>(page_id) + 1) * page_size_;
+  if (db_file_size_.load() >= end) {
+    return;
+  }
+  // 和Truncate互斥，否则它可能按旧的大小把刚追加的页截掉
+  std::shared_lock<std::shared_mutex> guard(file_size_latch_);
+  int64_t size = db_file_size_.load();
+  while (size < end && !db_file_size_.compare_exchange_weak(size, end)) {
+  }
+}
+
+/**
+ * Compare the checksum of a page read from disk with the one it was written with
+ */
+bool DiskManager::VerifyChecksum(page_id_t page_id, const char *page_data) {
+  if (checksum_fd_ < 0) {
+    return true;
+  }
+  uint32_t expected = 0;
+  {
+    std::lock_guard<std::mutex> guard(checksum_latch_);
+    if (static_cast<size_t>(page_id) < checksums_.size()) {
+      expected = checksums_[page_id];
+    }
+  }
+  if (expected == 0) {
+    return true;
+  }
+  // 用页编号做种子，页写错了位置也能发现
+  uint32_t actual = Crc32cUtil::Extend(static_cast<uint32_t>(page_id), page_data, page_size_);
+  if (actual != expected) {
+    num_checksum_failures_ += 1;
+    LOG_WARN("checksum mismatch on page %d: expected %08x, found %08x", page_id, expected, actual);
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Private helper function to open the checksum file and load it into memory
+ */
+void DiskManager::OpenChecksumFile(const std::string &checksum_file) {
+  checksum_fd_ = open(checksum_file.c_str(), O_RDWR | O_CREAT, 0644);
+  if (checksum_fd_ < 0) {
+    throw Exception("can't open checksum file");
+  }
+  // 数据库文件是新建的，旧的校验和作废
+  if (db_file_size_.load() == 0) {
+    if (ftruncate(checksum_fd_, 0) != 0) {
+      LOG_DEBUG("I/O error while truncating checksum file");
+    }
+    return;
+  }
+  struct stat stat_buf;
+  if (fstat(checksum_fd_, &stat_buf) != 0) {
+    return;
+  }
+  checksums_.resize(stat_buf.st_size / sizeof(uint32_t));
+  auto size = static_cast<ssize_t>(checksums_.size() * sizeof(uint32_t));
+  if (pread(checksum_fd_, checksums_.data(), size, 0) != size) {
+    LOG_DEBUG("I/O error while reading checksum file");
+    checksums_.clear();
+  }
+}
+
+/**
+ * Private helper function to checksum a page before it is written
+ * The checksum is recorded before the page is written, so that a crash in between shows up as a mismatch
+ */
+void DiskManager::StampChecksum(page_id_t page_id, const char *page_data) {
+  if (checksum_fd_ < 0) {
+    return;
+  }
+  uint32_t crc = Crc32cUtil::Extend(static_cast<uint32_t>(page_id), page_data, page_size_);
+  // 0表示没有校验和，碰上了就只能放弃这一页的校验
+  {
+    std::lock_guard<std::mutex> guard(checksum_latch_);
+    if (static_cast<size_t>(page_id) >= checksums_.size()) {
+      checksums_.resize(page_id + 1, 0);
+    }
+    checksums_[page_id] = crc;
+  }
+  if (pwrite(checksum_fd_, &crc, sizeof(crc), static_cast<off_t>(page_id) * sizeof(uint32_t)) != sizeof(crc)) {
+    LOG_DEBUG("I/O error while writing checksum");
+  }
+}
+
+/**
+ * Mark a page free and give its disk space back to the file system
+ */
+void DiskManager::DeallocatePage(page_id_t page_id) {
+  assert(page_id >= 0);
+  {
+    std::lock_guard<std::mutex> guard(free_map_latch_);
+    if (free_map_fd_ < 0 && !free_map_name_.empty()) {
+      free_map_fd_ = open(free_map_name_.c_str(), O_RDWR | O_CREAT, 0644);
+      if (free_map_fd_ < 0) {
+        LOG_DEBUG("can't open free-page map file");
+      }
+    }
+    SetFree(page_id, true);
+  }
+  // 旧内容作废，校验和清零，以免重新分配后读回来的旧页或者空洞校验不过
+  if (checksum_fd_ >= 0) {
+    uint32_t crc = 0;
+    {
+      std::lock_guard<std::mutex> guard(checksum_latch_);
+      if (static_cast<size_t>(page_id) < checksums_.size()) {
+        checksums_[page_id] = 0;
+      }
+    }
+    if (pwrite(checksum_fd_, &crc, sizeof(crc), static_cast<off_t>(page_id) * sizeof(uint32_t)) != sizeof(crc)) {
+      LOG_DEBUG("I/O error while writing checksum");
+    }
+  }
+  // 打洞失败（文件系统不支持）不影响正确性，只是空间要等Truncate或者重新分配
+  auto offset = static_cast<off_t>(page_id) * static_cast<off_t>(page_size_);
+  if (offset < db_file_size_.load() &&
+      fallocate(db_fd_, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offset, static_cast<off_t>(page_size_)) != 0) {
+    LOG_DEBUG("can't punch a hole for page %d", page_id);
+  }
+}
+
+/**
+ * Take the lowest free page owned by a buffer pool instance out of the free-page map
+ */
+page_id_t DiskManager::AllocateFreePage(uint32_t num_instances, uint32_t instance_index) {
+  std::lock_guard<std::mutex> guard(free_map_latch_);
+  if (num_free_pages_ == 0) {
+    return INVALID_PAGE_ID;
+  }
+  if (free_map_num_instances_ != num_instances) {
+    free_map_num_instances_ = num_instances;
+    free_page_hints_.assign(num_instances, 0);
+  }
+  // 1. 从这个实例的提示位置开始，只看属于它的页编号
+  // 2. 整个字节为零时直接跳到下一个字节
+  auto align = [&](size_t page) {
+    return page + (instance_index + num_instances - page % num_instances) % num_instances;
+  };
+  size_t &hint = free_page_hints_[instance_index];
+  size_t end = free_map_.size() * 8;
+  for (size_t page = align(hint); page < end;) {
+    uint8_t byte = free_map_[page / 8];
+    if (byte == 0) {
+      page = align((page / 8 + 1) * 8);
+      continue;
+    }
+    if ((byte & (1U << (page % 8))) != 0) {
+      hint = page + 1;
+      SetFree(static_cast<page_id_t>(page), false);
+      return static_cast<page_id_t>(page);
+    }
+    page += num_instances;
+  }
+  hint = end;
+  return INVALID_PAGE_ID;
+}
+
+/**
+ * Returns number of free pages
+ */
+size_t DiskManager::GetNumFreePages() {
+  std::lock_guard<std::mutex> guard(free_map_latch_);
+  return num_free_pages_;
+}
+
+/**
+ * Cut the free pages off the end of the database file
+ */
+size_t DiskManager::Truncate() {
+  std::unique_lock<std::shared_mutex> size_guard(file_size_latch_);
+  std::lock_guard<std::mutex> guard(free_map_latch_);
+  auto num_pages = static_cast<size_t>(db_file_size_.load() / static_cast<int64_t>(page_size_));
+  while (num_pages > 0) {
+    size_t last = num_pages - 1;
+    if (last / 8 >= free_map_.size() || (free_map_[last / 8] & (1U << (last % 8))) == 0) {
+      break;
+    }
+    num_pages--;
+  }
+  auto size = static_cast<int64_t>(num_pages * page_size_);
+  if (size < db_file_size_.load()) {
+    if (ftruncate(db_fd_, size) != 0) {
+      LOG_DEBUG("I/O error while truncating db file");
+      return static_cast<size_t>(db_file_size_.load() / static_cast<int64_t>(page_size_));
+    }
+    db_file_size_ = size;
+  }
+  return num_pages;
+}
+
+/**
+ * Private helper function to load the free-page map left by an earlier run
+ */
+void DiskManager::OpenFreeMapFile() {
+  free_map_fd_ = open(free_map_name_.c_str(), O_RDWR);
+  if (free_map_fd_ < 0) {
+    return;
+  }
+  // 数据库文件是新建的，旧的空闲页作废
+  if (db_file_size_.load() == 0) {
+    if (ftruncate(free_map_fd_, 0) != 0) {
+      LOG_DEBUG("I/O error while truncating free-page map file");
+    }
+    return;
+  }
+  struct stat stat_buf;
+  if (fstat(free_map_fd_, &stat_buf) != 0) {
+    return;
+  }
+  free_map_.resize(stat_buf.st_size);
+  auto size = static_cast<ssize_t>(free_map_.size());
+  if (pread(free_map_fd_, free_map_.data(), size, 0) != size) {
+    LOG_DEBUG("I/O error while reading free-page map file");
+    free_map_.clear();
+  }
+  for (uint8_t byte : free_map_) {
+    num_free_pages_ += __builtin_popcount(byte);
+  }
+}
+
+/**
+ * Private helper function to flip the bit of a page in the free-page map
+ */
+void DiskManager::SetFree(page_id_t page_id, bool is_free) {
+  size_t index = page_id / 8;
+  auto mask = static_cast<uint8_t>(1U << (page_id % 8));
+  if (index >= free_map_.size()) {
+    if (!is_free) {
+      return;
+    }
+    free_map_.resize(index + 1, 0);
+  }
+  if (((free_map_[index] & mask) != 0) == is_free) {
+    return;
+  }
+  if (is_free) {
+    free_map_[index] |= mask;
+    num_free_pages_++;
+    if (!free_page_hints_.empty()) {
+      size_t &hint = free_page_hints_[page_id % free_map_num_instances_];
+      hint = std::min(hint, static_cast<size_t>(page_id));
+    }
+  } else {
+    free_map_[index] &= static_cast<uint8_t>(~mask);
+    num_free_pages_--;
+  }
+  if (free_map_fd_ >= 0 && pwrite(free_map_fd_, &free_map_[index], 1, static_cast<off_t>(index)) != 1) {
+    LOG_DEBUG("I/O error while writing free-page map");
+  }
+}
+
+/**
+ * Private helper function to start the disk scheduler the first time asynchronous I/O is requested
+ */
+DiskScheduler *DiskManager::GetDiskScheduler() {
+  std::call_once(scheduler_once_, [&] {
+    disk_scheduler_ = std::make_unique<DiskScheduler>(db_fd_, DiskScheduler::DEFAULT_QUEUE_DEPTH,
+                                                      DiskScheduler::DEFAULT_NUM_WORKERS, true, direct_io_, page_size_);
+  });
+  return disk_scheduler_.get();
+}
+
 }  // namespace bustub
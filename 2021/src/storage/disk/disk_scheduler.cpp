@@ -0,0 +1,316 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// disk_scheduler.cpp
+//
+// Identification: src/storage/disk/disk_scheduler.cpp
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "storage/disk/disk_scheduler.h"
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include "common/logger.h"
+
+namespace bustub {
+
+namespace {
+
+int IoUringSetup(uint32_t entries, io_uring_params *params) {
+  return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+int IoUringEnter(int ring_fd, uint32_t to_submit, uint32_t min_complete, uint32_t flags) {
+  int ret;
+  do {
+    ret = static_cast<int>(syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, nullptr, 0));
+  } while (ret < 0 && (errno == EINTR || errno == EAGAIN || errno == EBUSY));
+  return ret;
+}
+
+/** user_data of the NOP that tells the reaper thread to exit. */
+constexpr uint64_t SHUTDOWN_USER_DATA = 0;
+
+}  // namespace
+
+DiskScheduler::DiskScheduler(int fd, uint32_t queue_depth, size_t num_workers, bool use_io_uring, bool direct_io,
+                             size_t page_size)
+    : fd_(fd), direct_io_(direct_io), page_size_(page_size) {
+  if (use_io_uring && SetupIoUring(queue_depth)) {
+    reaper_.emplace(&DiskScheduler::ReapIoUring, this);
+    return;
+  }
+  // io_uring不可用，退化成pread/pwrite线程池
+  for (size_t i = 0; i < std::max<size_t>(num_workers, 1); i++) {
+    workers_.emplace_back(&DiskScheduler::WorkerLoop, this);
+  }
+}
+
+DiskScheduler::~DiskScheduler() {
+  if (IsUsingIoUring()) {
+    {
+      // 等所有请求完成后，用一个NOP叫醒收割线程让它退出
+      std::unique_lock<std::mutex> lock(submit_latch_);
+      submit_cv_.wait(lock, [&] { return in_flight_ == 0; });
+      unsigned tail = __atomic_load_n(sq_tail_, __ATOMIC_RELAXED);
+      unsigned index = tail & *sq_mask_;
+      auto *sqe = reinterpret_cast<io_uring_sqe *>(sqes_) + index;
+      memset(sqe, 0, sizeof(io_uring_sqe));
+      sqe->opcode = IORING_OP_NOP;
+      sqe->user_data = SHUTDOWN_USER_DATA;
+      sq_array_[index] = index;
+      __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+      IoUringEnter(ring_fd_, 1, 0, 0);
+    }
+    reaper_->join();
+    TeardownIoUring();
+  }
+  for (size_t i = 0; i < workers_.size(); i++) {
+    request_queue_.Put(std::nullopt);
+  }
+  for (auto &worker : workers_) {
+    worker.join();
+  }
+}
+
+void DiskScheduler::Schedule(DiskRequest r) {
+  if (IsUsingIoUring()) {
+    SubmitIoUring(std::make_unique<InFlightRequest>(InFlightRequest{std::move(r), {}, nullptr}));
+    return;
+  }
+  request_queue_.Put(std::move(r));
+}
+
+bool DiskScheduler::ExecuteSync(int fd, page_id_t page_id, char *data, bool is_write, bool direct_io,
+                                size_t page_size) {
+  if (direct_io && !IsDirectIoAligned(data)) {
+    // O_DIRECT要求缓冲区对齐，借用线程私有的对齐缓冲区中转，按最大页大小分配
+    thread_local std::unique_ptr<char, AlignedDeleter> bounce(
+        static_cast<char *>(std::aligned_alloc(DIRECT_IO_ALIGNMENT, MAX_PAGE_SIZE)));
+    if (is_write) {
+      memcpy(bounce.get(), data, page_size);
+    }
+    bool ok = ExecuteSync(fd, page_id, bounce.get(), is_write, true, page_size);
+    if (!is_write && ok) {
+      memcpy(data, bounce.get(), page_size);
+    }
+    return ok;
+  }
+
+  off_t offset = static_cast<off_t>(page_id) * page_size;
+  size_t done = 0;
+  while (done < page_size) {
+    ssize_t n = is_write ? pwrite(fd, data + done, page_size - done, offset + done)
+                         : pread(fd, data + done, page_size - done, offset + done);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      LOG_DEBUG("I/O error while %s page %d: %s", is_write ? "writing" : "reading", page_id, strerror(errno));
+      return false;
+    }
+    if (n == 0) {
+      if (is_write) {
+        return false;
+      }
+      // 读到文件末尾，剩下的补零
+      memset(data + done, 0, page_size - done);
+      return true;
+    }
+    done += n;
+  }
+  return true;
+}
+
+bool DiskScheduler::SetupIoUring(uint32_t queue_depth) {
+  io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  int ring_fd = IoUringSetup(std::max<uint32_t>(queue_depth, 1), &params);
+  if (ring_fd < 0) {
+    LOG_DEBUG("io_uring unavailable (%s), falling back to pread/pwrite workers", strerror(errno));
+    return false;
+  }
+
+  sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if (single_mmap) {
+    sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+  }
+
+  sq_ptr_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd,
+                 IORING_OFF_SQ_RING);
+  if (sq_ptr_ == MAP_FAILED) {
+    sq_ptr_ = nullptr;
+    close(ring_fd);
+    return false;
+  }
+  if (single_mmap) {
+    cq_ptr_ = sq_ptr_;
+  } else {
+    cq_ptr_ = mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd,
+                   IORING_OFF_CQ_RING);
+    if (cq_ptr_ == MAP_FAILED) {
+      cq_ptr_ = nullptr;
+      munmap(sq_ptr_, sq_ring_size_);
+      sq_ptr_ = nullptr;
+      close(ring_fd);
+      return false;
+    }
+  }
+  sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+  sqes_ = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+  if (sqes_ == MAP_FAILED) {
+    sqes_ = nullptr;
+    ring_fd_ = ring_fd;
+    TeardownIoUring();
+    return false;
+  }
+
+  auto *sq = reinterpret_cast<char *>(sq_ptr_);
+  sq_tail_ = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+  sq_mask_ = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+  sq_array_ = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+  auto *cq = reinterpret_cast<char *>(cq_ptr_);
+  cq_head_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+  cq_tail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+  cq_mask_ = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+  cqes_ = cq + params.cq_off.cqes;
+  sq_entries_ = params.sq_entries;
+  ring_fd_ = ring_fd;
+  return true;
+}
+
+void DiskScheduler::TeardownIoUring() {
+  if (sqes_ != nullptr) {
+    munmap(sqes_, sqes_size_);
+  }
+  if (cq_ptr_ != nullptr && cq_ptr_ != sq_ptr_) {
+    munmap(cq_ptr_, cq_ring_size_);
+  }
+  if (sq_ptr_ != nullptr) {
+    munmap(sq_ptr_, sq_ring_size_);
+  }
+  sqes_ = sq_ptr_ = cq_ptr_ = nullptr;
+  close(ring_fd_);
+  ring_fd_ = -1;
+}
+
+void DiskScheduler::SubmitIoUring(std::unique_ptr<InFlightRequest> request) {
+  request->iov_.iov_base = request->request_.data_;
+  request->iov_.iov_len = page_size_;
+  if (direct_io_ && !IsDirectIoAligned(request->request_.data_)) {
+    request->bounce_.reset(static_cast<char *>(std::aligned_alloc(DIRECT_IO_ALIGNMENT, page_size_)));
+    if (request->request_.is_write_) {
+      memcpy(request->bounce_.get(), request->request_.data_, page_size_);
+    }
+    request->iov_.iov_base = request->bounce_.get();
+  }
+
+  std::unique_lock<std::mutex> lock(submit_latch_);
+  // 飞行中的请求数不超过SQ大小，每次enter都会把SQ消费完，所以这里一定有空位
+  submit_cv_.wait(lock, [&] { return in_flight_ < sq_entries_; });
+
+  unsigned tail = __atomic_load_n(sq_tail_, __ATOMIC_RELAXED);
+  unsigned index = tail & *sq_mask_;
+  auto *sqe = reinterpret_cast<io_uring_sqe *>(sqes_) + index;
+  memset(sqe, 0, sizeof(io_uring_sqe));
+  sqe->opcode = request->request_.is_write_ ? IORING_OP_WRITEV : IORING_OP_READV;
+  sqe->fd = fd_;
+  sqe->off = static_cast<uint64_t>(request->request_.page_id_) * page_size_;
+  sqe->addr = reinterpret_cast<uint64_t>(&request->iov_);
+  sqe->len = 1;
+  sqe->user_data = reinterpret_cast<uint64_t>(request.release());
+  sq_array_[index] = index;
+  __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+  in_flight_++;
+
+  if (IoUringEnter(ring_fd_, 1, 0, 0) >= 0) {
+    return;
+  }
+  // 内核没有消费这个SQE，把它从环里撤回，改用pread/pwrite同步完成
+  LOG_DEBUG("io_uring_enter failed: %s", strerror(errno));
+  __atomic_store_n(sq_tail_, tail, __ATOMIC_RELEASE);
+  request.reset(reinterpret_cast<InFlightRequest *>(sqe->user_data));
+  in_flight_--;
+  lock.unlock();
+  submit_cv_.notify_all();
+
+  DiskRequest &r = request->request_;
+  r.callback_.set_value(ExecuteSync(fd_, r.page_id_, r.data_, r.is_write_, direct_io_, page_size_));
+}
+
+void DiskScheduler::ReapIoUring() {
+  auto *cqes = reinterpret_cast<io_uring_cqe *>(cqes_);
+  bool shutdown = false;
+  while (!shutdown) {
+    unsigned head = __atomic_load_n(cq_head_, __ATOMIC_RELAXED);
+    unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    if (head == tail) {
+      IoUringEnter(ring_fd_, 0, 1, IORING_ENTER_GETEVENTS);
+      continue;
+    }
+
+    uint32_t completed = 0;
+    for (; head != tail; head++) {
+      io_uring_cqe *cqe = &cqes[head & *cq_mask_];
+      if (cqe->user_data == SHUTDOWN_USER_DATA) {
+        shutdown = true;
+        continue;
+      }
+      std::unique_ptr<InFlightRequest> request(reinterpret_cast<InFlightRequest *>(cqe->user_data));
+      DiskRequest &r = request->request_;
+      auto *data = static_cast<char *>(request->iov_.iov_base);
+      bool ok = true;
+      if (cqe->res < 0) {
+        LOG_DEBUG("I/O error on page %d: %s", r.page_id_, strerror(-cqe->res));
+        ok = false;
+      } else if (static_cast<size_t>(cqe->res) < page_size_) {
+        if (r.is_write_) {
+          // 短写，剩下的部分同步补上
+          ok = ExecuteSync(fd_, r.page_id_, data, true, direct_io_, page_size_);
+        } else {
+          // 读到文件末尾，剩下的补零
+          memset(data + cqe->res, 0, page_size_ - cqe->res);
+        }
+      }
+      if (ok && !r.is_write_ && request->bounce_ != nullptr) {
+        memcpy(r.data_, data, page_size_);
+      }
+      r.callback_.set_value(ok);
+      completed++;
+    }
+    __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+
+    if (completed > 0) {
+      {
+        std::lock_guard<std::mutex> guard(submit_latch_);
+        in_flight_ -= completed;
+      }
+      submit_cv_.notify_all();
+    }
+  }
+}
+
+void DiskScheduler::WorkerLoop() {
+  while (true) {
+    std::optional<DiskRequest> r = request_queue_.Get();
+    if (!r.has_value()) {
+      return;
+    }
+    r->callback_.set_value(ExecuteSync(fd_, r->page_id_, r->data_, r->is_write_, direct_io_, page_size_));
+  }
+}
+
+}  // namespace bustub
@@ -24,8 +24,11 @@ BPLUSTREE_TYPE::BPlusTree(std::string name, BufferPoolManager *buffer_pool_manag
       root_page_id_(INVALID_PAGE_ID),
       buffer_pool_manager_(buffer_pool_manager),
       comparator_(comparator),
-      leaf_max_size_(leaf_max_size),
-      internal_max_size_(internal_max_size) {}
+      leaf_max_size_(leaf_max_size > 0 ? leaf_max_size
+                                       : static_cast<int>(LEAF_PAGE_CAPACITY(buffer_pool_manager->GetPageSize()))),
+      internal_max_size_(internal_max_size > 0
+                             ? internal_max_size
+                             : static_cast<int>(INTERNAL_PAGE_CAPACITY(buffer_pool_manager->GetPageSize()))) {}
 
 /*
  * Helper function to decide whether current b+tree is empty
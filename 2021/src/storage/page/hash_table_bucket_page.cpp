@@ -11,21 +11,125 @@
 //===----------------------------------------------------------------------===//
 
 #include "storage/page/hash_table_bucket_page.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define BUSTUB_HASH_PROBE_X86
+#endif
+
 #include "common/logger.h"
 #include "common/util/hash_util.h"
+#include "murmur3/MurmurHash3.h"
 #include "storage/index/generic_key.h"
 #include "storage/index/hash_comparator.h"
 #include "storage/table/tmp_tuple.h"
 
 namespace bustub {
 
+namespace {
+
+/** Compare 32 fingerprints with one, bit i of the result is set if fingerprints[i] matches. */
+uint32_t MatchFingerprintsScalar(const uint8_t *fingerprints, uint8_t fingerprint) {
+  uint32_t mask = 0;
+  for (uint32_t i = 0; i < 32; i++) {
+    mask |= static_cast<uint32_t>(fingerprints[i] == fingerprint) << i;
+  }
+  return mask;
+}
+
+#ifdef BUSTUB_HASH_PROBE_X86
+uint32_t MatchFingerprintsSse2(const uint8_t *fingerprints, uint8_t fingerprint) {
+  __m128i needle = _mm_set1_epi8(static_cast<char>(fingerprint));
+  __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i *>(fingerprints));
+  __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i *>(fingerprints + 16));
+  auto low_mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(low, needle)));
+  auto high_mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(high, needle)));
+  return low_mask | (high_mask << 16);
+}
+
+__attribute__((target("avx2"))) uint32_t MatchFingerprintsAvx2(const uint8_t *fingerprints, uint8_t fingerprint) {
+  __m256i needle = _mm256_set1_epi8(static_cast<char>(fingerprint));
+  __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(fingerprints));
+  return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, needle)));
+}
+#endif
+
+using MatchFingerprintsFunc = uint32_t (*)(const uint8_t *, uint8_t);
+
+/** The widest kernel the CPU runs. */
+MatchFingerprintsFunc ChooseMatchFingerprints() {
+#ifdef BUSTUB_HASH_PROBE_X86
+  return __builtin_cpu_supports("avx2") ? MatchFingerprintsAvx2 : MatchFingerprintsSse2;
+#else
+  return MatchFingerprintsScalar;
+#endif
+}
+
+const MatchFingerprintsFunc MATCH_FINGERPRINTS = ChooseMatchFingerprints();
+
+/** @return the number of set bits in a bitmap of length bytes */
+uint32_t CountBits(const char *bitmap, size_t length) {
+  uint32_t num = 0;
+  size_t i = 0;
+  for (; i + sizeof(uint64_t) <= length; i += sizeof(uint64_t)) {
+    uint64_t word;
+    memcpy(&word, bitmap + i, sizeof(word));
+    num += __builtin_popcountll(word);
+  }
+  for (; i < length; i++) {
+    num += __builtin_popcount(static_cast<uint8_t>(bitmap[i]));
+  }
+  return num;
+}
+
+}  // namespace
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+uint8_t HASH_TABLE_BUCKET_TYPE::Fingerprint(const KeyType &key) {
+  // 和目录用的哈希不同，桶里的键低位哈希值都一样，不能拿来当指纹
+  uint32_t hash = murmur3::MurmurHash3_x86_32(reinterpret_cast<const void *>(&key), sizeof(KeyType), 0);
+  return static_cast<uint8_t>(hash >> 24);
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+uint32_t HASH_TABLE_BUCKET_TYPE::ReadableMask(uint32_t block) const {
+  // 一个块的32位可读标志正好是readable_里的4个字节，最后一块不满，多出来的槽位清掉
+  uint32_t first_slot = block * PROBE_BLOCK_SIZE;
+  uint32_t num_slots = std::min<uint32_t>(PROBE_BLOCK_SIZE, BUCKET_ARRAY_SIZE - first_slot);
+  uint32_t mask = 0;
+  memcpy(&mask, readable_ + first_slot / 8, (num_slots + 7) / 8);
+  return num_slots == PROBE_BLOCK_SIZE ? mask : mask & ((1U << num_slots) - 1);
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+uint32_t HASH_TABLE_BUCKET_TYPE::MatchFingerprint(uint32_t block, uint8_t fingerprint) const {
+  uint32_t first_slot = block * PROBE_BLOCK_SIZE;
+  uint32_t mask;
+  if (first_slot + PROBE_BLOCK_SIZE <= BUCKET_ARRAY_SIZE) {
+    mask = MATCH_FINGERPRINTS(fingerprints_ + first_slot, fingerprint);
+  } else {
+    uint8_t tail[PROBE_BLOCK_SIZE] = {0};
+    memcpy(tail, fingerprints_ + first_slot, BUCKET_ARRAY_SIZE - first_slot);
+    mask = MatchFingerprintsScalar(tail, fingerprint);
+  }
+  return mask & ReadableMask(block);
+}
+
 template <typename KeyType, typename ValueType, typename KeyComparator>
 bool HASH_TABLE_BUCKET_TYPE::GetValue(KeyType key, KeyComparator cmp, std::vector<ValueType> *result) {
+  // 先按块比较指纹，指纹相同的可读槽位才调用比较器
   bool res = false;
-  for (size_t i = 0; i < BUCKET_ARRAY_SIZE; ++i) {
-    if (IsReadable(i) && cmp(key, array_[i].first) == 0) {
-      result->push_back(array_[i].second);
-      res = true;
+  uint8_t fingerprint = Fingerprint(key);
+  for (uint32_t block = 0; block * PROBE_BLOCK_SIZE < BUCKET_ARRAY_SIZE; block++) {
+    for (uint32_t mask = MatchFingerprint(block, fingerprint); mask != 0; mask &= mask - 1) {
+      uint32_t i = block * PROBE_BLOCK_SIZE + __builtin_ctz(mask);
+      if (cmp(key, array_[i].first) == 0) {
+        result->push_back(array_[i].second);
+        res = true;
+      }
     }
   }
   return res;
@@ -34,15 +138,20 @@ bool HASH_TABLE_BUCKET_TYPE::GetValue(KeyType key, KeyComparator cmp, std::vecto
 template <typename KeyType, typename ValueType, typename KeyComparator>
 bool HASH_TABLE_BUCKET_TYPE::Insert(KeyType key, ValueType value, KeyComparator cmp) {
   int64_t free_slot = -1;
-  for (size_t i = 0; i < BUCKET_ARRAY_SIZE; i++) {
-    if (IsReadable(i)) {
+  uint8_t fingerprint = Fingerprint(key);
+  for (uint32_t block = 0; block * PROBE_BLOCK_SIZE < BUCKET_ARRAY_SIZE; block++) {
+    for (uint32_t mask = MatchFingerprint(block, fingerprint); mask != 0; mask &= mask - 1) {
+      uint32_t i = block * PROBE_BLOCK_SIZE + __builtin_ctz(mask);
       if (cmp(key, array_[i].first) == 0 && value == array_[i].second) {
         // already existed the same key & value
         //                LOG_DEBUG("Same kv");
         return false;
       }
-    } else if (free_slot == -1) {
-      free_slot = i;
+    }
+    uint32_t num_slots = std::min<uint32_t>(PROBE_BLOCK_SIZE, BUCKET_ARRAY_SIZE - block * PROBE_BLOCK_SIZE);
+    uint32_t free_mask = ~ReadableMask(block) & (num_slots == PROBE_BLOCK_SIZE ? ~0U : (1U << num_slots) - 1);
+    if (free_slot == -1 && free_mask != 0) {
+      free_slot = block * PROBE_BLOCK_SIZE + __builtin_ctz(free_mask);
     }
   }
 
@@ -55,14 +164,17 @@ bool HASH_TABLE_BUCKET_TYPE::Insert(KeyType key, ValueType value, KeyComparator
   // insert it and return true
   SetOccupied(free_slot);
   SetReadable(free_slot);
+  fingerprints_[free_slot] = fingerprint;
   array_[free_slot] = MappingType(key, value);
   return true;
 }
 
 template <typename KeyType, typename ValueType, typename KeyComparator>
 bool HASH_TABLE_BUCKET_TYPE::Remove(KeyType key, ValueType value, KeyComparator cmp) {
-  for (size_t i = 0; i < BUCKET_ARRAY_SIZE; i++) {
-    if (IsReadable(i)) {
+  uint8_t fingerprint = Fingerprint(key);
+  for (uint32_t block = 0; block * PROBE_BLOCK_SIZE < BUCKET_ARRAY_SIZE; block++) {
+    for (uint32_t mask = MatchFingerprint(block, fingerprint); mask != 0; mask &= mask - 1) {
+      uint32_t i = block * PROBE_BLOCK_SIZE + __builtin_ctz(mask);
       if (cmp(key, array_[i].first) == 0 && value == array_[i].second) {
         // find it
         RemoveAt(i);
@@ -152,65 +264,27 @@ void HASH_TABLE_BUCKET_TYPE::SetReadable(uint32_t bucket_idx, bool status) {
 
 template <typename KeyType, typename ValueType, typename KeyComparator>
 bool HASH_TABLE_BUCKET_TYPE::IsFull() {
-  u_int8_t mask = 255;
-  size_t times = BUCKET_ARRAY_SIZE / 8;
-  for (size_t i = 0; i < times; i++) {
-    char c = readable_[i];
-    uint8_t ic = static_cast<uint8_t>(c);
-    if ((ic & mask) != mask) {
-      return false;
-    }
-  }
-
-  size_t remain = BUCKET_ARRAY_SIZE % 8;
-  if (remain > 0) {
-    char c = readable_[times];
-    uint8_t ic = static_cast<uint8_t>(c);
-    for (size_t i = 0; i < remain; i++) {
-      if ((ic & 1) != 1) {
-        return false;
-      }
-      ic = ic >> 1;
-    }
-  }
-  return true;
+  return NumReadable() == BUCKET_ARRAY_SIZE;
 }
 
 template <typename KeyType, typename ValueType, typename KeyComparator>
 uint32_t HASH_TABLE_BUCKET_TYPE::NumReadable() {
-  uint32_t num = 0;
-  size_t times = BUCKET_ARRAY_SIZE / 8;
-  for (size_t i = 0; i < times; i++) {
-    char c = readable_[i];
-    uint8_t ic = static_cast<uint8_t>(c);
-    for (uint32_t j = 0; j < 8; j++) {
-      if ((ic & 1) > 0) {
-        num++;
-      }
-      ic = ic >> 1;
-    }
-  }
-
-  size_t remain = BUCKET_ARRAY_SIZE % 8;
-  if (remain > 0) {
-    char c = readable_[times];
-    uint8_t ic = static_cast<uint8_t>(c);
-    for (size_t i = 0; i < remain; i++) {
-      if ((ic & 1) == 1) {
-        num++;
-      }
-      ic = ic >> 1;
-    }
-  }
-  return num;
+  // 一次数64个标志位，BUCKET_ARRAY_SIZE之后的位从来不会被置上
+  return CountBits(readable_, sizeof(readable_));
 }
 
 template <typename KeyType, typename ValueType, typename KeyComparator>
 bool HASH_TABLE_BUCKET_TYPE::IsEmpty() {
-  u_int8_t mask = 255;
-  for (size_t i = 0; i < sizeof(readable_) / sizeof(readable_[0]); i++) {
-    char c = readable_[i];
-    if ((c & mask) > 0) {
+  size_t i = 0;
+  for (; i + sizeof(uint64_t) <= sizeof(readable_); i += sizeof(uint64_t)) {
+    uint64_t word;
+    memcpy(&word, readable_ + i, sizeof(word));
+    if (word != 0) {
+      return false;
+    }
+  }
+  for (; i < sizeof(readable_); i++) {
+    if (readable_[i] != 0) {
       return false;
     }
   }
@@ -255,7 +329,8 @@ void HashTableBucketPage<KeyType, ValueType, KeyComparator>::Clear() {
   LOG_DEBUG("clear");
   memset(occupied_, 0, sizeof(occupied_));
   memset(readable_, 0, sizeof(readable_));
-  memset(array_, 0, sizeof(array_));
+  memset(fingerprints_, 0, sizeof(fingerprints_));
+  memset(reinterpret_cast<void *>(array_), 0, sizeof(array_));
 }
 
 // DO NOT REMOVE ANYTHING BELOW THIS LINE
@@ -267,6 +342,10 @@ template class HashTableBucketPage<GenericKey<16>, RID, GenericComparator<16>>;
 template class HashTableBucketPage<GenericKey<32>, RID, GenericComparator<32>>;
 template class HashTableBucketPage<GenericKey<64>, RID, GenericComparator<64>>;
 
+static_assert(sizeof(HashTableBucketPage<int, int, IntComparator>) <= PAGE_SIZE);
+static_assert(sizeof(HashTableBucketPage<GenericKey<4>, RID, GenericComparator<4>>) <= PAGE_SIZE);
+static_assert(sizeof(HashTableBucketPage<GenericKey<64>, RID, GenericComparator<64>>) <= PAGE_SIZE);
+
 // template class HashTableBucketPage<hash_t, TmpTuple, HashComparator>;
 
 }  // namespace bustub
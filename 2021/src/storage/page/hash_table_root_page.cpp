@@ -0,0 +1,78 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// hash_table_root_page.cpp
+//
+// Identification: src/storage/page/hash_table_root_page.cpp
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "storage/page/hash_table_root_page.h"
+
+#include "common/logger.h"
+
+namespace bustub {
+
+static_assert(ROOT_ARRAY_SIZE == 1 << MAX_DIRECTORY_DEPTH, "every top-bit pattern needs a slot");
+
+void HashTableRootPage::Init(page_id_t page_id, page_id_t directory_page_id) {
+  page_id_ = page_id;
+  for (uint32_t slot = 0; slot < ROOT_ARRAY_SIZE; slot++) {
+    directory_depths_[slot] = 0;
+    directory_page_ids_[slot] = directory_page_id;
+  }
+}
+
+page_id_t HashTableRootPage::GetPageId() const { return page_id_; }
+
+lsn_t HashTableRootPage::GetLSN() const { return lsn_; }
+
+void HashTableRootPage::SetLSN(lsn_t lsn) { lsn_ = lsn; }
+
+page_id_t HashTableRootPage::GetDirectoryPageId(uint32_t slot) { return directory_page_ids_[slot]; }
+
+void HashTableRootPage::SetDirectoryPageId(uint32_t slot, page_id_t directory_page_id) {
+  directory_page_ids_[slot] = directory_page_id;
+}
+
+uint32_t HashTableRootPage::GetDirectoryDepth(uint32_t slot) { return directory_depths_[slot]; }
+
+void HashTableRootPage::SetDirectoryDepth(uint32_t slot, uint8_t depth) {
+  assert(depth <= MAX_DIRECTORY_DEPTH);
+  directory_depths_[slot] = depth;
+}
+
+uint32_t HashTableRootPage::GetFirstSlot(uint32_t slot) { return slot & ~(GetNumSlots(slot) - 1); }
+
+uint32_t HashTableRootPage::GetNumSlots(uint32_t slot) {
+  return 1U << (MAX_DIRECTORY_DEPTH - directory_depths_[slot]);
+}
+
+void HashTableRootPage::VerifyIntegrity() {
+  // 每个目录占连续的2^(9-d)个槽，槽里的深度都一样
+  uint32_t slot = 0;
+  while (slot < ROOT_ARRAY_SIZE) {
+    uint32_t first_slot = GetFirstSlot(slot);
+    uint32_t num_slots = GetNumSlots(slot);
+    if (first_slot != slot) {
+      LOG_WARN("Verify Integrity: slot %u of directory %d is not aligned to its depth %u", slot,
+               directory_page_ids_[slot], directory_depths_[slot]);
+      assert(first_slot == slot);
+    }
+    for (uint32_t i = slot; i < slot + num_slots; i++) {
+      if (directory_page_ids_[i] != directory_page_ids_[slot] || directory_depths_[i] != directory_depths_[slot]) {
+        LOG_WARN("Verify Integrity: slot %u points to directory %d of depth %u, slot %u to directory %d of depth %u", i,
+                 directory_page_ids_[i], directory_depths_[i], slot, directory_page_ids_[slot],
+                 directory_depths_[slot]);
+        assert(directory_page_ids_[i] == directory_page_ids_[slot]);
+        assert(directory_depths_[i] == directory_depths_[slot]);
+      }
+    }
+    slot += num_slots;
+  }
+}
+
+}  // namespace bustub
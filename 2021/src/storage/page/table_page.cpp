@@ -12,7 +12,11 @@
 
 #include "storage/page/table_page.h"
 
+#include <algorithm>
 #include <cassert>
+#include <functional>
+#include <utility>
+#include <vector>
 
 namespace bustub {
 
@@ -146,6 +150,11 @@ bool TablePage::UpdateTuple(const Tuple &new_tuple, Tuple *old_tuple, const RID
     }
     return false;
   }
+  // A tuple that was moved away is updated through the table heap, which follows the forwarding stub.
+  if ((tuple_size & FORWARD_FLAG) != 0) {
+    return false;
+  }
+  tuple_size = GetLength(tuple_size);
   // If there is not enuogh space to update, we need to update via delete followed by an insert (not enough space).
   if (GetFreeSpaceRemaining() + tuple_size < new_tuple.size_) {
     return false;
@@ -178,23 +187,100 @@ bool TablePage::UpdateTuple(const Tuple &new_tuple, Tuple *old_tuple, const RID
   }
 
   // Perform the update.
+  uint32_t new_tuple_offset = ResizeTuple(slot_num, new_tuple.size_);
+  memcpy(GetData() + new_tuple_offset, new_tuple.data_, new_tuple.size_);
+  return true;
+}
+
+bool TablePage::GetForwardRid(const RID &rid, RID *forward_rid) {
+  uint32_t slot_num = rid.GetSlotNum();
+  if (slot_num >= GetTupleCount() || (GetTupleSize(slot_num) & FORWARD_FLAG) == 0) {
+    return false;
+  }
+  const char *stub = GetData() + GetTupleOffsetAtSlot(slot_num);
+  page_id_t page_id;
+  uint32_t forward_slot_num;
+  memcpy(&page_id, stub, sizeof(page_id_t));
+  memcpy(&forward_slot_num, stub + sizeof(page_id_t), sizeof(uint32_t));
+  forward_rid->Set(page_id, forward_slot_num);
+  return true;
+}
+
+bool TablePage::SetForwardRid(const RID &rid, const RID &forward_rid) {
+  uint32_t slot_num = rid.GetSlotNum();
+  if (slot_num >= GetTupleCount()) {
+    return false;
+  }
+  uint32_t tuple_size = GetTupleSize(slot_num);
+  if (tuple_size == 0 || GetFreeSpaceRemaining() + GetLength(tuple_size) < SIZE_FORWARD_RID) {
+    return false;
+  }
+  // 元组换成转发桩，保留删除标记
+  uint32_t stub_offset = ResizeTuple(slot_num, SIZE_FORWARD_RID);
+  page_id_t page_id = forward_rid.GetPageId();
+  uint32_t forward_slot_num = forward_rid.GetSlotNum();
+  memcpy(GetData() + stub_offset, &page_id, sizeof(page_id_t));
+  memcpy(GetData() + stub_offset + sizeof(page_id_t), &forward_slot_num, sizeof(uint32_t));
+  SetTupleSize(slot_num, SIZE_FORWARD_RID | FORWARD_FLAG | static_cast<uint32_t>(tuple_size & DELETE_MASK));
+  return true;
+}
+
+void TablePage::SetMoved(const RID &rid) {
+  uint32_t slot_num = rid.GetSlotNum();
+  BUSTUB_ASSERT(slot_num < GetTupleCount(), "Cannot have more slots than tuples.");
+  SetTupleSize(slot_num, GetTupleSize(slot_num) | MOVED_FLAG);
+}
+
+uint32_t TablePage::Compact() {
+  // 1. 元组按偏移从大到小，依次紧挨着挪到页尾，槽号不变
+  // 2. 去掉槽数组末尾的空槽
+  uint32_t free_space_before = GetFreeSpaceRemaining();
+  std::vector<std::pair<uint32_t, uint32_t>> tuples;
+  for (uint32_t i = 0; i < GetTupleCount(); ++i) {
+    if (GetTupleSize(i) != 0) {
+      tuples.emplace_back(GetTupleOffsetAtSlot(i), i);
+    }
+  }
+  std::sort(tuples.begin(), tuples.end(), std::greater<>());
+  auto end = static_cast<uint32_t>(GetPageSize());
+  for (const auto &[tuple_offset, slot_num] : tuples) {
+    uint32_t tuple_size = GetLength(GetTupleSize(slot_num));
+    end -= tuple_size;
+    if (end != tuple_offset) {
+      memmove(GetData() + end, GetData() + tuple_offset, tuple_size);
+      SetTupleOffsetAtSlot(slot_num, end);
+    }
+  }
+  SetFreeSpacePointer(end);
+
+  uint32_t tuple_count = GetTupleCount();
+  while (tuple_count > 0 && GetTupleSize(tuple_count - 1) == 0) {
+    tuple_count--;
+  }
+  SetTupleCount(tuple_count);
+  return GetFreeSpaceRemaining() - free_space_before;
+}
+
+uint32_t TablePage::ResizeTuple(uint32_t slot_num, uint32_t new_length) {
+  uint32_t tuple_offset = GetTupleOffsetAtSlot(slot_num);
+  uint32_t tuple_size = GetTupleSize(slot_num);
+  uint32_t tuple_length = GetLength(tuple_size);
   uint32_t free_space_pointer = GetFreeSpacePointer();
   BUSTUB_ASSERT(tuple_offset >= free_space_pointer, "Offset should appear after current free space position.");
 
-  memmove(GetData() + free_space_pointer + tuple_size - new_tuple.size_, GetData() + free_space_pointer,
+  memmove(GetData() + free_space_pointer + tuple_length - new_length, GetData() + free_space_pointer,
           tuple_offset - free_space_pointer);
-  SetFreeSpacePointer(free_space_pointer + tuple_size - new_tuple.size_);
-  memcpy(GetData() + tuple_offset + tuple_size - new_tuple.size_, new_tuple.data_, new_tuple.size_);
-  SetTupleSize(slot_num, new_tuple.size_);
+  SetFreeSpacePointer(free_space_pointer + tuple_length - new_length);
+  SetTupleSize(slot_num, new_length | (tuple_size & ~(MOVED_FLAG - 1)));
 
   // Update all tuple offsets.
   for (uint32_t i = 0; i < GetTupleCount(); ++i) {
     uint32_t tuple_offset_i = GetTupleOffsetAtSlot(i);
-    if (GetTupleSize(i) > 0 && tuple_offset_i < tuple_offset + tuple_size) {
-      SetTupleOffsetAtSlot(i, tuple_offset_i + tuple_size - new_tuple.size_);
+    if (GetTupleSize(i) > 0 && tuple_offset_i < tuple_offset + tuple_length) {
+      SetTupleOffsetAtSlot(i, tuple_offset_i + tuple_length - new_length);
     }
   }
-  return true;
+  return tuple_offset + tuple_length - new_length;
 }
 
 void TablePage::ApplyDelete(const RID &rid, Transaction *txn, LogManager *log_manager) {
@@ -208,6 +294,8 @@ void TablePage::ApplyDelete(const RID &rid, Transaction *txn, LogManager *log_ma
     tuple_size = UnsetDeletedFlag(tuple_size);
   }
   // Otherwise we are rolling back an insert.
+  bool is_moved = (tuple_size & MOVED_FLAG) != 0;
+  tuple_size = GetLength(tuple_size);
 
   // We need to copy out the deleted tuple for undo purposes.
   Tuple delete_tuple;
@@ -218,7 +306,7 @@ void TablePage::ApplyDelete(const RID &rid, Transaction *txn, LogManager *log_ma
   delete_tuple.allocated_ = true;
 
   if (enable_logging) {
-    BUSTUB_ASSERT(txn->IsExclusiveLocked(rid), "We must own the exclusive lock!");
+    BUSTUB_ASSERT(is_moved || txn->IsExclusiveLocked(rid), "We must own the exclusive lock!");
 
     LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::APPLYDELETE, rid, delete_tuple);
     lsn_t lsn = log_manager->AppendLogRecord(&log_record);
@@ -266,6 +354,23 @@ void TablePage::RollbackDelete(const RID &rid, Transaction *txn, LogManager *log
 }
 
 bool TablePage::GetTuple(const RID &rid, Tuple *tuple, Transaction *txn, LockManager *lock_manager) {
+  Tuple view;
+  if (!ViewTuple(rid, &view, txn, lock_manager)) {
+    return false;
+  }
+  // Copy the tuple data into our result.
+  tuple->size_ = view.size_;
+  if (tuple->allocated_) {
+    delete[] tuple->data_;
+  }
+  tuple->data_ = new char[tuple->size_];
+  memcpy(tuple->data_, view.data_, tuple->size_);
+  tuple->rid_ = view.rid_;
+  tuple->allocated_ = true;
+  return true;
+}
+
+bool TablePage::ViewTuple(const RID &rid, Tuple *tuple, Transaction *txn, LockManager *lock_manager) {
   // Get the current slot number.
   uint32_t slot_num = rid.GetSlotNum();
   // If somehow we have more slots than tuples, abort the transaction.
@@ -292,23 +397,22 @@ bool TablePage::GetTuple(const RID &rid, Tuple *tuple, Transaction *txn, LockMan
     }
   }
 
-  // At this point, we have at least a shared lock on the RID. Copy the tuple data into our result.
+  // At this point, we have at least a shared lock on the RID. Point the result at the tuple data in the page.
   uint32_t tuple_offset = GetTupleOffsetAtSlot(slot_num);
-  tuple->size_ = tuple_size;
   if (tuple->allocated_) {
     delete[] tuple->data_;
   }
-  tuple->data_ = new char[tuple->size_];
-  memcpy(tuple->data_, GetData() + tuple_offset, tuple->size_);
+  tuple->size_ = GetLength(tuple_size);
+  tuple->data_ = GetData() + tuple_offset;
   tuple->rid_ = rid;
-  tuple->allocated_ = true;
+  tuple->allocated_ = false;
   return true;
 }
 
 bool TablePage::GetFirstTupleRid(RID *first_rid) {
   // Find and return the first valid tuple.
   for (uint32_t i = 0; i < GetTupleCount(); ++i) {
-    if (!IsDeleted(GetTupleSize(i))) {
+    if (IsVisible(GetTupleSize(i))) {
       first_rid->Set(GetTablePageId(), i);
       return true;
     }
@@ -321,7 +425,7 @@ bool TablePage::GetNextTupleRid(const RID &cur_rid, RID *next_rid) {
   BUSTUB_ASSERT(cur_rid.GetPageId() == GetTablePageId(), "Wrong table!");
   // Find and return the first valid tuple after our current slot number.
   for (auto i = cur_rid.GetSlotNum() + 1; i < GetTupleCount(); ++i) {
-    if (!IsDeleted(GetTupleSize(i))) {
+    if (IsVisible(GetTupleSize(i))) {
       next_rid->Set(GetTablePageId(), i);
       return true;
     }
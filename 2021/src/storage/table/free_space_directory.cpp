@@ -0,0 +1,83 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// free_space_directory.cpp
+//
+// Identification: src/storage/table/free_space_directory.cpp
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "storage/table/free_space_directory.h"
+
+#include <algorithm>
+
+namespace bustub {
+
+FreeSpaceDirectory::FreeSpaceDirectory(size_t page_size) : page_size_(page_size) {}
+
+void FreeSpaceDirectory::Update(page_id_t page_id, uint32_t free_space) {
+  std::lock_guard<std::mutex> guard(latch_);
+  uint32_t new_class = ClassOf(free_space);
+  auto iter = pages_.find(page_id);
+  if (iter != pages_.end()) {
+    iter->second.free_space_ = free_space;
+    if (iter->second.class_ == new_class) {
+      return;
+    }
+    RemoveFromClass(iter->second);
+  } else {
+    iter = pages_.emplace(page_id, Entry{free_space, 0, 0}).first;
+  }
+  // 放到新的大小类末尾
+  iter->second.class_ = new_class;
+  iter->second.index_ = classes_[new_class].size();
+  classes_[new_class].push_back(page_id);
+  non_empty_classes_ |= uint64_t{1} << new_class;
+}
+
+page_id_t FreeSpaceDirectory::FindPage(uint32_t size) {
+  // 下界不小于size的第一个大小类：c * page_size / NUM_CLASSES >= size
+  uint64_t min_class = (static_cast<uint64_t>(size) * NUM_CLASSES + page_size_ - 1) / page_size_;
+  if (min_class >= NUM_CLASSES) {
+    return INVALID_PAGE_ID;
+  }
+  std::lock_guard<std::mutex> guard(latch_);
+  uint64_t candidates = non_empty_classes_ & (~uint64_t{0} << min_class);
+  if (candidates == 0) {
+    return INVALID_PAGE_ID;
+  }
+  return classes_[__builtin_ctzll(candidates)].back();
+}
+
+uint32_t FreeSpaceDirectory::GetFreeSpace(page_id_t page_id) {
+  std::lock_guard<std::mutex> guard(latch_);
+  auto iter = pages_.find(page_id);
+  return iter == pages_.end() ? 0 : iter->second.free_space_;
+}
+
+size_t FreeSpaceDirectory::GetNumPages() {
+  std::lock_guard<std::mutex> guard(latch_);
+  return pages_.size();
+}
+
+uint32_t FreeSpaceDirectory::ClassOf(uint32_t free_space) const {
+  return static_cast<uint32_t>(
+      std::min<uint64_t>(static_cast<uint64_t>(free_space) * NUM_CLASSES / page_size_, NUM_CLASSES - 1));
+}
+
+void FreeSpaceDirectory::RemoveFromClass(const Entry &entry) {
+  // 和末尾交换再弹出，O(1)
+  auto &pages = classes_[entry.class_];
+  page_id_t moved = pages.back();
+  pages[entry.index_] = moved;
+  pages_[moved].index_ = entry.index_;
+  pages.pop_back();
+  if (pages.empty()) {
+    non_empty_classes_ &= ~(uint64_t{1} << entry.class_);
+  }
+}
+
+}  // namespace bustub
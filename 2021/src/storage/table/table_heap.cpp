@@ -11,6 +11,9 @@
 //===----------------------------------------------------------------------===//
 
 #include <cassert>
+#include <memory>
+#include <utility>
+#include <vector>
 
 #include "common/logger.h"
 #include "storage/table/table_heap.h"
@@ -31,65 +34,128 @@ TableHeap::TableHeap(BufferPoolManager *buffer_pool_manager, LockManager *lock_m
   auto first_page = reinterpret_cast<TablePage *>(buffer_pool_manager_->NewPage(&first_page_id_));
   BUSTUB_ASSERT(first_page != nullptr, "Couldn't create a page for the table heap.");
   first_page->WLatch();
-  first_page->Init(first_page_id_, PAGE_SIZE, INVALID_LSN, log_manager_, txn);
+  first_page->Init(first_page_id_, first_page->GetPageSize(), INVALID_LSN, log_manager_, txn);
   first_page->WUnlatch();
   buffer_pool_manager_->UnpinPage(first_page_id_, true);
+  GetFreeSpaceDirectory();
 }
 
-bool TableHeap::InsertTuple(const Tuple &tuple, RID *rid, Transaction *txn) {
-  if (tuple.size_ + 32 > PAGE_SIZE) {  // larger than one page size
-    txn->SetState(TransactionState::ABORTED);
-    return false;
+bool TableHeap::InsertTuple(const Tuple &tuple, RID *rid, Transaction *txn, BufferAccessStrategy *strategy) {
+  return InsertTuples(&tuple, 1, rid, txn, strategy, false);
+}
+
+bool TableHeap::InsertTuples(const std::vector<Tuple> &tuples, std::vector<RID> *rids, Transaction *txn,
+                             BufferAccessStrategy *strategy) {
+  rids->resize(tuples.size());
+  return InsertTuples(tuples.data(), tuples.size(), rids->data(), txn, strategy, false);
+}
+
+bool TableHeap::InsertTuples(const Tuple *tuples, size_t num_tuples, RID *rids, Transaction *txn,
+                             BufferAccessStrategy *strategy, bool is_moved) {
+  for (size_t i = 0; i < num_tuples; i++) {
+    if (tuples[i].size_ + 32 > buffer_pool_manager_->GetPageSize()) {  // larger than one page size
+      txn->SetState(TransactionState::ABORTED);
+      return false;
+    }
+  }
+
+  // Fill the pages the free-space directory knows to have room. If another insert got there first, the directory is
+  // corrected with the free space actually left and asked again.
+  FreeSpaceDirectory *free_space = GetFreeSpaceDirectory();
+  size_t num_inserted = 0;
+  while (num_inserted < num_tuples) {
+    auto page_id = free_space->FindPage(TablePage::GetSpaceNeeded(tuples[num_inserted].size_));
+    if (page_id == INVALID_PAGE_ID) {
+      break;
+    }
+    auto page = static_cast<TablePage *>(buffer_pool_manager_->FetchPage(page_id));
+    if (page == nullptr) {
+      txn->SetState(TransactionState::ABORTED);
+      return false;
+    }
+    page->WLatch();
+    size_t num_filled = FillPage(page, tuples, num_tuples, rids, &num_inserted, txn, is_moved);
+    page->WUnlatch();
+    buffer_pool_manager_->UnpinPage(page_id, num_filled > 0);
+  }
+  if (num_inserted == num_tuples) {
+    return true;
   }
 
-  auto cur_page = static_cast<TablePage *>(buffer_pool_manager_->FetchPage(first_page_id_));
+  // No page is known to have room for the rest: fill the last page, then append new ones.
+  auto cur_page = static_cast<TablePage *>(buffer_pool_manager_->FetchPage(last_page_id_));
   if (cur_page == nullptr) {
     txn->SetState(TransactionState::ABORTED);
     return false;
   }
 
   cur_page->WLatch();
-  // Insert into the first page with enough space. If no such page exists, create a new page and insert into that.
-  // INVARIANT: cur_page is WLatched if you leave the loop normally.
-  while (!cur_page->InsertTuple(tuple, rid, txn, lock_manager_, log_manager_)) {
+  // A concurrent insert may have appended pages since we read last_page_id_, so follow the list to its end.
+  // INVARIANT: cur_page is WLatched and has been filled if you leave the loop normally.
+  bool is_dirty = FillPage(cur_page, tuples, num_tuples, rids, &num_inserted, txn, is_moved) > 0;
+  while (num_inserted < num_tuples) {
     auto next_page_id = cur_page->GetNextPageId();
     // If the next page is a valid page,
     if (next_page_id != INVALID_PAGE_ID) {
       // Unlatch and unpin the current page.
       cur_page->WUnlatch();
-      buffer_pool_manager_->UnpinPage(cur_page->GetTablePageId(), false);
+      buffer_pool_manager_->UnpinPage(cur_page->GetTablePageId(), is_dirty);
       // And repeat the process with the next page.
       cur_page = static_cast<TablePage *>(buffer_pool_manager_->FetchPage(next_page_id));
       cur_page->WLatch();
     } else {
       // Otherwise we have run out of valid pages. We need to create a new page.
-      auto new_page = static_cast<TablePage *>(buffer_pool_manager_->NewPage(&next_page_id));
+      // Only the appended pages go to the ring: pages with room are revisited by later inserts through the
+      // free-space directory, and reading those into a ring of frames would keep evicting them.
+      auto new_page =
+          static_cast<TablePage *>(buffer_pool_manager_->NewPageWithStrategy(&next_page_id, strategy));
       // If we could not create a new page,
       if (new_page == nullptr) {
         // Then life sucks and we abort the transaction.
         cur_page->WUnlatch();
-        buffer_pool_manager_->UnpinPage(cur_page->GetTablePageId(), false);
+        buffer_pool_manager_->UnpinPage(cur_page->GetTablePageId(), is_dirty);
         txn->SetState(TransactionState::ABORTED);
         return false;
       }
       // Otherwise we were able to create a new page. We initialize it now.
       new_page->WLatch();
       cur_page->SetNextPageId(next_page_id);
-      new_page->Init(next_page_id, PAGE_SIZE, cur_page->GetTablePageId(), log_manager_, txn);
+      new_page->Init(next_page_id, new_page->GetPageSize(), cur_page->GetTablePageId(), log_manager_, txn);
+      last_page_id_ = next_page_id;
       cur_page->WUnlatch();
       buffer_pool_manager_->UnpinPage(cur_page->GetTablePageId(), true);
       cur_page = new_page;
     }
+    is_dirty = FillPage(cur_page, tuples, num_tuples, rids, &num_inserted, txn, is_moved) > 0;
   }
-  // This line has caused most of us to double-take and "whoa double unlatch".
-  // We are not, in fact, double unlatching. See the invariant above.
   cur_page->WUnlatch();
-  buffer_pool_manager_->UnpinPage(cur_page->GetTablePageId(), true);
-  // Update the transaction's write set.
-  txn->GetWriteSet()->emplace_back(*rid, WType::INSERT, Tuple{}, this);
+  buffer_pool_manager_->UnpinPage(cur_page->GetTablePageId(), is_dirty);
   return true;
 }
 
+size_t TableHeap::FillPage(TablePage *page, const Tuple *tuples, size_t num_tuples, RID *rids, size_t *next_tuple,
+                           Transaction *txn, bool is_moved) {
+  // 1. 按顺序往页里插，直到放不下或者插完
+  // 2. 记下这一页的空闲空间
+  // 3. 这一页插入的行一次性追加到写集合；挪过来的元组归转发桩管，不进写集合
+  size_t first = *next_tuple;
+  while (*next_tuple < num_tuples &&
+         page->InsertTuple(tuples[*next_tuple], &rids[*next_tuple], txn, lock_manager_, log_manager_)) {
+    if (is_moved) {
+      page->SetMoved(rids[*next_tuple]);
+    }
+    ++*next_tuple;
+  }
+  UpdateFreeSpace(page);
+  if (*next_tuple > first && !is_moved) {
+    auto write_set = txn->GetWriteSet();
+    for (size_t i = first; i < *next_tuple; i++) {
+      write_set->emplace_back(rids[i], WType::INSERT, Tuple{}, this);
+    }
+  }
+  return *next_tuple - first;
+}
+
 bool TableHeap::MarkDelete(const RID &rid, Transaction *txn) {
   // TODO(Amadou): remove empty page
   // Find the page which contains the tuple.
@@ -110,6 +176,9 @@ bool TableHeap::MarkDelete(const RID &rid, Transaction *txn) {
 }
 
 bool TableHeap::UpdateTuple(const Tuple &tuple, const RID &rid, Transaction *txn) {
+  // 1. 原地更新，放不下就先整理页面再试一次
+  // 2. 元组已经挪走了，到转发桩指向的页上原地更新
+  // 3. 还是放不下，新值挪到别的页，原来的槽变成（或者改指向）转发桩，RID不变
   // Find the page which contains the tuple.
   auto page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId()));
   // If the page could not be found, then abort the transaction.
@@ -119,27 +188,116 @@ bool TableHeap::UpdateTuple(const Tuple &tuple, const RID &rid, Transaction *txn
   }
   // Update the tuple; but first save the old value for rollbacks.
   Tuple old_tuple;
+  RID forward_rid;
   page->WLatch();
-  bool is_updated = page->UpdateTuple(tuple, &old_tuple, rid, txn, lock_manager_, log_manager_);
+  bool is_live = page->GetTuple(rid, &old_tuple, txn, lock_manager_);
+  bool is_forwarded = is_live && page->GetForwardRid(rid, &forward_rid);
+  bool is_updated = is_live && !is_forwarded && UpdateInPage(page, tuple, &old_tuple, rid, txn);
   page->WUnlatch();
   buffer_pool_manager_->UnpinPage(page->GetTablePageId(), is_updated);
+
+  if (is_live && !is_updated && txn->GetState() != TransactionState::ABORTED) {
+    is_updated = is_forwarded ? UpdateForwardedTuple(tuple, &old_tuple, rid, forward_rid, txn)
+                              : MoveTuple(tuple, rid, RID(), txn);
+  }
   // Update the transaction's write set.
   if (is_updated && txn->GetState() != TransactionState::ABORTED) {
+    old_tuple.rid_ = rid;
     txn->GetWriteSet()->emplace_back(rid, WType::UPDATE, old_tuple, this);
   }
   return is_updated;
 }
 
+bool TableHeap::UpdateInPage(TablePage *page, const Tuple &tuple, Tuple *old_tuple, const RID &rid,
+                             Transaction *txn) {
+  bool is_updated = page->UpdateTuple(tuple, old_tuple, rid, txn, lock_manager_, log_manager_);
+  if (!is_updated && txn->GetState() != TransactionState::ABORTED && page->Compact() > 0) {
+    is_updated = page->UpdateTuple(tuple, old_tuple, rid, txn, lock_manager_, log_manager_);
+  }
+  UpdateFreeSpace(page);
+  return is_updated;
+}
+
+bool TableHeap::UpdateForwardedTuple(const Tuple &tuple, Tuple *old_tuple, const RID &rid, const RID &forward_rid,
+                                     Transaction *txn) {
+  auto page = static_cast<TablePage *>(buffer_pool_manager_->FetchPage(forward_rid.GetPageId()));
+  if (page == nullptr) {
+    txn->SetState(TransactionState::ABORTED);
+    return false;
+  }
+  page->WLatch();
+  bool is_found = page->GetTuple(forward_rid, old_tuple, txn, lock_manager_);
+  bool is_updated = is_found && UpdateInPage(page, tuple, old_tuple, forward_rid, txn);
+  page->WUnlatch();
+  buffer_pool_manager_->UnpinPage(forward_rid.GetPageId(), is_updated);
+  if (!is_found || is_updated || txn->GetState() == TransactionState::ABORTED) {
+    return is_updated;
+  }
+  // The tuple outgrew the page it was moved to as well: move it on, so that the stub never points to another stub.
+  return MoveTuple(tuple, rid, forward_rid, txn);
+}
+
+bool TableHeap::MoveTuple(const Tuple &tuple, const RID &rid, const RID &old_forward_rid, Transaction *txn) {
+  // A tuple that does not fit into an empty page cannot be moved either; the caller falls back to delete and insert.
+  if (tuple.size_ + 32 > buffer_pool_manager_->GetPageSize()) {
+    return false;
+  }
+  RID moved_rid;
+  if (!InsertTuples(&tuple, 1, &moved_rid, txn, nullptr, true)) {
+    return false;
+  }
+
+  auto page = static_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId()));
+  if (page == nullptr) {
+    RemoveMovedTuple(moved_rid, txn);
+    txn->SetState(TransactionState::ABORTED);
+    return false;
+  }
+  page->WLatch();
+  bool is_forwarded = page->SetForwardRid(rid, moved_rid);
+  UpdateFreeSpace(page);
+  page->WUnlatch();
+  buffer_pool_manager_->UnpinPage(rid.GetPageId(), is_forwarded);
+
+  // Not even the stub fits: give up like an update that does not fit.
+  if (!is_forwarded) {
+    RemoveMovedTuple(moved_rid, txn);
+    return false;
+  }
+  if (old_forward_rid.GetPageId() != INVALID_PAGE_ID) {
+    RemoveMovedTuple(old_forward_rid, txn);
+  }
+  return true;
+}
+
+void TableHeap::RemoveMovedTuple(const RID &moved_rid, Transaction *txn) {
+  auto page = static_cast<TablePage *>(buffer_pool_manager_->FetchPage(moved_rid.GetPageId()));
+  BUSTUB_ASSERT(page != nullptr, "Couldn't find the page a tuple was moved to.");
+  page->WLatch();
+  page->ApplyDelete(moved_rid, txn, log_manager_);
+  page->Compact();
+  UpdateFreeSpace(page);
+  page->WUnlatch();
+  buffer_pool_manager_->UnpinPage(moved_rid.GetPageId(), true);
+}
+
 void TableHeap::ApplyDelete(const RID &rid, Transaction *txn) {
   // Find the page which contains the tuple.
   auto page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId()));
   BUSTUB_ASSERT(page != nullptr, "Couldn't find a page containing that RID.");
-  // Delete the tuple from the page.
+  // Delete the tuple from the page, and the tuple it forwards to if it was moved.
+  RID forward_rid;
   page->WLatch();
+  bool is_forwarded = page->GetForwardRid(rid, &forward_rid);
   page->ApplyDelete(rid, txn, log_manager_);
   lock_manager_->Unlock(txn, rid);
+  page->Compact();
+  UpdateFreeSpace(page);
   page->WUnlatch();
   buffer_pool_manager_->UnpinPage(page->GetTablePageId(), true);
+  if (is_forwarded) {
+    RemoveMovedTuple(forward_rid, txn);
+  }
 }
 
 void TableHeap::RollbackDelete(const RID &rid, Transaction *txn) {
@@ -162,20 +320,97 @@ bool TableHeap::GetTuple(const RID &rid, Tuple *tuple, Transaction *txn) {
     return false;
   }
   // Read the tuple from the page.
+  RID forward_rid;
   page->RLatch();
   bool res = page->GetTuple(rid, tuple, txn, lock_manager_);
+  bool is_forwarded = res && page->GetForwardRid(rid, &forward_rid);
   page->RUnlatch();
   buffer_pool_manager_->UnpinPage(rid.GetPageId(), false);
+  if (!is_forwarded) {
+    return res;
+  }
+
+  // The tuple was moved: what we read is the forwarding stub, follow it. The tuple keeps the RID of its home slot;
+  // copy it first, as rid may refer to tuple->rid_ itself.
+  const RID home_rid = rid;
+  auto forward_page = static_cast<TablePage *>(buffer_pool_manager_->FetchPage(forward_rid.GetPageId()));
+  if (forward_page == nullptr) {
+    txn->SetState(TransactionState::ABORTED);
+    return false;
+  }
+  forward_page->RLatch();
+  res = forward_page->GetTuple(forward_rid, tuple, txn, lock_manager_);
+  forward_page->RUnlatch();
+  buffer_pool_manager_->UnpinPage(forward_rid.GetPageId(), false);
+  tuple->rid_ = home_rid;
   return res;
 }
 
+bool TableHeap::GetTupleView(const RID &rid, TupleView *view, Transaction *txn, BufferAccessStrategy *strategy) {
+  // 1. 先拷贝rid，再放掉view之前看的页，rid可能就是view里元组的rid
+  // 2. 读锁住元组所在页，直接指向页里的数据，页的pin和读锁交给view
+  // 3. 读到的是转发桩就放掉这一页，去看搬走的元组，元组的rid还是原来的槽位
+  const RID home_rid = rid;
+  view->Release();
+  RID slot_rid = home_rid;
+  for (int hops = 0; hops < 2; hops++) {
+    auto page = static_cast<TablePage *>(buffer_pool_manager_->FetchPageWithStrategy(slot_rid.GetPageId(), strategy));
+    if (page == nullptr) {
+      txn->SetState(TransactionState::ABORTED);
+      return false;
+    }
+    page->RLatch();
+    Tuple tuple;
+    RID forward_rid;
+    if (!page->ViewTuple(slot_rid, &tuple, txn, lock_manager_)) {
+      page->RUnlatch();
+      buffer_pool_manager_->UnpinPage(slot_rid.GetPageId(), false);
+      return false;
+    }
+    if (hops == 0 && page->GetForwardRid(slot_rid, &forward_rid)) {
+      page->RUnlatch();
+      buffer_pool_manager_->UnpinPage(slot_rid.GetPageId(), false);
+      slot_rid = forward_rid;
+      continue;
+    }
+    tuple.rid_ = home_rid;
+    *view = TupleView(buffer_pool_manager_, page, tuple);
+    return true;
+  }
+  return false;
+}
+
+FreeSpaceDirectory *TableHeap::GetFreeSpaceDirectory() {
+  // 第一次用到时沿链表走一遍，记下每页的空闲空间和最后一页
+  std::call_once(free_space_once_, [&] {
+    free_space_ = std::make_unique<FreeSpaceDirectory>(buffer_pool_manager_->GetPageSize());
+    auto page_id = first_page_id_;
+    while (page_id != INVALID_PAGE_ID) {
+      auto page = static_cast<TablePage *>(buffer_pool_manager_->FetchPage(page_id));
+      if (page == nullptr) {
+        break;
+      }
+      page->RLatch();
+      free_space_->Update(page_id, page->GetFreeSpaceRemaining());
+      last_page_id_ = page_id;
+      auto next_page_id = page->GetNextPageId();
+      page->RUnlatch();
+      buffer_pool_manager_->UnpinPage(page_id, false);
+      page_id = next_page_id;
+    }
+  });
+  return free_space_.get();
+}
+
 TableIterator TableHeap::Begin(Transaction *txn) {
   // Start an iterator from the first page.
   // TODO(Wuwen): Hacky fix for now. Removing empty pages is a better way to handle this.
+  // A scan recycles a small ring of frames, instead of pushing the working set of other transactions out of the pool.
   RID rid;
+  auto strategy = std::make_shared<BufferAccessStrategy>(BufferAccessType::BULK_READ);
   auto page_id = first_page_id_;
   while (page_id != INVALID_PAGE_ID) {
-    auto page = static_cast<TablePage *>(buffer_pool_manager_->FetchPage(page_id));
+    auto page = static_cast<TablePage *>(buffer_pool_manager_->FetchPageWithStrategy(page_id, strategy.get()));
     page->RLatch();
     // If this fails because there is no tuple, then RID will be the default-constructed value, which means EOF.
     auto found_tuple = page->GetFirstTupleRid(&rid);
@@ -186,7 +421,7 @@ TableIterator TableHeap::Begin(Transaction *txn) {
     }
     page_id = page->GetNextPageId();
   }
-  return TableIterator(this, rid, txn);
+  return TableIterator(this, rid, txn, std::move(strategy));
 }
 
 TableIterator TableHeap::End() { return TableIterator(this, RID(INVALID_PAGE_ID, 0), nullptr); }
@@ -10,60 +10,109 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
 #include <cassert>
+#include <memory>
+#include <utility>
 
 #include "storage/table/table_heap.h"
 
 namespace bustub {
 
-TableIterator::TableIterator(TableHeap *table_heap, RID rid, Transaction *txn)
-    : table_heap_(table_heap), tuple_(new Tuple(rid)), txn_(txn) {
-  if (rid.GetPageId() != INVALID_PAGE_ID) {
-    table_heap_->GetTuple(tuple_->rid_, tuple_, txn_);
-  }
-}
+TableIterator::TableIterator(TableHeap *table_heap, RID rid, Transaction *txn,
+                             std::shared_ptr<BufferAccessStrategy> strategy)
+    : table_heap_(table_heap), tuple_(new Tuple(rid)), txn_(txn), strategy_(std::move(strategy)) {}
 
-const Tuple &TableIterator::operator*() {
-  assert(*this != table_heap_->End());
-  return *tuple_;
-}
+const Tuple &TableIterator::operator*() { return *operator->(); }
 
 Tuple *TableIterator::operator->() {
   assert(*this != table_heap_->End());
+  if (!loaded_) {
+    table_heap_->GetTuple(tuple_->rid_, tuple_, txn_);
+    loaded_ = true;
+  }
   return tuple_;
 }
 
+bool TableIterator::GetTupleView(TupleView *view) {
+  assert(*this != table_heap_->End());
+  return table_heap_->GetTupleView(tuple_->rid_, view, txn_, strategy_.get());
+}
+
 TableIterator &TableIterator::operator++() {
   BufferPoolManager *buffer_pool_manager = table_heap_->buffer_pool_manager_;
-  auto cur_page = static_cast<TablePage *>(buffer_pool_manager->FetchPage(tuple_->rid_.GetPageId()));
+  auto cur_page = static_cast<TablePage *>(
+      buffer_pool_manager->FetchPageWithStrategy(tuple_->rid_.GetPageId(), strategy_.get()));
   cur_page->RLatch();
   assert(cur_page != nullptr);  // all pages are pinned
 
   RID next_tuple_rid;
+  int pages_advanced = 0;
   if (!cur_page->GetNextTupleRid(tuple_->rid_,
                                  &next_tuple_rid)) {  // end of this page
     while (cur_page->GetNextPageId() != INVALID_PAGE_ID) {
-      auto next_page = static_cast<TablePage *>(buffer_pool_manager->FetchPage(cur_page->GetNextPageId()));
+      auto next_page = static_cast<TablePage *>(
+          buffer_pool_manager->FetchPageWithStrategy(cur_page->GetNextPageId(), strategy_.get()));
       cur_page->RUnlatch();
       buffer_pool_manager->UnpinPage(cur_page->GetTablePageId(), false);
       cur_page = next_page;
       cur_page->RLatch();
+      pages_advanced++;
       if (cur_page->GetFirstTupleRid(&next_tuple_rid)) {
         break;
       }
     }
   }
   tuple_->rid_ = next_tuple_rid;
+  loaded_ = false;
+  page_id_t next_page_id = cur_page->GetNextPageId();
 
-  if (*this != table_heap_->End()) {
-    table_heap_->GetTuple(tuple_->rid_, tuple_, txn_);
-  }
-  // release until copy the tuple
   cur_page->RUnlatch();
   buffer_pool_manager->UnpinPage(cur_page->GetTablePageId(), false);
+
+  if (*this != table_heap_->End() && (pages_advanced > 0 || prefetch_ahead_ == 0)) {
+    ReadAhead(next_page_id, pages_advanced);
+  }
   return *this;
 }
 
+void TableIterator::ReadAhead(page_id_t next_page_id, int pages_advanced) {
+  // 1. 走过的页从预读窗口里去掉
+  // 2. 窗口空了，从当前页的下一页重新开始
+  // 3. 预读的最远页已经读进来了，就顺着它的next继续预读，直到窗口填满或者最远页还在读
+  BufferPoolManager *buffer_pool_manager = table_heap_->buffer_pool_manager_;
+  prefetch_ahead_ = std::max(prefetch_ahead_ - pages_advanced, 0);
+  if (prefetch_ahead_ == 0) {
+    if (next_page_id == INVALID_PAGE_ID) {
+      return;
+    }
+    buffer_pool_manager->PrefetchPage(next_page_id, strategy_.get());
+    prefetch_frontier_ = next_page_id;
+    prefetch_ahead_ = 1;
+  }
+
+  while (prefetch_ahead_ < SCAN_PREFETCH_DEPTH && prefetch_frontier_ != INVALID_PAGE_ID) {
+    if (!buffer_pool_manager->PrefetchPage(prefetch_frontier_, strategy_.get())) {
+      return;
+    }
+    auto frontier_page =
+        static_cast<TablePage *>(buffer_pool_manager->FetchPageWithStrategy(prefetch_frontier_, strategy_.get()));
+    if (frontier_page == nullptr) {
+      return;
+    }
+    frontier_page->RLatch();
+    page_id_t frontier_next_page_id = frontier_page->GetNextPageId();
+    frontier_page->RUnlatch();
+    buffer_pool_manager->UnpinPage(prefetch_frontier_, false);
+
+    prefetch_frontier_ = frontier_next_page_id;
+    if (prefetch_frontier_ != INVALID_PAGE_ID) {
+      buffer_pool_manager->PrefetchPage(prefetch_frontier_, strategy_.get());
+      prefetch_ahead_++;
+    }
+  }
+}
+
 TableIterator TableIterator::operator++(int) {
   TableIterator clone(*this);
   ++(*this);
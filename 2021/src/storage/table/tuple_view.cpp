@@ -0,0 +1,53 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// tuple_view.cpp
+//
+// Identification: src/storage/table/tuple_view.cpp
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "storage/table/tuple_view.h"
+
+#include <cstring>
+
+namespace bustub {
+
+TupleView &TupleView::operator=(TupleView &&other) noexcept {
+  if (this != &other) {
+    Release();
+    buffer_pool_manager_ = other.buffer_pool_manager_;
+    page_ = other.page_;
+    tuple_ = other.tuple_;
+    other.buffer_pool_manager_ = nullptr;
+    other.page_ = nullptr;
+    other.tuple_ = Tuple();
+  }
+  return *this;
+}
+
+Tuple TupleView::Materialize() const {
+  Tuple tuple;
+  tuple.rid_ = tuple_.rid_;
+  tuple.size_ = tuple_.size_;
+  tuple.data_ = new char[tuple.size_];
+  memcpy(tuple.data_, tuple_.data_, tuple.size_);
+  tuple.allocated_ = true;
+  return tuple;
+}
+
+void TupleView::Release() {
+  if (page_ == nullptr) {
+    return;
+  }
+  page_id_t page_id = page_->GetPageId();
+  page_->RUnlatch();
+  buffer_pool_manager_->UnpinPage(page_id, false);
+  page_ = nullptr;
+  tuple_ = Tuple();
+}
+
+}  // namespace bustub
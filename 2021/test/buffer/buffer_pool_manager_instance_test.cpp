@@ -11,9 +11,15 @@
 //===----------------------------------------------------------------------===//
 
 #include "buffer/buffer_pool_manager_instance.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>  // NOLINT
 #include <cstdio>
+#include <cstring>
 #include <random>
 #include <string>
+#include <thread>  // NOLINT
+#include <vector>
 #include "buffer/buffer_pool_manager.h"
 #include "gtest/gtest.h"
 
@@ -141,4 +147,349 @@ TEST(BufferPoolManagerInstanceTest, SampleTest) {
   delete disk_manager;
 }
 
+// NOLINTNEXTLINE
+TEST(BufferPoolManagerInstanceTest, ConcurrentFetchTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 10;
+  const int num_pages = 20;
+  const int num_threads = 8;
+  const int num_rounds = 200;
+
+  auto *disk_manager = new DiskManager(db_name);
+  auto *bpm = new BufferPoolManagerInstance(buffer_pool_size, disk_manager);
+
+  // Stamp every page with its own id so that readers can tell a wrong frame apart.
+  for (int i = 0; i < num_pages; ++i) {
+    page_id_t page_id_temp;
+    auto *page = bpm->NewPage(&page_id_temp);
+    ASSERT_NE(nullptr, page);
+    EXPECT_EQ(i, page_id_temp);
+    snprintf(page->GetData(), PAGE_SIZE, "%d", page_id_temp);
+    EXPECT_EQ(true, bpm->UnpinPage(page_id_temp, true));
+  }
+
+  // Scenario: hits on resident pages race with misses that evict other pages.
+  std::vector<std::thread> threads;
+  for (int tid = 0; tid < num_threads; ++tid) {
+    threads.emplace_back([bpm, tid] {
+      for (int round = 0; round < num_rounds; ++round) {
+        page_id_t page_id = (tid + round) % num_pages;
+        auto *page = bpm->FetchPage(page_id);
+        if (page == nullptr) {
+          continue;
+        }
+        EXPECT_EQ(page_id, page->GetPageId());
+        EXPECT_EQ(std::to_string(page_id), std::string(page->GetData()));
+        EXPECT_EQ(true, bpm->UnpinPage(page_id, false));
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  // Scenario: every pin has been released, so the whole pool can be reused.
+  for (size_t i = 0; i < buffer_pool_size; ++i) {
+    page_id_t page_id_temp;
+    EXPECT_NE(nullptr, bpm->NewPage(&page_id_temp));
+  }
+
+  // Shutdown the disk manager and remove the temporary file we created.
+  disk_manager->ShutDown();
+  remove("test.db");
+
+  delete bpm;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST(BufferPoolManagerInstanceTest, FlushThreadTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 10;
+
+  auto *disk_manager = new DiskManager(db_name);
+  auto *bpm = new BufferPoolManagerInstance(buffer_pool_size, disk_manager);
+  bpm->RunFlushThread(0, 0.5);
+
+  // Scenario: dirty every frame while it is pinned, so that the flush thread cannot write anything back yet.
+  for (size_t i = 0; i < buffer_pool_size; ++i) {
+    page_id_t page_id_temp;
+    auto *page = bpm->NewPage(&page_id_temp);
+    ASSERT_NE(nullptr, page);
+    snprintf(page->GetData(), PAGE_SIZE, "%d", page_id_temp);
+  }
+  for (size_t i = 0; i < buffer_pool_size; ++i) {
+    EXPECT_EQ(true, bpm->UnpinPage(i, true));
+  }
+
+  // Scenario: once unpinned, the flush thread writes every dirty page back in the background.
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (bpm->GetNumDirtyPages() > 0 && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  EXPECT_EQ(0, bpm->GetNumDirtyPages());
+  EXPECT_EQ(static_cast<int>(buffer_pool_size), disk_manager->GetNumWrites());
+
+  // Scenario: evicting the clean pages costs no further writes, and the data survives the round trip.
+  bpm->StopFlushThread();
+  for (size_t i = 0; i < buffer_pool_size; ++i) {
+    page_id_t page_id_temp;
+    EXPECT_NE(nullptr, bpm->NewPage(&page_id_temp));
+    EXPECT_EQ(true, bpm->UnpinPage(page_id_temp, false));
+  }
+  EXPECT_EQ(static_cast<int>(buffer_pool_size), disk_manager->GetNumWrites());
+  for (size_t i = 0; i < buffer_pool_size; ++i) {
+    auto *page = bpm->FetchPage(i);
+    ASSERT_NE(nullptr, page);
+    EXPECT_EQ(std::to_string(i), std::string(page->GetData()));
+    EXPECT_EQ(true, bpm->UnpinPage(i, false));
+  }
+
+  // Shutdown the disk manager and remove the temporary file we created.
+  disk_manager->ShutDown();
+  remove("test.db");
+
+  delete bpm;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST(BufferPoolManagerInstanceTest, FlushWhileWritingTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 10;
+  const size_t num_pages = 4;
+
+  auto *disk_manager = new DiskManager(db_name);
+  auto *bpm = new BufferPoolManagerInstance(buffer_pool_size, disk_manager);
+  std::vector<Page *> pages;
+  for (size_t i = 0; i < num_pages; ++i) {
+    page_id_t page_id_temp;
+    pages.push_back(bpm->NewPage(&page_id_temp));
+    ASSERT_NE(nullptr, pages.back());
+  }
+
+  // Scenario: flushes race with writers holding the page latch; every image on disk must be a whole one that
+  // matches its checksum.
+  std::atomic<bool> stop{false};
+  std::thread writer([&] {
+    for (char round = 1; !stop; ++round) {
+      for (auto *page : pages) {
+        page->WLatch();
+        memset(page->GetData(), round, PAGE_SIZE);
+        page->WUnlatch();
+      }
+    }
+  });
+  std::vector<char> buf(PAGE_SIZE);
+  for (int round = 0; round < 200; ++round) {
+    if (round % 10 == 0) {
+      bpm->FlushAllPages();
+    } else {
+      EXPECT_TRUE(bpm->FlushPage(round % num_pages));
+    }
+    for (size_t i = 0; i < num_pages; ++i) {
+      ASSERT_TRUE(disk_manager->ReadPage(i, buf.data()));
+      EXPECT_EQ(PAGE_SIZE, std::count(buf.begin(), buf.end(), buf[0]));
+    }
+  }
+  stop = true;
+  writer.join();
+  for (size_t i = 0; i < num_pages; ++i) {
+    EXPECT_EQ(true, bpm->UnpinPage(i, true));
+  }
+
+  // Shutdown the disk manager and remove the temporary file we created.
+  disk_manager->ShutDown();
+  remove("test.db");
+
+  delete bpm;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST(BufferPoolManagerInstanceTest, PrefetchTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 8;
+
+  auto *disk_manager = new DiskManager(db_name);
+  auto *bpm = new BufferPoolManagerInstance(buffer_pool_size, disk_manager);
+
+  // Scenario: write out twice as many pages as fit in the pool, so that the first half is evicted.
+  const int num_pages = 2 * buffer_pool_size;
+  for (int i = 0; i < num_pages; ++i) {
+    page_id_t page_id_temp;
+    auto *page = bpm->NewPage(&page_id_temp);
+    ASSERT_NE(nullptr, page);
+    snprintf(page->GetData(), PAGE_SIZE, "%d", page_id_temp);
+    EXPECT_EQ(true, bpm->UnpinPage(page_id_temp, true));
+  }
+
+  // Scenario: a resident page needs no prefetch, an evicted one is read in the background.
+  EXPECT_EQ(true, bpm->PrefetchPage(num_pages - 1));
+  EXPECT_EQ(false, bpm->PrefetchPage(0));
+  EXPECT_EQ(false, bpm->PrefetchPage(1));
+
+  // Scenario: fetching a page that is being prefetched waits for the read and sees the data on disk.
+  for (int i = 0; i < num_pages; ++i) {
+    auto *page = bpm->FetchPage(i);
+    ASSERT_NE(nullptr, page);
+    EXPECT_EQ(std::to_string(i), std::string(page->GetData()));
+    EXPECT_EQ(1, page->GetPinCount());
+    EXPECT_EQ(true, bpm->UnpinPage(i, false));
+  }
+
+  // Scenario: a prefetched page that is deleted before it is fetched does not come back.
+  EXPECT_EQ(false, bpm->PrefetchPage(0));
+  EXPECT_EQ(true, bpm->DeletePage(0));
+
+  // Shutdown the disk manager and remove the temporary file we created.
+  disk_manager->ShutDown();
+  remove("test.db");
+
+  delete bpm;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST(BufferPoolManagerInstanceTest, AccessStrategyTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 20;
+  const size_t ring_size = 4;
+
+  auto *disk_manager = new DiskManager(db_name);
+  auto *bpm = new BufferPoolManagerInstance(buffer_pool_size, disk_manager);
+  auto num_resident = [&](page_id_t first_page_id, page_id_t last_page_id) {
+    int count = 0;
+    for (size_t i = 0; i < buffer_pool_size; i++) {
+      page_id_t page_id = bpm->GetPages()[i].GetPageId();
+      count += first_page_id <= page_id && page_id <= last_page_id ? 1 : 0;
+    }
+    return count;
+  };
+
+  // Scenario: the working set of other transactions fills half of the pool.
+  const int num_hot_pages = buffer_pool_size / 2;
+  for (int i = 0; i < num_hot_pages; i++) {
+    page_id_t page_id_temp;
+    auto *page = bpm->NewPage(&page_id_temp);
+    ASSERT_NE(nullptr, page);
+    snprintf(page->GetData(), PAGE_SIZE, "%d", page_id_temp);
+    EXPECT_EQ(true, bpm->UnpinPage(page_id_temp, true));
+  }
+
+  // Scenario: a bulk insert creates many pages, but only ever occupies the frames of its ring.
+  const int num_bulk_pages = 10 * buffer_pool_size;
+  {
+    BufferAccessStrategy strategy(BufferAccessType::BULK_WRITE, ring_size);
+    for (int i = 0; i < num_bulk_pages; i++) {
+      page_id_t page_id_temp;
+      auto *page = bpm->NewPageWithStrategy(&page_id_temp, &strategy);
+      ASSERT_NE(nullptr, page);
+      snprintf(page->GetData(), PAGE_SIZE, "%d", page_id_temp);
+      EXPECT_EQ(true, bpm->UnpinPage(page_id_temp, true));
+    }
+  }
+  EXPECT_EQ(num_hot_pages, num_resident(0, num_hot_pages - 1));
+
+  // Scenario: a scan over the bulk pages reads them back through its own ring, and sees what was written.
+  {
+    BufferAccessStrategy strategy(BufferAccessType::BULK_READ, ring_size);
+    for (int i = num_hot_pages; i < num_hot_pages + num_bulk_pages; i++) {
+      auto *page = bpm->FetchPageWithStrategy(i, &strategy);
+      ASSERT_NE(nullptr, page);
+      EXPECT_EQ(std::to_string(i), std::string(page->GetData()));
+      EXPECT_EQ(true, bpm->UnpinPage(i, false));
+    }
+  }
+  EXPECT_EQ(num_hot_pages, num_resident(0, num_hot_pages - 1));
+
+  // Scenario: a pinned ring frame is not recycled, the ring takes another frame instead.
+  {
+    BufferAccessStrategy strategy(BufferAccessType::BULK_READ, 1);
+    auto *pinned_page = bpm->FetchPageWithStrategy(num_hot_pages, &strategy);
+    ASSERT_NE(nullptr, pinned_page);
+    auto *page = bpm->FetchPageWithStrategy(num_hot_pages + 1, &strategy);
+    ASSERT_NE(nullptr, page);
+    EXPECT_NE(pinned_page, page);
+    EXPECT_EQ(num_hot_pages, pinned_page->GetPageId());
+    EXPECT_EQ(true, bpm->UnpinPage(num_hot_pages, false));
+    EXPECT_EQ(true, bpm->UnpinPage(num_hot_pages + 1, false));
+  }
+
+  // Shutdown the disk manager and remove the temporary file we created.
+  disk_manager->ShutDown();
+  remove("test.db");
+
+  delete bpm;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST(BufferPoolManagerInstanceTest, PageReuseTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 4;
+  const int num_pages = 8;
+
+  auto *disk_manager = new DiskManager(db_name);
+  auto *bpm = new BufferPoolManagerInstance(buffer_pool_size, disk_manager);
+  page_id_t page_id_temp;
+  for (int i = 0; i < num_pages; i++) {
+    auto *page = bpm->NewPage(&page_id_temp);
+    ASSERT_NE(nullptr, page);
+    EXPECT_EQ(i, page_id_temp);
+    snprintf(page->GetData(), PAGE_SIZE, "%d", i);
+    EXPECT_EQ(true, bpm->UnpinPage(i, true));
+  }
+
+  // Scenario: a pinned page cannot be deleted, and its id is not handed out again.
+  auto *pinned_page = bpm->FetchPage(num_pages - 1);
+  ASSERT_NE(nullptr, pinned_page);
+  EXPECT_EQ(false, bpm->DeletePage(num_pages - 1));
+  EXPECT_EQ(0, disk_manager->GetNumFreePages());
+
+  // Scenario: an id that was never allocated is not freed, or it would be handed out twice.
+  EXPECT_EQ(false, bpm->DeletePage(num_pages));
+  EXPECT_EQ(false, bpm->DeletePage(-1));
+  EXPECT_EQ(0, disk_manager->GetNumFreePages());
+
+  // Scenario: deleted pages, resident or not, are reused lowest id first before the file grows.
+  EXPECT_EQ(true, bpm->DeletePage(5));
+  EXPECT_EQ(true, bpm->DeletePage(1));
+  EXPECT_EQ(2, disk_manager->GetNumFreePages());
+  auto *page = bpm->NewPage(&page_id_temp);
+  ASSERT_NE(nullptr, page);
+  EXPECT_EQ(1, page_id_temp);
+  EXPECT_EQ(0, page->GetData()[0]);
+  EXPECT_EQ(true, bpm->UnpinPage(1, true));
+  EXPECT_NE(nullptr, bpm->NewPage(&page_id_temp));
+  EXPECT_EQ(5, page_id_temp);
+  EXPECT_EQ(true, bpm->UnpinPage(5, true));
+  EXPECT_NE(nullptr, bpm->NewPage(&page_id_temp));
+  EXPECT_EQ(num_pages, page_id_temp);
+  EXPECT_EQ(true, bpm->UnpinPage(num_pages, true));
+
+  // Scenario: a failed NewPage does not use up a page id.
+  std::vector<Page *> pinned;
+  for (size_t i = 1; i < buffer_pool_size; i++) {
+    pinned.push_back(bpm->NewPage(&page_id_temp));
+    ASSERT_NE(nullptr, pinned.back());
+  }
+  EXPECT_EQ(nullptr, bpm->NewPage(&page_id_temp));
+  for (auto *pinned_new_page : pinned) {
+    EXPECT_EQ(true, bpm->UnpinPage(pinned_new_page->GetPageId(), true));
+  }
+  EXPECT_EQ(true, bpm->UnpinPage(num_pages - 1, false));
+  EXPECT_NE(nullptr, bpm->NewPage(&page_id_temp));
+  EXPECT_EQ(num_pages + static_cast<int>(buffer_pool_size), page_id_temp);
+  EXPECT_EQ(true, bpm->UnpinPage(page_id_temp, false));
+
+  // Shutdown the disk manager and remove the temporary file we created.
+  disk_manager->ShutDown();
+  remove("test.db");
+  remove("test.fsm");
+
+  delete bpm;
+  delete disk_manager;
+}
+
 }  // namespace bustub
@@ -0,0 +1,163 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// buffer_pool_stats_test.cpp
+//
+// Identification: test/buffer/buffer_pool_stats_test.cpp
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include <cstdio>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "buffer/buffer_pool_manager_instance.h"
+#include "buffer/buffer_pool_stats.h"
+#include "buffer/parallel_buffer_pool_manager.h"
+#include "gtest/gtest.h"
+
+namespace bustub {
+
+// NOLINTNEXTLINE
+TEST(BufferPoolStatsTest, SampleTest) {
+  BufferPoolStats stats;
+  EXPECT_EQ(0, stats.Snapshot().HitRatio());
+  EXPECT_EQ(0, stats.Snapshot().Get(BufferPoolLatency::FETCH_MISS).PercentileNs(0.5));
+
+  // Scenario: counts from many threads all end up in the snapshot.
+  const int num_threads = 8;
+  const int num_increments = 1000;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < num_threads; i++) {
+    threads.emplace_back([&stats] {
+      for (int j = 0; j < num_increments; j++) {
+        stats.Increment(BufferPoolCounter::HITS);
+        if (j % 4 == 0) {
+          stats.Increment(BufferPoolCounter::MISSES);
+        }
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  BufferPoolStatsSnapshot snapshot = stats.Snapshot();
+  EXPECT_EQ(num_threads * num_increments, snapshot.Get(BufferPoolCounter::HITS));
+  EXPECT_EQ(num_threads * num_increments / 4, snapshot.Get(BufferPoolCounter::MISSES));
+  EXPECT_DOUBLE_EQ(0.8, snapshot.HitRatio());
+
+  // Scenario: latencies land in power-of-two buckets, and percentiles are upper bounds of the samples.
+  auto now = BufferPoolStats::Now();
+  stats.RecordLatency(BufferPoolLatency::EVICT, now - std::chrono::microseconds(1));
+  stats.RecordLatency(BufferPoolLatency::EVICT, now - std::chrono::milliseconds(1));
+  const LatencyHistogramSnapshot &evict = stats.Snapshot().Get(BufferPoolLatency::EVICT);
+  EXPECT_EQ(2, evict.count_);
+  EXPECT_GE(evict.PercentileNs(0), 1000);
+  EXPECT_LT(evict.PercentileNs(0), 1000000);
+  EXPECT_GE(evict.PercentileNs(0.99), 1000000);
+  EXPECT_GE(evict.MeanNs(), 500000);
+
+  // Scenario: snapshots add up.
+  snapshot += stats.Snapshot();
+  EXPECT_EQ(2 * num_threads * num_increments, snapshot.Get(BufferPoolCounter::HITS));
+  EXPECT_EQ(2, snapshot.Get(BufferPoolLatency::EVICT).count_);
+}
+
+// NOLINTNEXTLINE
+TEST(BufferPoolStatsTest, BufferPoolInstanceTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 2;
+
+  auto *disk_manager = new DiskManager(db_name);
+  auto *bpm = new BufferPoolManagerInstance(buffer_pool_size, disk_manager);
+
+  // Scenario: fill the pool with dirty pages.
+  page_id_t page_ids[3];
+  for (auto &page_id : page_ids) {
+    ASSERT_NE(nullptr, bpm->NewPage(&page_id));
+    ASSERT_TRUE(bpm->UnpinPage(page_id, true));
+  }
+  // The third page evicted the first, which was dirty.
+  BufferPoolStatsSnapshot stats = bpm->GetStats();
+  EXPECT_EQ(1, stats.Get(BufferPoolCounter::EVICTIONS));
+  EXPECT_EQ(1, stats.Get(BufferPoolCounter::DIRTY_EVICTIONS));
+  EXPECT_EQ(1, stats.Get(BufferPoolLatency::EVICT).count_);
+
+  // Scenario: one hit and one miss, which evicts another dirty page.
+  int reads = disk_manager->GetNumReads();
+  ASSERT_NE(nullptr, bpm->FetchPage(page_ids[2]));
+  ASSERT_TRUE(bpm->UnpinPage(page_ids[2], false));
+  ASSERT_NE(nullptr, bpm->FetchPage(page_ids[0]));
+  ASSERT_TRUE(bpm->UnpinPage(page_ids[0], false));
+  EXPECT_EQ(reads + 1, disk_manager->GetNumReads());
+  stats = bpm->GetStats();
+  EXPECT_EQ(1, stats.Get(BufferPoolCounter::HITS));
+  EXPECT_EQ(1, stats.Get(BufferPoolCounter::MISSES));
+  EXPECT_EQ(1, stats.Get(BufferPoolLatency::FETCH_MISS).count_);
+  EXPECT_EQ(2, stats.Get(BufferPoolCounter::DIRTY_EVICTIONS));
+
+  // Scenario: flushing the remaining dirty page is counted.
+  EXPECT_TRUE(bpm->FlushPage(page_ids[2]));
+  stats = bpm->GetStats();
+  EXPECT_EQ(1, stats.Get(BufferPoolCounter::FLUSHES));
+  EXPECT_EQ(1, stats.Get(BufferPoolLatency::FLUSH).count_);
+  EXPECT_FALSE(stats.ToString().empty());
+
+  // Scenario: writing back pages that are already clean is not counted as a flush.
+  EXPECT_TRUE(bpm->FlushPage(page_ids[2]));
+  bpm->FlushAllPages();
+  stats = bpm->GetStats();
+  EXPECT_EQ(1, stats.Get(BufferPoolCounter::FLUSHES));
+
+  disk_manager->ShutDown();
+  remove("test.db");
+
+  delete bpm;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST(BufferPoolStatsTest, ParallelBufferPoolTest) {
+  const std::string db_name = "test.db";
+  const size_t num_instances = 3;
+  const size_t buffer_pool_size = 4;
+
+  auto *disk_manager = new DiskManager(db_name);
+  auto *bpm = new ParallelBufferPoolManager(num_instances, buffer_pool_size, disk_manager);
+
+  // Scenario: every page is fetched twice, and the aggregate is the sum of the instances.
+  std::vector<page_id_t> page_ids(num_instances * 2);
+  for (auto &page_id : page_ids) {
+    ASSERT_NE(nullptr, bpm->NewPage(&page_id));
+    ASSERT_TRUE(bpm->UnpinPage(page_id, false));
+  }
+  for (int round = 0; round < 2; round++) {
+    for (auto page_id : page_ids) {
+      ASSERT_NE(nullptr, bpm->FetchPage(page_id));
+      ASSERT_TRUE(bpm->UnpinPage(page_id, false));
+    }
+  }
+
+  std::vector<BufferPoolStatsSnapshot> instance_stats;
+  BufferPoolStatsSnapshot stats = bpm->GetStats(&instance_stats);
+  ASSERT_EQ(num_instances, instance_stats.size());
+  EXPECT_EQ(2 * page_ids.size(), stats.Get(BufferPoolCounter::HITS));
+  EXPECT_EQ(0, stats.Get(BufferPoolCounter::MISSES));
+  uint64_t hits = 0;
+  for (const auto &instance : instance_stats) {
+    hits += instance.Get(BufferPoolCounter::HITS);
+  }
+  EXPECT_EQ(stats.Get(BufferPoolCounter::HITS), hits);
+  EXPECT_DOUBLE_EQ(1, stats.HitRatio());
+
+  disk_manager->ShutDown();
+  remove("test.db");
+
+  delete bpm;
+  delete disk_manager;
+}
+
+}  // namespace bustub
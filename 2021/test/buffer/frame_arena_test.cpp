@@ -0,0 +1,59 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// frame_arena_test.cpp
+//
+// Identification: test/buffer/frame_arena_test.cpp
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "buffer/frame_arena.h"
+#include "gtest/gtest.h"
+
+namespace bustub {
+
+// NOLINTNEXTLINE
+TEST(FrameArenaTest, SampleTest) {
+  // Scenario: both a small arena and one spanning several huge pages.
+  for (size_t num_frames : {size_t{3}, 3 * FrameArena::HUGE_PAGE_SIZE / PAGE_SIZE + 1}) {
+    FrameArena arena(num_frames);
+
+    // Scenario: frames are contiguous, aligned for O_DIRECT and zeroed.
+    std::vector<char> zeros(PAGE_SIZE, 0);
+    for (size_t i = 0; i < num_frames; i++) {
+      char *data = arena.GetFrameData(static_cast<frame_id_t>(i));
+      EXPECT_EQ(arena.GetFrameData(0) + i * PAGE_SIZE, data);
+      EXPECT_EQ(0, reinterpret_cast<uintptr_t>(data) % DIRECT_IO_ALIGNMENT);
+      EXPECT_EQ(0, std::memcmp(data, zeros.data(), PAGE_SIZE));
+    }
+
+    // Scenario: every frame can be written without disturbing its neighbours.
+    for (size_t i = 0; i < num_frames; i++) {
+      std::memset(arena.GetFrameData(static_cast<frame_id_t>(i)), static_cast<int>(i % 128), PAGE_SIZE);
+    }
+    for (size_t i = 0; i < num_frames; i++) {
+      char *data = arena.GetFrameData(static_cast<frame_id_t>(i));
+      EXPECT_EQ(static_cast<char>(i % 128), data[0]);
+      EXPECT_EQ(static_cast<char>(i % 128), data[PAGE_SIZE - 1]);
+    }
+  }
+}
+
+// NOLINTNEXTLINE
+TEST(FrameArenaTest, NumaNodeTest) {
+  // Scenario: binding to an existing node works where the kernel supports it, and never breaks the arena.
+  std::vector<int> numa_nodes = FrameArena::GetNumaNodes();
+  int numa_node = numa_nodes.empty() ? 0 : numa_nodes.front();
+  FrameArena arena(4, numa_node);
+  std::memset(arena.GetFrameData(3), 'x', PAGE_SIZE);
+  EXPECT_EQ('x', arena.GetFrameData(3)[PAGE_SIZE - 1]);
+}
+
+}  // namespace bustub
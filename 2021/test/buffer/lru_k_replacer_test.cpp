@@ -0,0 +1,194 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// lru_k_replacer_test.cpp
+//
+// Identification: test/buffer/lru_k_replacer_test.cpp
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include <cstdio>
+#include <string>
+
+#include "buffer/buffer_pool_manager_instance.h"
+#include "buffer/lru_k_replacer.h"
+#include "gtest/gtest.h"
+
+namespace bustub {
+
+// NOLINTNEXTLINE
+TEST(LRUKReplacerTest, SampleTest) {
+  LRUKReplacer lru_k_replacer(7, 2, 0);
+
+  // Scenario: access frames 1 and 2 twice, then scan over 3, 4 and 5 once each.
+  for (int round = 0; round < 2; round++) {
+    for (frame_id_t frame_id : {1, 2}) {
+      lru_k_replacer.Pin(frame_id);
+      lru_k_replacer.Unpin(frame_id);
+    }
+  }
+  for (frame_id_t frame_id : {3, 4, 5}) {
+    lru_k_replacer.Pin(frame_id);
+    lru_k_replacer.Unpin(frame_id);
+  }
+  EXPECT_EQ(5, lru_k_replacer.Size());
+
+  // Scenario: pinned frames are not evictable, unpinning twice has no effect.
+  lru_k_replacer.Pin(4);
+  lru_k_replacer.Unpin(3);
+  EXPECT_EQ(4, lru_k_replacer.Size());
+
+  // Scenario: the scanned frames go first, then the frame whose second to last access is oldest.
+  int value;
+  EXPECT_TRUE(lru_k_replacer.Victim(&value));
+  EXPECT_EQ(3, value);
+  EXPECT_TRUE(lru_k_replacer.Victim(&value));
+  EXPECT_EQ(5, value);
+  EXPECT_TRUE(lru_k_replacer.Victim(&value));
+  EXPECT_EQ(1, value);
+
+  // Scenario: a victim forgets its history, so frame 1 comes back cold, while the second pin made frame 4 hot.
+  lru_k_replacer.Pin(1);
+  lru_k_replacer.Unpin(1);
+  lru_k_replacer.Unpin(4);
+  EXPECT_TRUE(lru_k_replacer.Victim(&value));
+  EXPECT_EQ(1, value);
+  EXPECT_TRUE(lru_k_replacer.Victim(&value));
+  EXPECT_EQ(2, value);
+  EXPECT_TRUE(lru_k_replacer.Victim(&value));
+  EXPECT_EQ(4, value);
+  EXPECT_FALSE(lru_k_replacer.Victim(&value));
+  EXPECT_EQ(0, lru_k_replacer.Size());
+}
+
+// NOLINTNEXTLINE
+TEST(LRUKReplacerTest, CorrelatedReferenceTest) {
+  LRUKReplacer lru_k_replacer(7, 2, 4);
+
+  // Scenario: frame 1 is accessed over and over in a row, like a scan fetching a page once per tuple.
+  for (int i = 0; i < 10; i++) {
+    lru_k_replacer.Pin(1);
+    lru_k_replacer.Unpin(1);
+  }
+  // Scenario: frame 2 is accessed twice, far enough apart.
+  lru_k_replacer.Pin(2);
+  lru_k_replacer.Unpin(2);
+  for (frame_id_t frame_id : {3, 4, 5, 6}) {
+    lru_k_replacer.Pin(frame_id);
+    lru_k_replacer.Unpin(frame_id);
+  }
+  lru_k_replacer.Pin(2);
+  lru_k_replacer.Unpin(2);
+
+  // Scenario: the burst on frame 1 counts as a single reference, so frame 1 goes before the re-referenced frame 2.
+  int value;
+  for (frame_id_t expected : {1, 3, 4, 5, 6, 2}) {
+    EXPECT_TRUE(lru_k_replacer.Victim(&value));
+    EXPECT_EQ(expected, value);
+  }
+}
+
+// NOLINTNEXTLINE
+TEST(LRUKReplacerTest, ScanResistanceTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 20;
+
+  auto *disk_manager = new DiskManager(db_name);
+  auto *bpm = new BufferPoolManagerInstance(buffer_pool_size, disk_manager, nullptr, ReplacerPolicy::LRU_K);
+  auto is_resident = [&](page_id_t page_id) {
+    for (size_t i = 0; i < buffer_pool_size; i++) {
+      if (bpm->GetPages()[i].GetPageId() == page_id) {
+        return true;
+      }
+    }
+    return false;
+  };
+
+  // Scenario: two hot pages are referenced again after enough other pages were touched.
+  page_id_t hot_page_ids[2];
+  for (auto &hot_page_id : hot_page_ids) {
+    ASSERT_NE(nullptr, bpm->NewPage(&hot_page_id));
+    EXPECT_EQ(true, bpm->UnpinPage(hot_page_id, true));
+  }
+  for (size_t i = 0; i < LRUK_CORRELATED_PERIOD; i++) {
+    page_id_t page_id_temp;
+    ASSERT_NE(nullptr, bpm->NewPage(&page_id_temp));
+    EXPECT_EQ(true, bpm->UnpinPage(page_id_temp, true));
+  }
+  for (auto hot_page_id : hot_page_ids) {
+    ASSERT_NE(nullptr, bpm->FetchPage(hot_page_id));
+    EXPECT_EQ(true, bpm->UnpinPage(hot_page_id, false));
+  }
+
+  // Scenario: a scan touches many more pages than fit in the pool, each of them once.
+  for (size_t i = 0; i < 5 * buffer_pool_size; i++) {
+    page_id_t page_id_temp;
+    ASSERT_NE(nullptr, bpm->NewPage(&page_id_temp));
+    EXPECT_EQ(true, bpm->UnpinPage(page_id_temp, true));
+  }
+
+  // Scenario: the hot pages survived the scan.
+  for (auto hot_page_id : hot_page_ids) {
+    EXPECT_TRUE(is_resident(hot_page_id));
+  }
+
+  disk_manager->ShutDown();
+  remove("test.db");
+
+  delete bpm;
+  delete disk_manager;
+}
+
+
+// NOLINTNEXTLINE
+TEST(LRUKReplacerTest, DeletedPageHistoryTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 20;
+
+  auto *disk_manager = new DiskManager(db_name);
+  auto *bpm = new BufferPoolManagerInstance(buffer_pool_size, disk_manager, nullptr, ReplacerPolicy::LRU_K);
+  auto is_resident = [&](page_id_t page_id) {
+    for (size_t i = 0; i < buffer_pool_size; i++) {
+      if (bpm->GetPages()[i].GetPageId() == page_id) {
+        return true;
+      }
+    }
+    return false;
+  };
+  auto scan = [&](size_t num_pages) {
+    for (size_t i = 0; i < num_pages; i++) {
+      page_id_t page_id_temp;
+      ASSERT_NE(nullptr, bpm->NewPage(&page_id_temp));
+      EXPECT_EQ(true, bpm->UnpinPage(page_id_temp, true));
+    }
+  };
+
+  // Scenario: a hot page fills the pool together with a scan, then is deleted.
+  page_id_t hot_page_id;
+  ASSERT_NE(nullptr, bpm->NewPage(&hot_page_id));
+  EXPECT_EQ(true, bpm->UnpinPage(hot_page_id, true));
+  scan(LRUK_CORRELATED_PERIOD);
+  ASSERT_NE(nullptr, bpm->FetchPage(hot_page_id));
+  EXPECT_EQ(true, bpm->UnpinPage(hot_page_id, false));
+  scan(buffer_pool_size);
+  ASSERT_TRUE(is_resident(hot_page_id));
+  EXPECT_EQ(true, bpm->DeletePage(hot_page_id));
+
+  // Scenario: the page loaded into the freed frame does not inherit the history of the deleted page.
+  page_id_t new_page_id;
+  ASSERT_NE(nullptr, bpm->NewPage(&new_page_id));
+  EXPECT_EQ(true, bpm->UnpinPage(new_page_id, true));
+  scan(5 * buffer_pool_size);
+  EXPECT_FALSE(is_resident(new_page_id));
+
+  disk_manager->ShutDown();
+  remove("test.db");
+
+  delete bpm;
+  delete disk_manager;
+}
+
+}  // namespace bustub
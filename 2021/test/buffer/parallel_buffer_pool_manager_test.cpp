@@ -11,9 +11,12 @@
 //===----------------------------------------------------------------------===//
 
 #include "buffer/parallel_buffer_pool_manager.h"
+#include <algorithm>
 #include <cstdio>
 #include <random>
 #include <string>
+#include <thread>  // NOLINT
+#include <vector>
 #include "buffer/buffer_pool_manager.h"
 #include "gtest/gtest.h"
 
@@ -182,4 +185,84 @@ TEST(ParallelBufferPoolManagerTest, AllocateTest) {
   delete disk_manager;
 }
 
+// NOLINTNEXTLINE
+TEST(ParallelBufferPoolManagerTest, PreferFreeFramesTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 2;
+  const size_t num_instances = 2;
+
+  auto *disk_manager = new DiskManager(db_name);
+  auto *bpm = new ParallelBufferPoolManager(num_instances, buffer_pool_size, disk_manager);
+
+  // Scenario: fill both instances, then free one frame in instance 1 only.
+  page_id_t page_id_temp;
+  for (size_t i = 0; i < buffer_pool_size * num_instances; i++) {
+    ASSERT_NE(nullptr, bpm->NewPage(&page_id_temp));
+    EXPECT_EQ(true, bpm->UnpinPage(page_id_temp, true));
+  }
+  EXPECT_EQ(true, bpm->DeletePage(1));
+
+  // Scenario: round robin would now start at instance 0 and evict one of its pages. Instance 1 still has a free
+  // frame, so the new page goes there instead, reusing the id of the deleted page.
+  ASSERT_NE(nullptr, bpm->NewPage(&page_id_temp));
+  EXPECT_EQ(1, page_id_temp);
+  EXPECT_EQ(true, bpm->UnpinPage(page_id_temp, true));
+
+  // Scenario: once no instance has a free frame, new pages evict as before.
+  ASSERT_NE(nullptr, bpm->NewPage(&page_id_temp));
+  EXPECT_EQ(true, bpm->UnpinPage(page_id_temp, true));
+
+  // Shutdown the disk manager and remove the temporary file we created.
+  disk_manager->ShutDown();
+  remove("test.db");
+
+  delete bpm;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST(ParallelBufferPoolManagerTest, ConcurrentNewPageTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 16;
+  const size_t num_instances = 4;
+  const size_t num_threads = 4;
+
+  auto *disk_manager = new DiskManager(db_name);
+  auto *bpm = new ParallelBufferPoolManager(num_instances, buffer_pool_size, disk_manager);
+
+  // Scenario: threads allocate pages concurrently until the whole pool is pinned.
+  std::vector<std::vector<page_id_t>> page_ids(num_threads);
+  std::vector<std::thread> threads;
+  for (size_t tid = 0; tid < num_threads; tid++) {
+    threads.emplace_back([bpm, &page_ids, tid] {
+      page_id_t page_id_temp;
+      while (bpm->NewPage(&page_id_temp) != nullptr) {
+        page_ids[tid].push_back(page_id_temp);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  // Scenario: every frame was handed out exactly once, with distinct page ids.
+  std::vector<page_id_t> all_page_ids;
+  for (auto &thread_page_ids : page_ids) {
+    all_page_ids.insert(all_page_ids.end(), thread_page_ids.begin(), thread_page_ids.end());
+  }
+  std::sort(all_page_ids.begin(), all_page_ids.end());
+  EXPECT_EQ(buffer_pool_size * num_instances, all_page_ids.size());
+  EXPECT_EQ(all_page_ids.end(), std::unique(all_page_ids.begin(), all_page_ids.end()));
+  for (auto page_id : all_page_ids) {
+    EXPECT_EQ(true, bpm->UnpinPage(page_id, false));
+  }
+
+  // Shutdown the disk manager and remove the temporary file we created.
+  disk_manager->ShutDown();
+  remove("test.db");
+
+  delete bpm;
+  delete disk_manager;
+}
+
 }  // namespace bustub
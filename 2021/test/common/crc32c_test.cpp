@@ -0,0 +1,79 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// crc32c_test.cpp
+//
+// Identification: test/common/crc32c_test.cpp
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include <chrono>  // NOLINT
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "common/config.h"
+#include "common/util/crc32c.h"
+#include "gtest/gtest.h"
+
+namespace bustub {
+
+// NOLINTNEXTLINE
+TEST(Crc32cTest, KnownValueTest) {
+  // Scenario: check values from RFC 3720 and the CRC catalogue.
+  std::string digits = "123456789";
+  EXPECT_EQ(0xe3069283, Crc32cUtil::Compute(digits.data(), digits.size()));
+  EXPECT_EQ(0xe3069283, Crc32cUtil::ExtendSoftware(0, digits.data(), digits.size()));
+  std::vector<char> zeros(32, 0);
+  EXPECT_EQ(0x8a9136aa, Crc32cUtil::Compute(zeros.data(), zeros.size()));
+  std::vector<char> ones(32, static_cast<char>(0xff));
+  EXPECT_EQ(0x62a8ab43, Crc32cUtil::Compute(ones.data(), ones.size()));
+  EXPECT_EQ(0, Crc32cUtil::Compute(nullptr, 0));
+}
+
+// NOLINTNEXTLINE
+TEST(Crc32cTest, HardwareMatchesSoftwareTest) {
+  std::mt19937 generator(15445);
+  std::vector<char> data(3 * 8192 * 2 + 100);
+  for (auto &byte : data) {
+    byte = static_cast<char>(generator());
+  }
+
+  // Scenario: every alignment and lengths around the block sizes of the interleaved hardware path.
+  for (size_t offset = 0; offset < 8; offset++) {
+    for (size_t length : {size_t{0}, size_t{7}, size_t{767}, size_t{768}, size_t{769}, size_t{PAGE_SIZE},
+                          size_t{3 * 8192 - 1}, size_t{3 * 8192 + 3 * 256 + 5}, data.size() - 8}) {
+      EXPECT_EQ(Crc32cUtil::ExtendSoftware(0, data.data() + offset, length),
+                Crc32cUtil::Extend(0, data.data() + offset, length));
+    }
+  }
+
+  // Scenario: extending a checksum piecewise gives the checksum of the whole.
+  uint32_t crc = Crc32cUtil::Compute(data.data(), 1000);
+  crc = Crc32cUtil::Extend(crc, data.data() + 1000, data.size() - 1000);
+  EXPECT_EQ(Crc32cUtil::Compute(data.data(), data.size()), crc);
+}
+
+// NOLINTNEXTLINE
+TEST(Crc32cTest, ThroughputTest) {
+  const int num_pages = 4096;
+  std::vector<char> data(num_pages * PAGE_SIZE, 1);
+  uint32_t crc = 0;
+  for (bool hardware : {false, true}) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < num_pages; i++) {
+      const char *page = data.data() + i * PAGE_SIZE;
+      crc ^= hardware ? Crc32cUtil::Extend(i, page, PAGE_SIZE) : Crc32cUtil::ExtendSoftware(i, page, PAGE_SIZE);
+    }
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << (hardware ? "Extend" : "ExtendSoftware") << ": " << data.size() / elapsed / (1 << 20) << " MB/s"
+              << std::endl;
+  }
+  std::cout << "hardware accelerated: " << Crc32cUtil::IsHardwareAccelerated() << ", " << crc << std::endl;
+}
+
+}  // namespace bustub
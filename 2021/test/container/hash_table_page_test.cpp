@@ -216,19 +216,19 @@ TEST(HashTablePageTest, BucketReadTest) {
   auto bucket_page = reinterpret_cast<HashTableBucketPage<int, int, IntComparator> *>(
       bpm->NewPage(&bucket_page_id, nullptr)->GetData());
   ASSERT_TRUE(bucket_page->IsEmpty());
-  for (int i = 0; i < 496; i++) {
+  for (int i = 0; i < 442; i++) {
     ASSERT_FALSE(bucket_page->IsReadable(i));
   }
-  for (int i = 0; i < 496; i++) {
+  for (int i = 0; i < 442; i++) {
     bucket_page->Insert(1, i, IntComparator());
   }
   bucket_page->PrintBucket();
 
-  for (int i = 0; i < 496; i++) {
+  for (int i = 0; i < 442; i++) {
     ASSERT_TRUE(bucket_page->IsReadable(i));
   }
 
-  ASSERT_EQ(496, bucket_page->NumReadable());
+  ASSERT_EQ(442, bucket_page->NumReadable());
   ASSERT_TRUE(bucket_page->IsFull());
 
   // unpin the directory page now that we are done
@@ -249,14 +249,14 @@ TEST(HashTablePageTest, PersistTest) {
 
   auto bucket_page = reinterpret_cast<HashTableBucketPage<int, int, IntComparator> *>(
       bpm->NewPage(&bucket_page_id, nullptr)->GetData());
-  for (int i = 0; i < 496; i++) {
+  for (int i = 0; i < 442; i++) {
     ASSERT_FALSE(bucket_page->IsReadable(i));
   }
-  for (int i = 0; i < 496; i++) {
+  for (int i = 0; i < 442; i++) {
     bucket_page->Insert(i, i, IntComparator());
   }
 
-  for (int i = 0; i < 496; i++) {
+  for (int i = 0; i < 442; i++) {
     ASSERT_TRUE(bucket_page->IsReadable(i));
   }
 
@@ -266,7 +266,7 @@ TEST(HashTablePageTest, PersistTest) {
 
   auto fetch_bucket_page = reinterpret_cast<HashTableBucketPage<int, int, IntComparator> *>(
       bpm->FetchPage(bucket_page_id, nullptr)->GetData());
-  for (int i = 0; i < 496; i++) {
+  for (int i = 0; i < 442; i++) {
     std::vector<int> res;
     ASSERT_TRUE(fetch_bucket_page->GetValue(i, IntComparator(), &res));
     ASSERT_EQ(1, res.size());
@@ -280,4 +280,52 @@ TEST(HashTablePageTest, PersistTest) {
   delete bpm;
 }
 
+// NOLINTNEXTLINE
+TEST(HashTablePageTest, BucketProbeTest) {
+  DiskManager *disk_manager = new DiskManager("test.db");
+  auto *bpm = new BufferPoolManagerInstance(5, disk_manager);
+
+  page_id_t bucket_page_id = INVALID_PAGE_ID;
+  auto bucket_page = reinterpret_cast<HashTableBucketPage<int, int, IntComparator> *>(
+      bpm->NewPage(&bucket_page_id, nullptr)->GetData());
+  const int size = 442;
+
+  // Scenario: fill the bucket, so that the last, partial probe block is used too.
+  for (int i = 0; i < size; i++) {
+    ASSERT_TRUE(bucket_page->Insert(i, i, IntComparator()));
+  }
+  ASSERT_TRUE(bucket_page->IsFull());
+  ASSERT_FALSE(bucket_page->Insert(size, size, IntComparator()));
+  for (int i = 0; i < size; i++) {
+    ASSERT_FALSE(bucket_page->Insert(i, i, IntComparator()));
+  }
+
+  // Scenario: remove every other pair, the rest must still be found.
+  for (int i = 0; i < size; i += 2) {
+    ASSERT_TRUE(bucket_page->Remove(i, i, IntComparator()));
+  }
+  ASSERT_EQ(size / 2, bucket_page->NumReadable());
+  for (int i = 0; i < size; i++) {
+    std::vector<int> res;
+    ASSERT_EQ(i % 2 == 1, bucket_page->GetValue(i, IntComparator(), &res));
+    ASSERT_EQ(i % 2 == 1 ? 1 : 0, res.size());
+  }
+
+  // Scenario: many values under one key fill the freed slots, lowest slot first.
+  for (int i = 0; i < size / 2; i++) {
+    ASSERT_TRUE(bucket_page->Insert(-1, i, IntComparator()));
+    ASSERT_EQ(-1, bucket_page->KeyAt(i * 2));
+  }
+  std::vector<int> res;
+  ASSERT_TRUE(bucket_page->GetValue(-1, IntComparator(), &res));
+  ASSERT_EQ(size / 2, res.size());
+  ASSERT_TRUE(bucket_page->IsFull());
+
+  bpm->UnpinPage(bucket_page_id, true, nullptr);
+  disk_manager->ShutDown();
+  remove("test.db");
+  delete disk_manager;
+  delete bpm;
+}
+
 }  // namespace bustub
@@ -10,10 +10,12 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
 #include <thread>  // NOLINT
 #include <vector>
 
 #include "buffer/buffer_pool_manager_instance.h"
+#include "catalog/schema.h"
 #include "common/logger.h"
 #include "container/hash/extendible_hash_table.h"
 #include "gtest/gtest.h"
@@ -141,7 +143,7 @@ TEST(HashTableTest, OwnTest) {
   delete bpm;
 }
 
-#define EACH_BUCKET_SIZE 496
+#define EACH_BUCKET_SIZE 442
 
 TEST(HashTableTest, GrowShrinkTest1) {
   auto *disk_manager = new DiskManager("test.db");
@@ -476,6 +478,247 @@ TEST(HashTableTest, SplitInsertTest) {
   delete bpm;
 }
 
+// NOLINTNEXTLINE
+TEST(HashTableTest, ConcurrentSplitMergeTest) {
+  remove("test.db");
+  auto *disk_manager = new DiskManager("test.db");
+  auto *bpm = new BufferPoolManagerInstance(50, disk_manager);
+  ExtendibleHashTable<int, int, IntComparator> ht("blah", bpm, IntComparator(), HashFunction<int>());
+  const int num_threads = 4;
+  const int keys_per_thread = 2000;
+
+  // Scenario: inserts split buckets under each other, and every key stays visible to concurrent lookups.
+  std::vector<std::thread> threads;
+  for (int t = 0; t < num_threads; t++) {
+    threads.emplace_back([&, t] {
+      for (int i = 0; i < keys_per_thread; i++) {
+        int key = i * num_threads + t;
+        EXPECT_TRUE(ht.Insert(nullptr, key, key));
+        std::vector<int> result;
+        EXPECT_TRUE(ht.GetValue(nullptr, key, &result));
+        EXPECT_EQ(std::vector<int>{key}, result);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  ht.VerifyIntegrity();
+  EXPECT_LT(0, ht.GetGlobalDepth());
+  for (int key = 0; key < num_threads * keys_per_thread; key++) {
+    std::vector<int> result;
+    EXPECT_TRUE(ht.GetValue(nullptr, key, &result));
+  }
+
+  // Scenario: removes merge buckets under each other without losing the keys still to be removed.
+  threads.clear();
+  for (int t = 0; t < num_threads; t++) {
+    threads.emplace_back([&, t] {
+      for (int i = 0; i < keys_per_thread; i++) {
+        int key = i * num_threads + t;
+        EXPECT_TRUE(ht.Remove(nullptr, key, key));
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  ht.VerifyIntegrity();
+  for (int key = 0; key < num_threads * keys_per_thread; key++) {
+    std::vector<int> result;
+    EXPECT_FALSE(ht.GetValue(nullptr, key, &result));
+  }
+
+  disk_manager->ShutDown();
+  remove("test.db");
+  delete disk_manager;
+  delete bpm;
+}
+
+// NOLINTNEXTLINE
+TEST(HashTableTest, GetValuesTest) {
+  remove("test.db");
+  auto *disk_manager = new DiskManager("test.db");
+  auto *bpm = new BufferPoolManagerInstance(50, disk_manager);
+  ExtendibleHashTable<int, int, IntComparator> ht("blah", bpm, IntComparator(), HashFunction<int>());
+  const int num_keys = 5000;
+
+  // Scenario: a batch over many buckets, with absent keys, repeated keys and keys holding several values.
+  for (int key = 0; key < num_keys; key++) {
+    EXPECT_TRUE(ht.Insert(nullptr, key, key));
+    if (key % 7 == 0) {
+      EXPECT_TRUE(ht.Insert(nullptr, key, -key - 1));
+    }
+  }
+  std::vector<int> keys;
+  for (int i = 0; i < 3 * num_keys; i += 2) {
+    keys.push_back((i * 7919) % (2 * num_keys));
+  }
+  keys.push_back(keys.front());
+  std::vector<std::vector<int>> results;
+  uint32_t num_found = ht.GetValues(nullptr, keys, &results);
+  ASSERT_EQ(keys.size(), results.size());
+  uint32_t expected_num_found = 0;
+  for (size_t i = 0; i < keys.size(); i++) {
+    std::vector<int> expected;
+    expected_num_found += static_cast<uint32_t>(ht.GetValue(nullptr, keys[i], &expected));
+    std::sort(expected.begin(), expected.end());
+    std::sort(results[i].begin(), results[i].end());
+    EXPECT_EQ(expected, results[i]) << "key " << keys[i];
+  }
+  EXPECT_EQ(expected_num_found, num_found);
+  EXPECT_EQ(0, ht.GetValues(nullptr, {}, &results));
+  EXPECT_TRUE(results.empty());
+
+  // Scenario: batches stay correct while other threads split and merge the buckets they probe.
+  std::vector<int> preserved_keys;
+  for (int key = 0; key < num_keys; key += 2) {
+    preserved_keys.push_back(key);
+  }
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 2; t++) {
+    threads.emplace_back([&, t] {
+      for (int round = 0; round < 3; round++) {
+        for (int key = num_keys + t; key < 3 * num_keys; key += 2) {
+          ht.Insert(nullptr, key, key);
+        }
+        for (int key = num_keys + t; key < 3 * num_keys; key += 2) {
+          ht.Remove(nullptr, key, key);
+        }
+      }
+    });
+  }
+  threads.emplace_back([&] {
+    for (int round = 0; round < 20; round++) {
+      std::vector<std::vector<int>> batch_results;
+      EXPECT_EQ(preserved_keys.size(), ht.GetValues(nullptr, preserved_keys, &batch_results));
+      for (size_t i = 0; i < preserved_keys.size(); i++) {
+        auto &values = batch_results[i];
+        EXPECT_NE(values.end(), std::find(values.begin(), values.end(), preserved_keys[i]));
+      }
+    }
+  });
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  ht.VerifyIntegrity();
+
+  disk_manager->ShutDown();
+  remove("test.db");
+  delete disk_manager;
+  delete bpm;
+}
+
+// NOLINTNEXTLINE
+TEST(HashTableTest, SplitDirectoryTest) {
+  remove("test.db");
+  auto *disk_manager = new DiskManager("test.db");
+  auto *bpm = new BufferPoolManagerInstance(50, disk_manager);
+  Schema schema(std::vector<Column>({Column("A", TypeId::BIGINT)}));
+  ExtendibleHashTable<GenericKey<64>, RID, GenericComparator<64>> ht("blah", bpm, GenericComparator<64>(&schema),
+                                                                     HashFunction<GenericKey<64>>());
+  auto get_key = [](int i) {
+    GenericKey<64> key;
+    key.SetFromInteger(i);
+    return key;
+  };
+
+  // Scenario: more keys than one directory of 512 buckets holds; full directories are split instead of failing.
+  const int num_keys = 40000;
+  for (int i = 0; i < num_keys; i++) {
+    ASSERT_TRUE(ht.Insert(nullptr, get_key(i), RID(i))) << "Failed to insert " << i;
+  }
+  ht.VerifyIntegrity();
+  EXPECT_LT(MAX_BUCKET_DEPTH, ht.GetGlobalDepth());
+  for (int i = 0; i < num_keys; i++) {
+    std::vector<RID> res;
+    ASSERT_TRUE(ht.GetValue(nullptr, get_key(i), &res)) << "Failed to keep " << i;
+    EXPECT_EQ(RID(i), res[0]);
+  }
+
+  // Scenario: removes reach every directory.
+  for (int i = 0; i < num_keys; i++) {
+    ASSERT_TRUE(ht.Remove(nullptr, get_key(i), RID(i)));
+  }
+  ht.VerifyIntegrity();
+  for (int i = 0; i < num_keys; i++) {
+    std::vector<RID> res;
+    EXPECT_FALSE(ht.GetValue(nullptr, get_key(i), &res));
+  }
+
+  disk_manager->ShutDown();
+  remove("test.db");
+  delete disk_manager;
+  delete bpm;
+}
+
+// NOLINTNEXTLINE
+TEST(HashTableTest, DuplicateKeyFullTest) {
+  remove("test.db");
+  auto *disk_manager = new DiskManager("test.db");
+  auto *bpm = new BufferPoolManagerInstance(50, disk_manager);
+  ExtendibleHashTable<int, int, IntComparator> ht("blah", bpm, IntComparator(), HashFunction<int>());
+
+  // Scenario: a bucket full of one key's values can't be split, so the insert fails without splitting directories.
+  int num_values = 0;
+  while (ht.Insert(nullptr, 7, num_values)) {
+    num_values++;
+    ASSERT_GT(1000, num_values);
+  }
+  EXPECT_LT(0, num_values);
+  EXPECT_GE(MAX_BUCKET_DEPTH, ht.GetGlobalDepth());
+  ht.VerifyIntegrity();
+  std::vector<int> res;
+  EXPECT_TRUE(ht.GetValue(nullptr, 7, &res));
+  EXPECT_EQ(num_values, res.size());
+
+  disk_manager->ShutDown();
+  remove("test.db");
+  delete disk_manager;
+  delete bpm;
+}
+
+// NOLINTNEXTLINE
+TEST(HashTableTest, SmallPoolDirectoryTest) {
+  remove("test.db");
+  const size_t buffer_pool_size = 8;
+  auto *disk_manager = new DiskManager("test.db");
+  auto *bpm = new BufferPoolManagerInstance(buffer_pool_size, disk_manager);
+  Schema schema(std::vector<Column>({Column("A", TypeId::BIGINT)}));
+  ExtendibleHashTable<GenericKey<64>, RID, GenericComparator<64>> ht("blah", bpm, GenericComparator<64>(&schema),
+                                                                     HashFunction<GenericKey<64>>());
+  auto get_key = [](int i) {
+    GenericKey<64> key;
+    key.SetFromInteger(i);
+    return key;
+  };
+
+  // Scenario: the pool is too small to keep every directory pinned, the rest are fetched when used.
+  const int num_keys = 40000;
+  for (int i = 0; i < num_keys; i++) {
+    ASSERT_TRUE(ht.Insert(nullptr, get_key(i), RID(i))) << "Failed to insert " << i;
+  }
+  ht.VerifyIntegrity();
+  EXPECT_LT(MAX_BUCKET_DEPTH, ht.GetGlobalDepth());
+  for (int i = 0; i < num_keys; i++) {
+    std::vector<RID> res;
+    ASSERT_TRUE(ht.GetValue(nullptr, get_key(i), &res)) << "Failed to keep " << i;
+    EXPECT_EQ(RID(i), res[0]);
+  }
+
+  // Scenario: once the table is closed, none of its pages is pinned any more.
+  ht.Close();
+  for (size_t i = 0; i < buffer_pool_size; i++) {
+    page_id_t page_id;
+    ASSERT_NE(nullptr, bpm->NewPage(&page_id));
+  }
+
+  disk_manager->ShutDown();
+  remove("test.db");
+  delete disk_manager;
+  delete bpm;
+}
+
 // steal
 
 }  // namespace bustub
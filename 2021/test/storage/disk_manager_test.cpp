@@ -10,7 +10,11 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <atomic>
 #include <cstring>
+#include <fstream>
+#include <thread>  // NOLINT
+#include <vector>
 
 #include "common/exception.h"
 #include "gtest/gtest.h"
@@ -24,12 +28,16 @@ class DiskManagerTest : public ::testing::Test {
   void SetUp() override {
     remove("test.db");
     remove("test.log");
+    remove("test.crc");
+    remove("test.fsm");
   }
 
   // This function is called after every test.
   void TearDown() override {
     remove("test.db");
     remove("test.log");
+    remove("test.crc");
+    remove("test.fsm");
   };
 };
 
@@ -55,6 +63,219 @@ TEST_F(DiskManagerTest, ReadWritePageTest) {
   dm.ShutDown();
 }
 
+// NOLINTNEXTLINE
+TEST_F(DiskManagerTest, DirectIoReadWritePageTest) {
+  char buf[PAGE_SIZE + 1] = {0};
+  char data[PAGE_SIZE + 1] = {0};
+  std::string db_file("test.db");
+  auto dm = DiskManager(db_file, true);
+  // deliberately unaligned buffers, which O_DIRECT cannot take as is
+  char *unaligned_buf = buf + 1;
+  char *unaligned_data = data + 1;
+  std::strncpy(unaligned_data, "A test string.", PAGE_SIZE);
+
+  dm.WritePage(2, unaligned_data);
+  dm.ReadPage(2, unaligned_buf);
+  EXPECT_EQ(std::memcmp(unaligned_buf, unaligned_data, PAGE_SIZE), 0);
+
+  // pages past the end of the file read back as zeros
+  std::memset(unaligned_buf, 'x', PAGE_SIZE);
+  dm.ReadPage(7, unaligned_buf);
+  char zeros[PAGE_SIZE] = {0};
+  EXPECT_EQ(std::memcmp(unaligned_buf, zeros, PAGE_SIZE), 0);
+
+  // pages below the end of the file that were never written read back as zeros as well
+  std::memset(unaligned_buf, 'x', PAGE_SIZE);
+  dm.ReadPage(1, unaligned_buf);
+  EXPECT_EQ(std::memcmp(unaligned_buf, zeros, PAGE_SIZE), 0);
+
+  dm.ShutDown();
+}
+
+// NOLINTNEXTLINE
+TEST_F(DiskManagerTest, PageChecksumTest) {
+  char buf[PAGE_SIZE] = {0};
+  char data[PAGE_SIZE] = {0};
+  std::string db_file("test.db");
+  auto *dm = new DiskManager(db_file, false, true);
+  EXPECT_TRUE(dm->HasPageChecksums());
+  std::strncpy(data, "A test string.", sizeof(data));
+
+  // Scenario: pages that were never written pass verification.
+  EXPECT_TRUE(dm->ReadPage(0, buf));
+
+  dm->WritePage(0, data);
+  dm->WritePage(1, data);
+  EXPECT_TRUE(dm->WritePageAsync(2, data).get());
+  EXPECT_TRUE(dm->ReadPage(0, buf));
+  EXPECT_EQ(std::memcmp(buf, data, sizeof(buf)), 0);
+  EXPECT_TRUE(dm->ReadPageAsync(2, buf).get());
+  EXPECT_TRUE(dm->VerifyChecksum(2, buf));
+
+  // Scenario: content that does not belong to the page is caught.
+  char other_data[PAGE_SIZE] = {0};
+  std::strncpy(other_data, "Another test string.", sizeof(other_data));
+  dm->WritePage(3, other_data);
+  EXPECT_TRUE(dm->VerifyChecksum(3, other_data));
+  EXPECT_FALSE(dm->VerifyChecksum(3, data));
+  dm->ShutDown();
+  delete dm;
+
+  // Scenario: checksums survive a restart, and a page torn behind the disk manager's back is caught.
+  {
+    std::fstream file(db_file, std::ios::binary | std::ios::in | std::ios::out);
+    file.seekp(PAGE_SIZE + PAGE_SIZE / 2);
+    file.write("garbage", 7);
+  }
+  dm = new DiskManager(db_file, false, true);
+  EXPECT_TRUE(dm->ReadPage(0, buf));
+  EXPECT_FALSE(dm->ReadPage(1, buf));
+  EXPECT_EQ(1, dm->GetNumChecksumFailures());
+  // a page whose write got lost past the end of the file is caught as well
+  EXPECT_TRUE(dm->ReadPage(3, buf));
+  // verification is optional per read
+  EXPECT_TRUE(dm->ReadPage(1, buf, false));
+  // rewriting the page stamps it afresh
+  dm->WritePage(1, data);
+  EXPECT_TRUE(dm->ReadPage(1, buf));
+  dm->ShutDown();
+  delete dm;
+
+  // Scenario: a new database file starts with no checksums.
+  remove("test.db");
+  dm = new DiskManager(db_file, false, true);
+  dm->WritePage(1, data);
+  EXPECT_TRUE(dm->ReadPage(0, buf));
+  EXPECT_TRUE(dm->ReadPage(1, buf));
+  dm->ShutDown();
+  delete dm;
+}
+
+// NOLINTNEXTLINE
+TEST_F(DiskManagerTest, PageSizeTest) {
+  const size_t page_size = 4 * PAGE_SIZE;
+  std::vector<char> buf(page_size);
+  std::vector<char> data(page_size);
+  std::string db_file("test.db");
+  auto dm = DiskManager(db_file, false, true, page_size);
+  EXPECT_EQ(page_size, dm.GetPageSize());
+  for (size_t i = 0; i < page_size; i++) {
+    data[i] = static_cast<char>(i % 127);
+  }
+
+  // Scenario: whole pages go to and come back from their own place in the file, synchronously or not.
+  dm.WritePage(1, data.data());
+  EXPECT_TRUE(dm.WritePageAsync(3, data.data()).get());
+  EXPECT_TRUE(dm.ReadPage(1, buf.data()));
+  EXPECT_EQ(std::memcmp(buf.data(), data.data(), page_size), 0);
+  EXPECT_TRUE(dm.ReadPageAsync(3, buf.data()).get());
+  EXPECT_TRUE(dm.VerifyChecksum(3, buf.data()));
+  EXPECT_EQ(std::memcmp(buf.data(), data.data(), page_size), 0);
+  std::ifstream file(db_file, std::ios::binary | std::ios::ate);
+  EXPECT_EQ(4 * page_size, file.tellg());
+
+  // Scenario: never written pages in between read back as zeros.
+  EXPECT_TRUE(dm.ReadPage(2, buf.data()));
+  EXPECT_EQ(std::vector<char>(page_size, 0), buf);
+  dm.ShutDown();
+
+  // Scenario: page sizes that are not a power of two within bounds are rejected.
+  EXPECT_THROW(DiskManager(db_file, false, false, PAGE_SIZE / 2), Exception);
+  EXPECT_THROW(DiskManager(db_file, false, false, 3 * PAGE_SIZE), Exception);
+  EXPECT_THROW(DiskManager(db_file, false, false, 2 * MAX_PAGE_SIZE), Exception);
+}
+
+// NOLINTNEXTLINE
+TEST_F(DiskManagerTest, FreePageMapTest) {
+  char buf[PAGE_SIZE] = {0};
+  char data[PAGE_SIZE] = {0};
+  std::string db_file("test.db");
+  auto dm = DiskManager(db_file, false, true);
+  std::strncpy(data, "A test string.", sizeof(data));
+  for (int i = 0; i < 10; i++) {
+    dm.WritePage(i, data);
+  }
+  EXPECT_EQ(INVALID_PAGE_ID, dm.AllocateFreePage());
+
+  // Scenario: deallocated pages are handed out again, lowest id first, and only to the instance owning them.
+  dm.DeallocatePage(7);
+  dm.DeallocatePage(3);
+  dm.DeallocatePage(3);
+  dm.DeallocatePage(8);
+  EXPECT_EQ(3, dm.GetNumFreePages());
+  EXPECT_EQ(3, dm.AllocateFreePage(2, 1));
+  EXPECT_EQ(8, dm.AllocateFreePage(2, 0));
+  EXPECT_EQ(7, dm.AllocateFreePage(2, 1));
+  EXPECT_EQ(INVALID_PAGE_ID, dm.AllocateFreePage(2, 1));
+  dm.DeallocatePage(4);
+  EXPECT_EQ(INVALID_PAGE_ID, dm.AllocateFreePage(2, 1));
+  dm.DeallocatePage(9);
+  EXPECT_EQ(9, dm.AllocateFreePage(2, 1));
+  EXPECT_EQ(4, dm.AllocateFreePage(2, 0));
+  EXPECT_EQ(0, dm.GetNumFreePages());
+
+  // Scenario: a reused page does not fail verification with the checksum of its previous life.
+  dm.DeallocatePage(5);
+  EXPECT_EQ(5, dm.AllocateFreePage());
+  EXPECT_TRUE(dm.ReadPage(5, buf));
+
+  // Scenario: truncation only cuts free pages off the end of the file.
+  dm.DeallocatePage(9);
+  dm.DeallocatePage(8);
+  dm.DeallocatePage(6);
+  EXPECT_EQ(8, dm.Truncate());
+  std::ifstream file(db_file, std::ios::binary | std::ios::ate);
+  EXPECT_EQ(8 * PAGE_SIZE, file.tellg());
+  file.close();
+  EXPECT_TRUE(dm.ReadPage(9, buf));
+  EXPECT_EQ(0, buf[0]);
+  dm.ShutDown();
+
+  // Scenario: the free-page map survives a restart, including the pages cut off by truncation.
+  auto dm2 = DiskManager(db_file, false, true);
+  EXPECT_EQ(3, dm2.GetNumFreePages());
+  EXPECT_EQ(6, dm2.AllocateFreePage());
+  EXPECT_EQ(8, dm2.AllocateFreePage());
+  EXPECT_EQ(9, dm2.AllocateFreePage());
+  EXPECT_TRUE(dm2.ReadPage(2, buf));
+  EXPECT_EQ(std::memcmp(buf, data, sizeof(buf)), 0);
+  dm2.ShutDown();
+}
+
+// NOLINTNEXTLINE
+TEST_F(DiskManagerTest, TruncateWhileWritingTest) {
+  char buf[PAGE_SIZE] = {0};
+  std::string db_file("test.db");
+  auto dm = DiskManager(db_file);
+  const int num_pages = 10000;
+  std::atomic<bool> done{false};
+
+  // Scenario: every odd page is freed right after it is written, so the file keeps ending in a free page that
+  // Truncate cuts off while the next page is being appended.
+  std::thread writer([&] {
+    char data[PAGE_SIZE];
+    for (int i = 0; i < num_pages; i++) {
+      std::memset(data, i % 128, sizeof(data));
+      dm.WritePage(i, data);
+      if (i % 2 == 1) {
+        dm.DeallocatePage(i);
+      }
+    }
+    done = true;
+  });
+  while (!done) {
+    dm.Truncate();
+  }
+  writer.join();
+
+  for (int i = 0; i < num_pages; i += 2) {
+    ASSERT_TRUE(dm.ReadPage(i, buf));
+    ASSERT_EQ(i % 128, buf[0]) << "Lost page " << i;
+    ASSERT_EQ(i % 128, buf[PAGE_SIZE - 1]) << "Lost page " << i;
+  }
+  dm.ShutDown();
+}
+
 // NOLINTNEXTLINE
 TEST_F(DiskManagerTest, ReadWriteLogTest) {
   char buf[16] = {0};
@@ -0,0 +1,105 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// disk_scheduler_test.cpp
+//
+// Identification: test/storage/disk_scheduler_test.cpp
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <future>  // NOLINT
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "storage/disk/disk_manager.h"
+#include "storage/disk/disk_scheduler.h"
+
+namespace bustub {
+
+class DiskSchedulerTest : public ::testing::TestWithParam<bool> {
+ protected:
+  // This function is called before every test.
+  void SetUp() override {
+    remove("test.db");
+    fd_ = open("test.db", O_RDWR | O_CREAT, 0644);
+    ASSERT_GE(fd_, 0);
+  }
+
+  // This function is called after every test.
+  void TearDown() override {
+    close(fd_);
+    remove("test.db");
+  };
+
+  int fd_;
+};
+
+// NOLINTNEXTLINE
+TEST_P(DiskSchedulerTest, ScheduleWriteReadPageTest) {
+  const int num_pages = 100;
+  DiskScheduler scheduler(fd_, 8, 4, GetParam());
+
+  // Scenario: many writes outstanding at once, more than the queue depth.
+  std::vector<std::vector<char>> data(num_pages, std::vector<char>(PAGE_SIZE));
+  std::vector<std::future<bool>> futures;
+  for (int i = 0; i < num_pages; i++) {
+    snprintf(data[i].data(), PAGE_SIZE, "page %d", i);
+    DiskRequest r{true, data[i].data(), i, std::promise<bool>()};
+    futures.push_back(r.callback_.get_future());
+    scheduler.Schedule(std::move(r));
+  }
+  for (auto &future : futures) {
+    EXPECT_TRUE(future.get());
+  }
+
+  // Scenario: read every page back, including one past the end of the file.
+  std::vector<std::vector<char>> buf(num_pages + 1, std::vector<char>(PAGE_SIZE, 'x'));
+  futures.clear();
+  for (int i = 0; i <= num_pages; i++) {
+    DiskRequest r{false, buf[i].data(), i, std::promise<bool>()};
+    futures.push_back(r.callback_.get_future());
+    scheduler.Schedule(std::move(r));
+  }
+  for (int i = 0; i <= num_pages; i++) {
+    EXPECT_TRUE(futures[i].get());
+  }
+  for (int i = 0; i < num_pages; i++) {
+    EXPECT_EQ(0, std::memcmp(buf[i].data(), data[i].data(), PAGE_SIZE));
+  }
+  std::vector<char> zeros(PAGE_SIZE, 0);
+  EXPECT_EQ(0, std::memcmp(buf[num_pages].data(), zeros.data(), PAGE_SIZE));
+}
+
+INSTANTIATE_TEST_SUITE_P(IoUringAndFallback, DiskSchedulerTest, ::testing::Bool());
+
+// NOLINTNEXTLINE
+TEST(DiskManagerAsyncTest, ReadWritePageAsyncTest) {
+  remove("test.db");
+  remove("test.log");
+  char buf[PAGE_SIZE] = {0};
+  char data[PAGE_SIZE] = {0};
+  auto dm = DiskManager("test.db");
+  std::strncpy(data, "A test string.", sizeof(data));
+
+  EXPECT_TRUE(dm.WritePageAsync(3, data).get());
+  EXPECT_TRUE(dm.ReadPageAsync(3, buf).get());
+  EXPECT_EQ(std::memcmp(buf, data, sizeof(buf)), 0);
+
+  // The synchronous path sees what the asynchronous one wrote.
+  std::memset(buf, 0, sizeof(buf));
+  dm.ReadPage(3, buf);
+  EXPECT_EQ(std::memcmp(buf, data, sizeof(buf)), 0);
+
+  dm.ShutDown();
+  remove("test.db");
+  remove("test.log");
+}
+
+}  // namespace bustub
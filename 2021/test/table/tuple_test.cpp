@@ -13,14 +13,17 @@
 #include <algorithm>
 #include <cstdio>
 #include <iostream>
+#include <set>
 #include <string>
 #include <vector>
 
 #include "buffer/buffer_pool_manager_instance.h"
 #include "gtest/gtest.h"
 #include "logging/common.h"
+#include "storage/table/free_space_directory.h"
 #include "storage/table/table_heap.h"
 #include "storage/table/tuple.h"
+#include "storage/table/tuple_view.h"
 
 namespace bustub {
 // NOLINTNEXTLINE
@@ -71,4 +74,372 @@ TEST(TupleTest, DISABLED_TableHeapTest) {
   delete disk_manager;
 }
 
+// NOLINTNEXTLINE
+TEST(TupleTest, LargePageTableHeapTest) {
+  Column col1{"a", TypeId::VARCHAR, 20000};
+  Column col2{"b", TypeId::BIGINT};
+  std::vector<Column> cols{col1, col2};
+  Schema schema{cols};
+  Tuple small_tuple{{Value(TypeId::VARCHAR, std::string(100, 'a')), Value(TypeId::BIGINT, int64_t{1})}, &schema};
+  Tuple large_tuple{{Value(TypeId::VARCHAR, std::string(10000, 'b')), Value(TypeId::BIGINT, int64_t{2})}, &schema};
+
+  std::vector<size_t> num_pages;
+  for (size_t page_size : {size_t{PAGE_SIZE}, size_t{MAX_PAGE_SIZE}}) {
+    remove("test.db");
+    auto *transaction = new Transaction(0);
+    auto *disk_manager = new DiskManager("test.db", false, false, page_size);
+    auto *buffer_pool_manager = new BufferPoolManagerInstance(10, disk_manager);
+    EXPECT_EQ(page_size, buffer_pool_manager->GetPageSize());
+    auto *table = new TableHeap(buffer_pool_manager, nullptr, nullptr, transaction);
+
+    // Scenario: many small tuples, which need far fewer of the larger pages, and survive eviction.
+    std::set<page_id_t> page_ids;
+    std::vector<RID> rids;
+    for (int i = 0; i < 2000; ++i) {
+      RID rid;
+      ASSERT_TRUE(table->InsertTuple(small_tuple, &rid, transaction));
+      page_ids.insert(rid.GetPageId());
+      rids.push_back(rid);
+    }
+    num_pages.push_back(page_ids.size());
+    for (const auto &rid : rids) {
+      Tuple tuple;
+      ASSERT_TRUE(table->GetTuple(rid, &tuple, transaction));
+      EXPECT_EQ(small_tuple.GetLength(), tuple.GetLength());
+    }
+
+    // Scenario: a tuple larger than the smallest page size only fits into the larger pages.
+    RID rid;
+    EXPECT_EQ(page_size > large_tuple.GetLength(), table->InsertTuple(large_tuple, &rid, transaction));
+
+    disk_manager->ShutDown();
+    remove("test.db");
+    remove("test.log");
+    delete table;
+    delete buffer_pool_manager;
+    delete disk_manager;
+    delete transaction;
+  }
+  EXPECT_LE(num_pages[1] * (MAX_PAGE_SIZE / PAGE_SIZE), num_pages[0] + MAX_PAGE_SIZE / PAGE_SIZE);
+}
+
+// NOLINTNEXTLINE
+TEST(TupleTest, FreeSpaceDirectoryTest) {
+  FreeSpaceDirectory directory(PAGE_SIZE);
+  const uint32_t class_size = PAGE_SIZE / FreeSpaceDirectory::NUM_CLASSES;
+  EXPECT_EQ(INVALID_PAGE_ID, directory.FindPage(1));
+
+  // Scenario: the fullest page that is guaranteed to fit is found.
+  directory.Update(1, PAGE_SIZE / 2);
+  directory.Update(2, 4 * class_size);
+  directory.Update(3, 2 * class_size - 1);
+  EXPECT_EQ(2, directory.FindPage(3 * class_size));
+  EXPECT_EQ(3, directory.FindPage(class_size));
+  EXPECT_EQ(1, directory.FindPage(PAGE_SIZE / 2));
+  EXPECT_EQ(INVALID_PAGE_ID, directory.FindPage(PAGE_SIZE / 2 + 1));
+
+  // Scenario: pages move between classes as their free space changes.
+  directory.Update(3, 0);
+  directory.Update(2, PAGE_SIZE);
+  EXPECT_EQ(1, directory.FindPage(class_size));
+  EXPECT_EQ(2, directory.FindPage(PAGE_SIZE / 2 + 1));
+  EXPECT_EQ(3, directory.GetNumPages());
+  EXPECT_EQ(0, directory.GetFreeSpace(3));
+}
+
+// NOLINTNEXTLINE
+TEST(TupleTest, FreeSpaceTableHeapTest) {
+  Column col1{"a", TypeId::VARCHAR, 200};
+  Column col2{"b", TypeId::BIGINT};
+  std::vector<Column> cols{col1, col2};
+  Schema schema{cols};
+  Tuple tuple{{Value(TypeId::VARCHAR, std::string(100, 'a')), Value(TypeId::BIGINT, int64_t{1})}, &schema};
+
+  remove("test.db");
+  auto *transaction = new Transaction(0);
+  auto *disk_manager = new DiskManager("test.db");
+  auto *buffer_pool_manager = new BufferPoolManagerInstance(10, disk_manager);
+  auto *lock_manager = new LockManager();
+  auto *table = new TableHeap(buffer_pool_manager, lock_manager, nullptr, transaction);
+
+  std::vector<RID> rids;
+  for (int i = 0; i < 1000; ++i) {
+    RID rid;
+    ASSERT_TRUE(table->InsertTuple(tuple, &rid, transaction));
+    rids.push_back(rid);
+  }
+  page_id_t first_page_id = table->GetFirstPageId();
+  page_id_t last_page_id = rids.back().GetPageId();
+  EXPECT_EQ(first_page_id, rids.front().GetPageId());
+
+  // Scenario: space freed on the first page is found by the next inserts without walking the list, and the tuples
+  // go back to the first page.
+  for (const auto &rid : rids) {
+    if (rid.GetPageId() == first_page_id && rid.GetSlotNum() < 3) {
+      ASSERT_TRUE(table->MarkDelete(rid, transaction));
+      table->ApplyDelete(rid, transaction);
+    }
+  }
+  int reads_before = disk_manager->GetNumReads();
+  for (int i = 0; i < 3; ++i) {
+    RID rid;
+    ASSERT_TRUE(table->InsertTuple(tuple, &rid, transaction));
+    EXPECT_EQ(first_page_id, rid.GetPageId());
+  }
+  EXPECT_LE(disk_manager->GetNumReads() - reads_before, 1);
+
+  // Scenario: once the freed space is used up, inserts go to the end of the table again.
+  RID rid;
+  ASSERT_TRUE(table->InsertTuple(tuple, &rid, transaction));
+  EXPECT_NE(first_page_id, rid.GetPageId());
+  EXPECT_GE(rid.GetPageId(), last_page_id);
+
+  // Scenario: a table heap opened on an existing table rebuilds the directory from the page list.
+  auto *reopened = new TableHeap(buffer_pool_manager, lock_manager, nullptr, first_page_id);
+  EXPECT_EQ(table->GetFreeSpaceDirectory()->GetNumPages(), reopened->GetFreeSpaceDirectory()->GetNumPages());
+  ASSERT_TRUE(reopened->InsertTuple(tuple, &rid, transaction));
+  Tuple result;
+  ASSERT_TRUE(reopened->GetTuple(rid, &result, transaction));
+  EXPECT_EQ(tuple.GetLength(), result.GetLength());
+
+  disk_manager->ShutDown();
+  remove("test.db");
+  remove("test.log");
+  delete reopened;
+  delete table;
+  delete lock_manager;
+  delete buffer_pool_manager;
+  delete disk_manager;
+  delete transaction;
+}
+
+// NOLINTNEXTLINE
+TEST(TupleTest, BatchInsertTableHeapTest) {
+  Column col1{"a", TypeId::VARCHAR, 20000};
+  Column col2{"b", TypeId::BIGINT};
+  std::vector<Column> cols{col1, col2};
+  Schema schema{cols};
+  std::vector<Tuple> tuples;
+  for (int64_t i = 0; i < 1000; ++i) {
+    std::vector<Value> values{Value(TypeId::VARCHAR, std::string(i % 50 + 1, 'a')), Value(TypeId::BIGINT, i)};
+    tuples.emplace_back(values, &schema);
+  }
+
+  remove("test.db");
+  auto *transaction = new Transaction(0);
+  auto *disk_manager = new DiskManager("test.db");
+  auto *buffer_pool_manager = new BufferPoolManagerInstance(10, disk_manager);
+  auto *table = new TableHeap(buffer_pool_manager, nullptr, nullptr, transaction);
+
+  // Scenario: a batch spanning many pages lands in order, and every tuple gets a write record.
+  std::vector<RID> rids;
+  ASSERT_TRUE(table->InsertTuples(tuples, &rids, transaction));
+  ASSERT_EQ(tuples.size(), rids.size());
+  EXPECT_EQ(tuples.size(), transaction->GetWriteSet()->size());
+  std::set<std::pair<page_id_t, uint32_t>> distinct;
+  for (size_t i = 0; i < rids.size(); ++i) {
+    distinct.emplace(rids[i].GetPageId(), rids[i].GetSlotNum());
+    Tuple tuple;
+    ASSERT_TRUE(table->GetTuple(rids[i], &tuple, transaction));
+    EXPECT_EQ(static_cast<int64_t>(i), tuple.GetValue(&schema, 1).GetAs<int64_t>());
+    if (i > 0) {
+      EXPECT_GE(rids[i].GetPageId(), rids[i - 1].GetPageId());
+    }
+  }
+  EXPECT_EQ(rids.size(), distinct.size());
+
+  // Scenario: the tuples one at a time fill the same number of pages.
+  auto *single_table = new TableHeap(buffer_pool_manager, nullptr, nullptr, transaction);
+  std::set<page_id_t> single_pages;
+  for (const auto &tuple : tuples) {
+    RID rid;
+    ASSERT_TRUE(single_table->InsertTuple(tuple, &rid, transaction));
+    single_pages.insert(rid.GetPageId());
+  }
+  std::set<page_id_t> batch_pages;
+  for (const auto &rid : rids) {
+    batch_pages.insert(rid.GetPageId());
+  }
+  EXPECT_EQ(single_pages.size(), batch_pages.size());
+
+  // Scenario: a batch with a tuple larger than a page inserts nothing.
+  size_t write_set_size = transaction->GetWriteSet()->size();
+  std::vector<Tuple> too_large{tuples[0], Tuple{{Value(TypeId::VARCHAR, std::string(PAGE_SIZE, 'b')),
+                                                  Value(TypeId::BIGINT, int64_t{0})},
+                                                 &schema}};
+  EXPECT_FALSE(table->InsertTuples(too_large, &rids, transaction));
+  EXPECT_EQ(TransactionState::ABORTED, transaction->GetState());
+  EXPECT_EQ(write_set_size, transaction->GetWriteSet()->size());
+
+  disk_manager->ShutDown();
+  remove("test.db");
+  remove("test.log");
+  delete single_table;
+  delete table;
+  delete buffer_pool_manager;
+  delete disk_manager;
+  delete transaction;
+}
+
+// NOLINTNEXTLINE
+TEST(TupleTest, UpdateForwardingTableHeapTest) {
+  Column col1{"a", TypeId::VARCHAR, 20000};
+  Column col2{"b", TypeId::BIGINT};
+  std::vector<Column> cols{col1, col2};
+  Schema schema{cols};
+  auto make_tuple = [&](size_t length, int64_t key) {
+    std::vector<Value> values{Value(TypeId::VARCHAR, std::string(length, 'a')), Value(TypeId::BIGINT, key)};
+    return Tuple{values, &schema};
+  };
+  auto scan = [&](TableHeap *table, Transaction *txn) {
+    std::vector<std::pair<RID, size_t>> result;
+    for (auto iter = table->Begin(txn); iter != table->End(); ++iter) {
+      result.emplace_back(iter->GetRid(), iter->GetLength());
+    }
+    return result;
+  };
+
+  remove("test.db");
+  auto *transaction = new Transaction(0);
+  auto *disk_manager = new DiskManager("test.db");
+  auto *buffer_pool_manager = new BufferPoolManagerInstance(10, disk_manager);
+  auto *lock_manager = new LockManager();
+  auto *table = new TableHeap(buffer_pool_manager, lock_manager, nullptr, transaction);
+  std::vector<RID> rids;
+  for (int64_t i = 0; i < 100; ++i) {
+    RID rid;
+    ASSERT_TRUE(table->InsertTuple(make_tuple(100, i), &rid, transaction));
+    rids.push_back(rid);
+  }
+  const RID rid = rids[1];
+  const page_id_t home_page_id = rid.GetPageId();
+
+  // Scenario: a tuple that outgrows its full page is moved, keeps its RID, and is seen once by a scan.
+  Tuple large = make_tuple(2000, 1);
+  ASSERT_TRUE(table->UpdateTuple(large, rid, transaction));
+  Tuple result;
+  ASSERT_TRUE(table->GetTuple(rid, &result, transaction));
+  EXPECT_EQ(large.GetLength(), result.GetLength());
+  EXPECT_EQ(rid, result.GetRid());
+  EXPECT_EQ(1, result.GetValue(&schema, 1).GetAs<int64_t>());
+  auto scanned = scan(table, transaction);
+  ASSERT_EQ(rids.size(), scanned.size());
+  EXPECT_EQ(rid, scanned[1].first);
+  EXPECT_EQ(large.GetLength(), scanned[1].second);
+
+  // Scenario: a moved tuple that grows again moves on, and shrinking it back updates it where it is.
+  Tuple larger = make_tuple(3900, 1);
+  ASSERT_TRUE(table->UpdateTuple(larger, rid, transaction));
+  ASSERT_TRUE(table->GetTuple(rid, &result, transaction));
+  EXPECT_EQ(larger.GetLength(), result.GetLength());
+  Tuple small = make_tuple(10, 1);
+  ASSERT_TRUE(table->UpdateTuple(small, rid, transaction));
+  ASSERT_TRUE(table->GetTuple(rid, &result, transaction));
+  EXPECT_EQ(small.GetLength(), result.GetLength());
+  EXPECT_EQ(rid, result.GetRid());
+  EXPECT_EQ(rids.size(), scan(table, transaction).size());
+
+  // Scenario: deleting the tuple through its RID also deletes the moved copy.
+  ASSERT_TRUE(table->MarkDelete(rid, transaction));
+  table->ApplyDelete(rid, transaction);
+  EXPECT_FALSE(table->GetTuple(rid, &result, transaction));
+  scanned = scan(table, transaction);
+  EXPECT_EQ(rids.size() - 1, scanned.size());
+  size_t total_length = 0;
+  for (const auto &[scanned_rid, length] : scanned) {
+    EXPECT_FALSE(rid == scanned_rid);
+    total_length += length;
+  }
+  EXPECT_EQ((rids.size() - 1) * make_tuple(100, 0).GetLength(), total_length);
+
+  // Scenario: applying deletes compacts the slot array, the home page gets all of its space back.
+  uint32_t free_space = table->GetFreeSpaceDirectory()->GetFreeSpace(home_page_id);
+  for (const auto &r : rids) {
+    if (r.GetPageId() == home_page_id && !(r == rid)) {
+      ASSERT_TRUE(table->MarkDelete(r, transaction));
+      table->ApplyDelete(r, transaction);
+    }
+  }
+  EXPECT_LT(free_space, table->GetFreeSpaceDirectory()->GetFreeSpace(home_page_id));
+  EXPECT_EQ(PAGE_SIZE - 24, table->GetFreeSpaceDirectory()->GetFreeSpace(home_page_id));
+
+  disk_manager->ShutDown();
+  remove("test.db");
+  remove("test.log");
+  delete table;
+  delete lock_manager;
+  delete buffer_pool_manager;
+  delete disk_manager;
+  delete transaction;
+}
+
+// NOLINTNEXTLINE
+TEST(TupleTest, TupleViewTableHeapTest) {
+  Column col1{"a", TypeId::VARCHAR, 20000};
+  Column col2{"b", TypeId::BIGINT};
+  std::vector<Column> cols{col1, col2};
+  Schema schema{cols};
+  auto make_tuple = [&](size_t length, int64_t key) {
+    std::vector<Value> values{Value(TypeId::VARCHAR, std::string(length, 'a')), Value(TypeId::BIGINT, key)};
+    return Tuple{values, &schema};
+  };
+
+  remove("test.db");
+  auto *transaction = new Transaction(0);
+  auto *disk_manager = new DiskManager("test.db");
+  auto *buffer_pool_manager = new BufferPoolManagerInstance(10, disk_manager);
+  auto *lock_manager = new LockManager();
+  auto *table = new TableHeap(buffer_pool_manager, lock_manager, nullptr, transaction);
+  std::vector<RID> rids;
+  for (int64_t i = 0; i < 100; ++i) {
+    RID rid;
+    ASSERT_TRUE(table->InsertTuple(make_tuple(100, i), &rid, transaction));
+    rids.push_back(rid);
+  }
+
+  // Scenario: a view points into the pinned page, and Materialize makes a copy that outlives it.
+  TupleView view;
+  ASSERT_TRUE(table->GetTupleView(rids[0], &view, transaction));
+  Page *page = buffer_pool_manager->FetchPage(rids[0].GetPageId());
+  EXPECT_EQ(2, page->GetPinCount());
+  Tuple tuple = view.GetTuple();
+  EXPECT_FALSE(tuple.IsAllocated());
+  EXPECT_LE(page->GetData(), tuple.GetData());
+  EXPECT_LT(tuple.GetData(), page->GetData() + PAGE_SIZE);
+  Tuple copy = view.Materialize();
+  EXPECT_TRUE(copy.IsAllocated());
+  view.Release();
+  EXPECT_FALSE(view.IsValid());
+  EXPECT_EQ(1, page->GetPinCount());
+  buffer_pool_manager->UnpinPage(rids[0].GetPageId(), false);
+  EXPECT_EQ(rids[0], copy.GetRid());
+  EXPECT_EQ(0, copy.GetValue(&schema, 1).GetAs<int64_t>());
+
+  // Scenario: a view of a moved tuple follows the forwarding stub and keeps the RID of the home slot.
+  ASSERT_TRUE(table->UpdateTuple(make_tuple(2000, 1), rids[1], transaction));
+  ASSERT_TRUE(table->GetTupleView(rids[1], &view, transaction));
+  EXPECT_EQ(rids[1], view.GetTuple().GetRid());
+  EXPECT_EQ(1, view.GetTuple().GetValue(&schema, 1).GetAs<int64_t>());
+  EXPECT_EQ(make_tuple(2000, 1).GetLength(), view.GetTuple().GetLength());
+
+  // Scenario: a scan reads every tuple through views; GetTupleView releases what the view held before.
+  int64_t expected = 0;
+  for (auto iter = table->Begin(transaction); iter != table->End(); ++iter) {
+    ASSERT_TRUE(iter.GetTupleView(&view));
+    EXPECT_EQ(iter.GetRid(), view.GetTuple().GetRid());
+    EXPECT_EQ(expected++, view.GetTuple().GetValue(&schema, 1).GetAs<int64_t>());
+    view.Release();
+  }
+  EXPECT_EQ(100, expected);
+
+  disk_manager->ShutDown();
+  remove("test.db");
+  remove("test.log");
+  delete table;
+  delete lock_manager;
+  delete buffer_pool_manager;
+  delete disk_manager;
+  delete transaction;
+}
+
 }  // namespace bustub